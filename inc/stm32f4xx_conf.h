@@ -43,11 +43,11 @@
 //#include "stm32f4xx_hash.h"
 #include "stm32f4xx_gpio.h"
 #include "stm32f4xx_i2c.h"
-//#include "stm32f4xx_iwdg.h"
-//#include "stm32f4xx_pwr.h"
+#include "stm32f4xx_iwdg.h"
+#include "stm32f4xx_pwr.h"
 #include "stm32f4xx_rcc.h"
 //#include "stm32f4xx_rng.h"
-//#include "stm32f4xx_rtc.h"
+#include "stm32f4xx_rtc.h"
 #include "stm32f4xx_sdio.h"
 #include "stm32f4xx_spi.h"
 #include "stm32f4xx_syscfg.h"
@@ -22,8 +22,9 @@ extern void  tdelay (uint16_t ticks);
 /* Code  ---------------------------------------------------------------------*/
 
 /* initialize the sensor;
- * currently only one mode (MODE_0) is implemented,
- * a 150Hz pressure data read in normal mode, SPI, no filters;
+ * MODE_0 is a 150Hz pressure data read in normal mode, SPI, no filters,
+ * MODE_1 the low-rate variant, with 16x oversampling and the IIR filter;
+ * MODE_2 as MODE_0, with the IIR filter (coefficient 2) against the noise;
  * return value is the chip ID, or 0xFF in case of error
  */
 uint8_t  initSensor (uint8_t mode)
@@ -39,14 +40,27 @@ uint8_t  initSensor (uint8_t mode)
     if (ret != BMP280_ID)
         return (RET_SPI_ERR);
 
-    // mean it ?
-    if (mode != BMP280_CONFIG_MODE_0)
-        return (RET_SPI_ERR);
-
     // write configuration
-    writeReg (REG_CTRL, MODE_0_CTRL);
-    tdelay (1);
-    writeReg (REG_CONFIG, MODE_0_CONFIG);
+    if (mode == BMP280_CONFIG_MODE_0)
+    {
+        writeReg (REG_CTRL, MODE_0_CTRL);
+        tdelay (1);
+        writeReg (REG_CONFIG, MODE_0_CONFIG);
+    }
+    else if (mode == BMP280_CONFIG_MODE_1)
+    {
+        writeReg (REG_CTRL, MODE_1_CTRL);
+        tdelay (1);
+        writeReg (REG_CONFIG, MODE_1_CONFIG);
+    }
+    else if (mode == BMP280_CONFIG_MODE_2)
+    {
+        writeReg (REG_CTRL, MODE_2_CTRL);
+        tdelay (1);
+        writeReg (REG_CONFIG, MODE_2_CONFIG);
+    }
+    else
+        return (RET_SPI_ERR);
     tdelay (1);
 
     // return chip ID
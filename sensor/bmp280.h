@@ -21,10 +21,17 @@
 #define BMP280_ID              0x58  // expected chip ID
 #define MODE_0_CTRL            0x07  // skip t, sample p@1x, normal mode
 #define MODE_0_CONFIG          0x00  // minimal standy time, no filter, 4-wire SPI
+#define MODE_1_CTRL            0x17  // skip t, sample p@16x, normal mode
+#define MODE_1_CONFIG          0x28  // 62.5ms standby, IIR filter 4, 4-wire SPI
+#define MODE_2_CTRL            0x07  // skip t, sample p@1x, normal mode
+#define MODE_2_CONFIG          0x04  // minimal standy time, IIR filter 2, 4-wire SPI
 
 /* ---- BMP280 config modes
  */
-#define BMP280_CONFIG_MODE_0   0x00
+#define BMP280_CONFIG_MODE_0   0x00  // 150Hz sampling, no oversampling
+#define BMP280_CONFIG_MODE_1   0x01  // low-rate: ~9Hz conversions, oversampled
+                                     // and filtered by the sensor
+#define BMP280_CONFIG_MODE_2   0x02  // 150Hz sampling, filtered by the sensor
 
 
 /* -------------- API functions --------------
@@ -24,8 +24,11 @@
   */
 
 /* Includes ------------------------------------------------------------------*/
+#include <string.h>
 #include "stm32f4xx.h"
-#include "stm32f4_discovery.h"
+#ifndef LCD_HOST_SIM
+  #include "stm32f4_discovery.h"
+#endif
 #include "stm32f4_discovery_lcd.h"
 #include "fonts.h"
 
@@ -45,6 +48,26 @@
 /** @defgroup stm32f4_discovery_LCD_Private_TypesDef
   * @{
   */
+typedef struct
+{
+    const uint16_t  *pChar;             /* font table entry, unique per font and char */
+    uint16_t         text;
+    uint16_t         back;
+    uint32_t         used;              /* LRU stamp; 0 = free */
+} GlyphTag;
+
+typedef struct
+{
+    uint16_t         line;
+    uint16_t         text;
+    uint16_t         back;
+    sFONT           *font;
+    uint8_t          chars[LCD_PIXEL_WIDTH/8];
+} TextShadow;
+
+/**
+  * @}
+  */
 
 /** @defgroup stm32f4_discovery_LCD_Private define
   * @{
@@ -61,6 +84,23 @@
 #define  LCD_CMD                     (*(vu16 *)LCD_BASE_Addr)
 #define  LCD_Data                    (*(vu16 *)LCD_BASE_Data)
 
+/* bus access; a host build (LCD_HOST_SIM) runs against the controller
+   emulation of tools/lcdsim instead of the FSMC */
+#ifdef LCD_HOST_SIM
+  #include "lcd_sim.h"
+  #define LCD_CMD_WRITE(r)           lcdSimCmd (r)
+  #define LCD_DATA_WRITE(v)          lcdSimWrite (v)
+  #define LCD_DATA_READ()            lcdSimRead ()
+  #undef  _delay_
+  #define _delay_(n)                 ((void) (n))
+#else
+  #define LCD_CMD_WRITE(r)           (LCD_CMD = (r))
+  #define LCD_DATA_WRITE(v)          (LCD_Data = (v))
+  #define LCD_DATA_READ()            (LCD_Data)
+#endif
+
+#define LCD_REG_NOWAIT(r, v)         do { LCD_CMD_WRITE (r); LCD_DATA_WRITE (v); } while (0)
+
 #define MAX_POLY_CORNERS             200
 #define POLY_Y(Z)                    ((int32_t)((Points + Z)->X))
 #define POLY_X(Z)                    ((int32_t)((Points + Z)->Y))
@@ -84,6 +124,30 @@ static sFONT *LCD_Currentfonts;
   /* Global variables to set the written text color */
 static __IO uint16_t  TextColor = 0x0000, BackColor = 0xFFFF;
 
+  /* DMA transfer state; the DMA sources must not be placed in CCM RAM,
+     which is not accessible by the DMA controllers */
+static volatile uint8_t    dmaBusy   = 0;
+static volatile uint32_t   dmaRemain = 0;
+static const uint16_t     *dmaSrc;
+static uint32_t            dmaIncr;
+#ifndef LCD_HOST_SIM
+static uint32_t            dmaErrors = 0;
+#endif
+static uint16_t            dmaColor  __attribute__ ((section (".RAM1")));
+static uint16_t            glyphBuf[2][LCD_GLYPH_MAX] __attribute__ ((section (".RAM1")));
+static uint8_t             glyphSel  = 0;
+
+  /* expanded glyph cache (LRU), and the text line shadows for dirty-diffing */
+static GlyphTag            glyphTag[LCD_GLYPH_CACHE];
+static uint16_t            glyphPix[LCD_GLYPH_CACHE][LCD_GLYPH_CACHE_PIX] __attribute__ ((section (".RAM1")));
+static uint32_t            glyphStamp = 0;
+static int32_t             glyphLast  = -1;        /* entry of the last blit */
+static TextShadow          shadow[LCD_DIFF_LINES];
+static uint16_t            runBuf[2][LCD_RUN_CHARS * LCD_GLYPH_CACHE_PIX] __attribute__ ((section (".RAM1")));
+static uint8_t             runSel     = 0;
+static uint8_t             shadowUsed = 0;
+static uint8_t             textHold   = 0;        /* shadows only, no drawing */
+
 /**
   * @}
   */
@@ -91,16 +155,29 @@ static __IO uint16_t  TextColor = 0x0000, BackColor = 0xFFFF;
 /** @defgroup stm32f4_discovery_LCD_Private_FunctionPrototypes
   * @{
   */
-#ifndef USE_Delay
-static void  delay (__IO uint32_t nCount);
-#endif /* USE_Delay*/
+#if !defined (USE_Delay) && !defined (LCD_HOST_SIM)
+void  delay (uint32_t count);     /* _delay_, main.c */
+#endif
 static void  PutPixel (int16_t x, int16_t y);
+static void  LCD_SetWindow (uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1);
+static void  LCD_ResetWindow (void);
+static void  LCD_DrawVLinePixelwise (uint16_t Xpos, uint16_t Ypos, uint16_t Length);
+static void  LCD_DrawUniRun (int16_t x, int16_t y, int16_t len, int16_t inc, uint8_t vertical);
+static void  LCD_DmaInit (void);
+static void  LCD_DmaStart (void);
+static void  LCD_DmaDone (void);
+static void  LCD_DmaRect (uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint16_t *pSrc, uint32_t incr);
+static void  LCD_ExpandGlyph (const uint16_t *c, uint16_t *pDst);
+static const uint16_t  *LCD_LookupGlyph (const uint16_t *c);
+static TextShadow      *LCD_FindShadow (uint16_t Line, uint32_t alloc);
+static void  LCD_DrawRun (uint16_t Line, uint16_t Column, const uint8_t *ptr, uint32_t n);
 static void  LCD_PolyLineRelativeClosed (pPoint Points, uint16_t PointCount, uint16_t Closed);
 /**
   * @}
   */
 
 
+#ifndef LCD_HOST_SIM
 /**
   * @brief  LCD Default FSMC Init
   * @param  None
@@ -318,6 +395,7 @@ void  LCD_FSMCConfig (void)
     /* Enable FSMC NOR/SRAM Bank1 */
     FSMC_NORSRAMCmd(FSMC_Bank1_NORSRAM1, ENABLE);
 }
+#endif /* LCD_HOST_SIM */
 
 
 
@@ -327,8 +405,7 @@ void  LCD_FSMCConfig (void)
   */
 void  STM32f4_Discovery_LCD_Init (void)
 {
-    unsigned long ulCount;
-
+#ifndef LCD_HOST_SIM
     LCD_CtrlLinesConfig();    /* Configure the LCD Control pins */
     LCD_FSMCConfig();         /* Configure the FSMC Parallel interface */
 
@@ -338,6 +415,7 @@ void  STM32f4_Discovery_LCD_Init (void)
     GPIO_ResetBits (LCD_RST_PORT, LCD_RST_PIN);
     _delay_(20);
     GPIO_SetBits (LCD_RST_PORT, LCD_RST_PIN);
+#endif
 
     /* Enter sleep mode (if we are not already there).*/
     _delay_(10);
@@ -402,9 +480,8 @@ void  STM32f4_Discovery_LCD_Init (void)
     LCD_WriteReg (SSD2119_Y_RAM_ADDR_REG, 0x00);
 
     /* clear the lcd  */
-    LCD_WriteReg (SSD2119_RAM_DATA_REG, 0x0000);
-    for (ulCount = 0; ulCount < (LCD_PIXEL_WIDTH * LCD_PIXEL_HEIGHT); ulCount++)
-        LCD_WriteRAM (0x0000);
+    LCD_DmaInit ();
+    LCD_DmaFill (0, 0, LCD_PIXEL_WIDTH, LCD_PIXEL_HEIGHT, 0x0000);
     LCD_SetFont (&LCD_DEFAULT_FONT);
 }
 
@@ -418,6 +495,7 @@ void  STM32f4_Discovery_LCD_Init (void)
   */
 void  LCD_SetCursor (uint16_t Xpos, uint16_t Ypos)
 {
+    LCD_DmaWait ();
     LCD_WriteReg(SSD2119_X_RAM_ADDR_REG, Xpos);  /* Set the X address of the display cursor.*/
     LCD_WriteReg(SSD2119_Y_RAM_ADDR_REG, Ypos);  /* Set the Y address of the display cursor.*/
 }
@@ -432,8 +510,9 @@ void  LCD_SetCursor (uint16_t Xpos, uint16_t Ypos)
   */
 void  LCD_WriteReg (uint8_t LCD_Reg, uint16_t LCD_RegValue)
 {
-    LCD_CMD = LCD_Reg;        /* Write 16-bit Index, then Write Reg */
-    LCD_Data = LCD_RegValue;  /* Write 16-bit Reg */
+    LCD_DmaWait ();
+    LCD_CMD_WRITE (LCD_Reg);          /* Write 16-bit Index, then Write Reg */
+    LCD_DATA_WRITE (LCD_RegValue);    /* Write 16-bit Reg */
 }
 
 
@@ -445,8 +524,9 @@ void  LCD_WriteReg (uint8_t LCD_Reg, uint16_t LCD_RegValue)
   */
 uint16_t  LCD_ReadReg (uint8_t LCD_Reg)
 {
-    LCD_CMD = LCD_Reg;    /* Write 16-bit Index (then Read Reg) */
-    return (LCD_Data);    /* Read 16-bit Reg */
+    LCD_DmaWait ();
+    LCD_CMD_WRITE (LCD_Reg);    /* Write 16-bit Index (then Read Reg) */
+    return (LCD_DATA_READ ());  /* Read 16-bit Reg */
 }
 
 
@@ -458,7 +538,8 @@ uint16_t  LCD_ReadReg (uint8_t LCD_Reg)
   */
 void  LCD_WriteRAM_Prepare (void)
 {
-    LCD_CMD = SSD2119_RAM_DATA_REG;
+    LCD_DmaWait ();
+    LCD_CMD_WRITE (SSD2119_RAM_DATA_REG);
 }
 
 
@@ -471,7 +552,7 @@ void  LCD_WriteRAM_Prepare (void)
   */
 void  LCD_WriteRAM (uint16_t RGB_Code)
 {
-    LCD_Data = RGB_Code;   /* Write 16-bit GRAM Reg */
+    LCD_DATA_WRITE (RGB_Code);   /* Write 16-bit GRAM Reg */
 }
 
 
@@ -485,7 +566,7 @@ uint16_t  LCD_ReadRAM (void)
 {
   /* Write 16-bit Index (then Read Reg) */
 //  LCD_CMD = SSD2119_RAM_DATA_REG; /* Select GRAM Reg */
-    return LCD_Data;  /* Read 16-bit Reg */
+    return LCD_DATA_READ ();  /* Read 16-bit Reg */
 }
 
 
@@ -503,15 +584,15 @@ void  LCD_RGB_Test (void)
 
     /* R */
     for (index = 0; index < (LCD_PIXEL_HEIGHT*LCD_PIXEL_WIDTH)/3; index++)
-        LCD_Data = LCD_COLOR_RED;
+        LCD_DATA_WRITE (LCD_COLOR_RED);
 
     /* G */
     for (;index < 2*(LCD_PIXEL_HEIGHT*LCD_PIXEL_WIDTH)/3; index++)
-        LCD_Data = LCD_COLOR_GREEN;
+        LCD_DATA_WRITE (LCD_COLOR_GREEN);
 
     /* B */
     for (; index < LCD_PIXEL_HEIGHT*LCD_PIXEL_WIDTH; index++)
-        LCD_Data = LCD_COLOR_BLUE;
+        LCD_DATA_WRITE (LCD_COLOR_BLUE);
 }
 
 
@@ -568,19 +649,29 @@ void  LCD_SetBackColor (__IO uint16_t Color)
 
 
 
-/** LCD_DisplayOff
+/**
+  * @brief  Disables the display output, and puts the controller to sleep;
+  *         the GRAM content is retained.
+  * @param  None
+  * @retval None
   */
 void  LCD_DisplayOff (void)
 {
+    LCD_WriteReg (SSD2119_DISPLAY_CTRL_REG, 0x0000);
+    LCD_WriteReg (SSD2119_SLEEP_MODE_1_REG, 0x0001);
 }
 
 
 
 /**
-LCD_DisplayOn
+  * @brief  Wakes the controller, and enables the display output.
+  * @param  None
+  * @retval None
   */
 void  LCD_DisplayOn (void)
 {
+    LCD_WriteReg (SSD2119_SLEEP_MODE_1_REG, 0x0000);
+    LCD_WriteReg (SSD2119_DISPLAY_CTRL_REG, 0x0033);
 }
 
 /**
@@ -606,7 +697,8 @@ sFONT  *LCD_GetFont (void)
 }
 
 /**
-  * @brief  Clears the selected line.
+  * @brief  Clears the selected line, with one fill in the back color;
+  *         its shadow then holds blanks.
   * @param  Line: the Line to be cleared.
   *   This parameter can be one of the following values:
   *     @arg Linex: where x can be 0..n
@@ -614,13 +706,18 @@ sFONT  *LCD_GetFont (void)
   */
 void  LCD_ClearLine (uint16_t Line)
 {
-    uint16_t  refcolumn = 0;
+    TextShadow  *ps;
 
-    do
+    ps = LCD_FindShadow (Line, 1);
+    if (ps != 0)
     {
-        LCD_DisplayChar(Line, refcolumn, ' ');       /* Display one character on LCD */
-        refcolumn += LCD_Currentfonts->Width;        /* Decrement the column position by 16 */
-    } while (refcolumn < LCD_PIXEL_WIDTH);
+        memset (ps->chars, ' ', sizeof (ps->chars));
+        ps->text = TextColor;
+        ps->back = BackColor;
+        ps->font = LCD_Currentfonts;
+    }
+    if (!textHold)
+        LCD_DmaFill (0, Line, LCD_PIXEL_WIDTH, LCD_Currentfonts->Height, BackColor);
 }
 
 
@@ -631,12 +728,8 @@ void  LCD_ClearLine (uint16_t Line)
   */
 void  LCD_Clear (uint16_t Color)
 {
-    uint32_t  index = 0;
-
-    LCD_SetCursor (0x00, 0x00);
-    LCD_WriteRAM_Prepare (); /* Prepare to write GRAM */
-    for (index = 0; index < LCD_PIXEL_HEIGHT*LCD_PIXEL_WIDTH; index++)
-        LCD_Data = Color;
+    shadowUsed = 0;
+    LCD_DmaFill (0, 0, LCD_PIXEL_WIDTH, LCD_PIXEL_HEIGHT, Color);
 }
 
 /**
@@ -662,25 +755,94 @@ static void  PutPixel (int16_t x, int16_t y)
   */
 void  LCD_DrawChar (uint16_t Xpos, uint16_t Ypos, const uint16_t *c)
 {
-    uint32_t  index = 0, i = 0;
-    uint16_t  Xaddress = 0;
+    const uint16_t  *pGlyph;
 
-    Xaddress = Xpos;
-    LCD_SetCursor (Ypos, Xaddress);
-    for (index = 0; index < LCD_Currentfonts->Height; index++)
+    pGlyph = LCD_LookupGlyph (c);
+    if (pGlyph == 0)
     {
-        LCD_WriteRAM_Prepare (); /* Prepare to write GRAM */
-        for(i = 0; i < LCD_Currentfonts->Width; i++)
+        /* font too large for the cache; expand into the buffer
+           not used by a running blit */
+        pGlyph    = glyphBuf[glyphSel];
+        glyphSel ^= 1;
+        LCD_ExpandGlyph (c, (uint16_t *) pGlyph);
+    }
+    LCD_DmaBlit (Ypos, Xpos, LCD_Currentfonts->Width, LCD_Currentfonts->Height, pGlyph);
+}
+
+
+
+/**
+  * @brief  Expands a glyph to RGB565 pixels in the current colors.
+  * @param  c: pointer to the character data.
+  * @param  pDst: Width*Height pixels.
+  * @retval None
+  */
+static void  LCD_ExpandGlyph (const uint16_t *c, uint16_t *pDst)
+{
+    uint32_t  row, i, bits, mask;
+    uint16_t  w, text, back;
+
+    w    = LCD_Currentfonts->Width;
+    text = TextColor;
+    back = BackColor;
+    for (row = 0; row < LCD_Currentfonts->Height; row++)
+    {
+        bits = c[row];
+        if (w > 12)
+        {
+            /* wide fonts: LSB first */
+            for (i = 0; i < w; i++, bits >>= 1)
+                *pDst++ = (bits & 1) ? text : back;
+        }
+        else
+        {
+            /* narrow fonts: MSB first, left aligned in 8 or 16 bits */
+            mask = 0x80UL << ((w / 12) * 8);
+            for (i = 0; i < w; i++, mask >>= 1)
+                *pDst++ = (bits & mask) ? text : back;
+        }
+    }
+}
+
+
+
+/**
+  * @brief  Looks up a glyph in the current colors in the cache, expanding it
+  *         into the least recently used entry on a miss.
+  * @param  c: pointer to the character data.
+  * @retval the expanded glyph, or 0 if the font is too large for the cache.
+  */
+static const uint16_t  *LCD_LookupGlyph (const uint16_t *c)
+{
+    uint32_t  i, victim;
+
+    if (LCD_Currentfonts->Width * LCD_Currentfonts->Height > LCD_GLYPH_CACHE_PIX)
+        return (0);
+
+    glyphStamp++;
+    for (i = 0, victim = 0; i < LCD_GLYPH_CACHE; i++)
+    {
+        if ((glyphTag[i].used != 0) && (glyphTag[i].pChar == c) &&
+            (glyphTag[i].text == TextColor) && (glyphTag[i].back == BackColor))
         {
-          if ((((c[index] & ((0x80 << ((LCD_Currentfonts->Width / 12 ) * 8 ) ) >> i)) == 0x00) &&(LCD_Currentfonts->Width <= 12))||
-             (((c[index] & (0x1 << i)) == 0x00)&&(LCD_Currentfonts->Width > 12)))
-              LCD_WriteRAM (BackColor);
-          else
-              LCD_WriteRAM (TextColor);
+            glyphTag[i].used = glyphStamp;
+            glyphLast        = i;
+            return (glyphPix[i]);
         }
-        Xaddress++;
-        LCD_SetCursor (Ypos, Xaddress);
+        if (glyphTag[i].used < glyphTag[victim].used)
+            victim = i;
     }
+
+    /* miss; the entry of the last blit may still be in transfer */
+    if ((int32_t) victim == glyphLast)
+        LCD_DmaWait ();
+    LCD_ExpandGlyph (c, glyphPix[victim]);
+    glyphTag[victim].pChar = c;
+    glyphTag[victim].text  = TextColor;
+    glyphTag[victim].back  = BackColor;
+    glyphTag[victim].used  = glyphStamp;
+    glyphLast              = victim;
+    return (glyphPix[victim]);
 }
 
 
@@ -726,6 +888,181 @@ void  LCD_DisplayStringLine (uint16_t Line, uint8_t *ptr)
 
 
 
+/**
+  * @brief  Displays a string like LCD_DisplayStringLine(), but only redraws
+  *         the characters that differ from the last call for this line
+  *         (up to LCD_DIFF_LINES lines are tracked; others are drawn fully);
+  *         adjacent changed characters are drawn as one windowed burst.
+  * @param  Line: the Line where to display the character shape .
+  * @param  *ptr: pointer to string to display on LCD.
+  * @retval None
+  */
+void  LCD_DisplayStringLineDiff (uint16_t Line, uint8_t *ptr)
+{
+    TextShadow  *ps;
+    uint16_t     refcolumn = 0;
+    uint32_t     i, run;
+
+    ps = LCD_FindShadow (Line, 1);
+    if (ps == 0)
+    {
+        if (!textHold)
+            LCD_DisplayStringLine (Line, ptr);
+        return;
+    }
+    if ((ps->text != TextColor) || (ps->back != BackColor) || (ps->font != LCD_Currentfonts))
+    {
+        memset (ps->chars, 0, sizeof (ps->chars));
+        ps->text = TextColor;
+        ps->back = BackColor;
+        ps->font = LCD_Currentfonts;
+    }
+
+    for (i = 0, run = 0; (ptr[i] != 0) && (refcolumn < LCD_PIXEL_WIDTH); i++)
+    {
+        if (ps->chars[i] != ptr[i])
+        {
+            ps->chars[i] = ptr[i];
+            if (++run == LCD_RUN_CHARS)
+            {
+                if (!textHold)
+                    LCD_DrawRun (Line, refcolumn - (run - 1) * LCD_Currentfonts->Width, &ptr[i + 1 - run], run);
+                run = 0;
+            }
+        }
+        else if (run)
+        {
+            if (!textHold)
+                LCD_DrawRun (Line, refcolumn - run * LCD_Currentfonts->Width, &ptr[i - run], run);
+            run = 0;
+        }
+        refcolumn += LCD_Currentfonts->Width;
+    }
+    if (run && !textHold)
+        LCD_DrawRun (Line, refcolumn - run * LCD_Currentfonts->Width, &ptr[i - run], run);
+}
+
+
+
+/**
+  * @brief  Draws adjacent characters as one burst: their cached glyphs are
+  *         assembled row by row into a run buffer, which is blitted through
+  *         one GRAM window; fonts too large for the glyph cache are drawn
+  *         character by character.
+  * @param  Line: the Line (pixel row).
+  * @param  Column: pixel column of the first character.
+  * @param  ptr: the characters.
+  * @param  n: number of characters, at most LCD_RUN_CHARS.
+  * @retval None
+  */
+static void  LCD_DrawRun (uint16_t Line, uint16_t Column, const uint8_t *ptr, uint32_t n)
+{
+    const uint16_t  *pGlyph;
+    uint16_t        *pRun;
+    uint32_t         k, row, w, h;
+
+    w = LCD_Currentfonts->Width;
+    h = LCD_Currentfonts->Height;
+    if (w * h > LCD_GLYPH_CACHE_PIX)
+    {
+        for (k = 0; k < n; k++, Column += w)
+            LCD_DisplayChar (Line, Column, ptr[k]);
+        return;
+    }
+
+    /* only the last transfer may still be running, from the other buffer */
+    pRun    = runBuf[runSel];
+    runSel ^= 1;
+    for (k = 0; k < n; k++)
+    {
+        pGlyph = LCD_LookupGlyph (&LCD_Currentfonts->table[(ptr[k] - 32) * h]);
+        for (row = 0; row < h; row++)
+            memcpy (&pRun[row * n * w + k * w], &pGlyph[row * w], w * sizeof (uint16_t));
+    }
+    LCD_DmaBlit (Column, Line, n * w, h, pRun);
+}
+
+
+
+/**
+  * @brief  Finds the shadow of a text line, optionally allocating one.
+  * @param  Line: the Line (pixel row).
+  * @param  alloc: 1 to allocate a free shadow if there is none.
+  * @retval the shadow, or 0.
+  */
+static TextShadow  *LCD_FindShadow (uint16_t Line, uint32_t alloc)
+{
+    uint32_t  i;
+
+    for (i = 0; i < shadowUsed; i++)
+        if (shadow[i].line == Line)
+            return (&shadow[i]);
+    if (!alloc || (shadowUsed >= LCD_DIFF_LINES))
+        return (0);
+
+    memset (&shadow[shadowUsed], 0, sizeof (TextShadow));
+    shadow[shadowUsed].line = Line;
+    return (&shadow[shadowUsed++]);
+}
+
+
+
+/**
+  * @brief  Holds or releases the text output of LCD_DisplayStringLineDiff();
+  *         while held, only the line shadows are updated, e.g. while the
+  *         screen is scrolled; on release, all tracked lines are redrawn.
+  * @param  Hold: 1 to hold, 0 to release.
+  * @retval None
+  */
+void  LCD_TextHold (uint32_t Hold)
+{
+    uint16_t  text, back, refcolumn;
+    sFONT    *font;
+    uint32_t  i, k;
+
+    if (Hold || !textHold)
+    {
+        textHold = (Hold != 0);
+        return;
+    }
+    textHold = 0;
+
+    text = TextColor;
+    back = BackColor;
+    font = LCD_Currentfonts;
+    for (i = 0; i < shadowUsed; i++)
+    {
+        TextColor        = shadow[i].text;
+        BackColor        = shadow[i].back;
+        LCD_Currentfonts = shadow[i].font;
+        for (k = 0, refcolumn = 0; (k < sizeof (shadow[i].chars)) && (shadow[i].chars[k] != 0); k++)
+        {
+            LCD_DisplayChar (shadow[i].line, refcolumn, shadow[i].chars[k]);
+            refcolumn += LCD_Currentfonts->Width;
+        }
+    }
+    TextColor        = text;
+    BackColor        = back;
+    LCD_Currentfonts = font;
+}
+
+
+
+/**
+  * @brief  Sets the hardware vertical scroll; the gate scan starts at GRAM
+  *         row Lines, i.e. display row r shows GRAM row (r + Lines) modulo
+  *         LCD_PIXEL_HEIGHT. The whole panel is scrolled, GRAM addressing
+  *         is not affected.
+  * @param  Lines: scroll amount, 0 .. LCD_PIXEL_HEIGHT-1.
+  * @retval None
+  */
+void  LCD_SetScroll (uint16_t Lines)
+{
+    LCD_WriteReg (SSD2119_V_SCROLL_CTRL_REG, Lines % LCD_PIXEL_HEIGHT);
+}
+
+
+
 /**
   * @brief  Sets a display window
   * @param  Xpos: specifies the X bottom left position.
@@ -749,7 +1086,7 @@ void  LCD_SetDisplayWindow (uint16_t Xpos, uint16_t Ypos, uint16_t width, uint16
         value = (LCD_PIXEL_HEIGHT-1) << 8;
     else
         value = (Ypos+Height) << 8;
-    value |= Xpos;
+    value |= Ypos;
 
     LCD_WriteReg (SSD2119_V_RAM_POS_REG, value);
     LCD_SetCursor (Xpos, Ypos);
@@ -772,9 +1109,270 @@ void LCD_WindowModeDisable(void)
 
 
 
-//#define WINDOWED_DRAW_LINE
 /**
-  * @brief  Displays a line.
+  * @brief  Sets the GRAM window (inclusive corners); the address counter
+  *         auto-increments within it, and wraps to the next row at x1.
+  * @param  x0, y0: upper left corner.
+  * @param  x1, y1: lower right corner.
+  * @retval None
+  */
+static void  LCD_SetWindow (uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1)
+{
+    LCD_DmaWait ();
+    LCD_REG_NOWAIT (SSD2119_H_RAM_START_REG, x0);
+    LCD_REG_NOWAIT (SSD2119_H_RAM_END_REG, x1);
+    LCD_REG_NOWAIT (SSD2119_V_RAM_POS_REG, (y1 << 8) | y0);
+}
+
+
+
+/**
+  * @brief  Restores the full screen GRAM window.
+  * @param  None
+  * @retval None
+  */
+static void  LCD_ResetWindow (void)
+{
+    LCD_SetWindow (0, 0, LCD_PIXEL_WIDTH-1, LCD_PIXEL_HEIGHT-1);
+}
+
+
+
+/**
+  * @brief  Configures the DMA stream for memory-to-memory transfers into
+  *         the FSMC LCD data address (halfwords, destination fixed), and
+  *         enables its completion interrupt.
+  * @param  None
+  * @retval None
+  */
+#ifdef LCD_HOST_SIM
+static void  LCD_DmaInit (void)
+{
+    dmaBusy = 0;
+}
+
+
+
+/**
+  * @brief  Host simulation: the transfer is written through at once.
+  * @param  None
+  * @retval None
+  */
+static void  LCD_DmaStart (void)
+{
+    for ( ; dmaRemain; dmaRemain--, dmaSrc += dmaIncr)
+        LCD_DATA_WRITE (*dmaSrc);
+    LCD_DmaDone ();
+}
+
+#else
+static void  LCD_DmaInit (void)
+{
+    DMA_InitTypeDef   DMA_InitStructure;
+    NVIC_InitTypeDef  NVIC_InitStructure;
+
+    RCC_AHB1PeriphClockCmd (LCD_DMA_CLK, ENABLE);
+    DMA_DeInit (LCD_DMA_STREAM);
+    while (DMA_GetCmdStatus (LCD_DMA_STREAM) != DISABLE)
+        ;
+
+    DMA_StructInit (&DMA_InitStructure);
+    DMA_InitStructure.DMA_Channel            = LCD_DMA_CHANNEL;
+    DMA_InitStructure.DMA_PeripheralBaseAddr = (uint32_t) &dmaColor;   /* source in M2M mode */
+    DMA_InitStructure.DMA_Memory0BaseAddr    = LCD_BASE_Data;
+    DMA_InitStructure.DMA_DIR                = DMA_DIR_MemoryToMemory;
+    DMA_InitStructure.DMA_BufferSize         = 1;
+    DMA_InitStructure.DMA_PeripheralInc      = DMA_PeripheralInc_Disable;
+    DMA_InitStructure.DMA_MemoryInc          = DMA_MemoryInc_Disable;
+    DMA_InitStructure.DMA_PeripheralDataSize = DMA_PeripheralDataSize_HalfWord;
+    DMA_InitStructure.DMA_MemoryDataSize     = DMA_MemoryDataSize_HalfWord;
+    DMA_InitStructure.DMA_Mode               = DMA_Mode_Normal;
+    DMA_InitStructure.DMA_Priority           = DMA_Priority_Medium;
+    DMA_InitStructure.DMA_FIFOMode           = DMA_FIFOMode_Enable;       /* no direct mode for M2M */
+    DMA_InitStructure.DMA_FIFOThreshold      = DMA_FIFOThreshold_HalfFull;
+    DMA_InitStructure.DMA_MemoryBurst        = DMA_MemoryBurst_Single;
+    DMA_InitStructure.DMA_PeripheralBurst    = DMA_PeripheralBurst_Single;
+    DMA_Init (LCD_DMA_STREAM, &DMA_InitStructure);
+    DMA_ITConfig (LCD_DMA_STREAM, DMA_IT_TC | DMA_IT_TE, ENABLE);
+
+    NVIC_InitStructure.NVIC_IRQChannel                   = LCD_DMA_IRQn;
+    NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 1;
+    NVIC_InitStructure.NVIC_IRQChannelSubPriority        = 0;
+    NVIC_InitStructure.NVIC_IRQChannelCmd                = ENABLE;
+    NVIC_Init (&NVIC_InitStructure);
+
+    dmaBusy = 0;
+}
+
+
+
+/**
+  * @brief  Starts the next chunk (at most LCD_DMA_MAX_ITEMS) of the transfer.
+  * @param  None
+  * @retval None
+  */
+static void  LCD_DmaStart (void)
+{
+    uint32_t  n;
+
+    n = (dmaRemain > LCD_DMA_MAX_ITEMS) ? LCD_DMA_MAX_ITEMS : dmaRemain;
+    if (dmaIncr)
+        LCD_DMA_STREAM->CR |= DMA_SxCR_PINC;
+    else
+        LCD_DMA_STREAM->CR &= ~DMA_SxCR_PINC;
+    LCD_DMA_STREAM->PAR  = (uint32_t) dmaSrc;
+    LCD_DMA_STREAM->NDTR = n;
+    dmaRemain -= n;
+    if (dmaIncr)
+        dmaSrc += n;
+
+    DMA_ClearFlag (LCD_DMA_STREAM, LCD_DMA_FLAG_TCIF | LCD_DMA_FLAG_TEIF | LCD_DMA_FLAG_FEIF);
+    LCD_DMA_STREAM->CR |= DMA_SxCR_EN;
+}
+#endif /* LCD_HOST_SIM */
+
+
+
+/**
+  * @brief  Ends a transfer: restores the full screen window, and releases
+  *         the bus (no waiting, may be called from the DMA interrupt).
+  * @param  None
+  * @retval None
+  */
+static void  LCD_DmaDone (void)
+{
+    LCD_REG_NOWAIT (SSD2119_H_RAM_START_REG, 0);
+    LCD_REG_NOWAIT (SSD2119_H_RAM_END_REG, LCD_PIXEL_WIDTH-1);
+    LCD_REG_NOWAIT (SSD2119_V_RAM_POS_REG, (LCD_PIXEL_HEIGHT-1) << 8);
+    dmaBusy = 0;
+}
+
+
+
+/**
+  * @brief  Streams a rectangle into GRAM by DMA, via a GRAM window; returns
+  *         without waiting, the next LCD access waits for completion.
+  * @param  x, y: upper left corner.
+  * @param  w, h: rectangle width and height, clipped to the screen.
+  * @param  pSrc: pixel source, w*h pixels if <incr>, else one pixel.
+  * @param  incr: 1 to increment the source address.
+  * @retval None
+  */
+static void  LCD_DmaRect (uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint16_t *pSrc, uint32_t incr)
+{
+    if ((x >= LCD_PIXEL_WIDTH) || (y >= LCD_PIXEL_HEIGHT) || (w == 0) || (h == 0))
+        return;
+    if (w > LCD_PIXEL_WIDTH - x)
+        w = LCD_PIXEL_WIDTH - x;
+    if (h > LCD_PIXEL_HEIGHT - y)
+        h = LCD_PIXEL_HEIGHT - y;
+
+    LCD_SetWindow (x, y, x + w - 1, y + h - 1);
+    LCD_SetCursor (x, y);
+    LCD_WriteRAM_Prepare ();
+
+    dmaSrc    = pSrc;
+    dmaIncr   = incr;
+    dmaRemain = (uint32_t) w * h;
+    dmaBusy   = 1;
+    LCD_DmaStart ();
+}
+
+
+
+/**
+  * @brief  Fills a rectangle with one color by DMA (fixed source address).
+  * @param  x, y: upper left corner.
+  * @param  w, h: rectangle width and height.
+  * @param  Color: fill color.
+  * @retval None
+  */
+void  LCD_DmaFill (uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t Color)
+{
+    LCD_DmaWait ();
+    dmaColor = Color;
+    LCD_DmaRect (x, y, w, h, &dmaColor, 0);
+}
+
+
+
+/**
+  * @brief  Copies a rectangular RGB565 image (row by row, w*h pixels) into
+  *         GRAM by DMA; <pSrc> must stay valid until LCD_DmaBusy() is 0,
+  *         and must not reside in CCM RAM. The image should not be wider
+  *         than the screen part right of x, since rows are not clipped.
+  * @param  x, y: upper left corner.
+  * @param  w, h: image width and height.
+  * @param  pSrc: the image.
+  * @retval None
+  */
+void  LCD_DmaBlit (uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint16_t *pSrc)
+{
+    LCD_DmaRect (x, y, w, h, pSrc, 1);
+}
+
+
+
+/**
+  * @brief  Returns 1 while a DMA transfer to the LCD is running.
+  * @param  None
+  * @retval busy flag.
+  */
+uint32_t  LCD_DmaBusy (void)
+{
+    return (dmaBusy);
+}
+
+
+
+/**
+  * @brief  Waits for a running DMA transfer to complete.
+  * @param  None
+  * @retval None
+  */
+void  LCD_DmaWait (void)
+{
+    while (dmaBusy)
+        ;
+}
+
+
+
+/**
+  * @brief  DMA completion interrupt; starts the next chunk, or restores the
+  *         full screen window at the end. To be called from LCD_DMA_IRQHANDLER.
+  * @param  None
+  * @retval None
+  */
+#ifndef LCD_HOST_SIM
+void  LCD_DmaIRQ (void)
+{
+    if (DMA_GetITStatus (LCD_DMA_STREAM, LCD_DMA_IT_TEIF) != RESET)
+    {
+        DMA_ClearITPendingBit (LCD_DMA_STREAM, LCD_DMA_IT_TEIF);
+        dmaErrors++;
+        dmaRemain = 0;
+    }
+    else if (DMA_GetITStatus (LCD_DMA_STREAM, LCD_DMA_IT_TCIF) != RESET)
+        DMA_ClearITPendingBit (LCD_DMA_STREAM, LCD_DMA_IT_TCIF);
+    else
+        return;
+
+    if (dmaRemain)
+    {
+        LCD_DmaStart ();
+        return;
+    }
+    LCD_DmaDone ();
+}
+#endif /* LCD_HOST_SIM */
+
+
+
+/**
+  * @brief  Displays a line; clipped to the screen.
+  *         Vertical lines use a one column wide window, so the whole line
+  *         is streamed as one GRAM burst instead of a cursor move per pixel.
   * @param Xpos: specifies the X position.
   * @param Ypos: specifies the Y position.
   * @param Length: line length.
@@ -782,54 +1380,94 @@ void LCD_WindowModeDisable(void)
   *   This parameter can be one of the following values: Vertical or Horizontal.
   * @retval None
   */
-#ifndef WINDOWED_DRAW_LINE
 void  LCD_DrawLine (uint16_t Xpos, uint16_t Ypos, uint16_t Length, uint8_t Direction)
 {
     uint32_t  i=0;
 
-    LCD_SetCursor (Xpos, Ypos);
+    if ((Xpos >= LCD_PIXEL_WIDTH) || (Ypos >= LCD_PIXEL_HEIGHT))
+        return;
+
     if (Direction == LCD_DIR_HORIZONTAL)
     {
+        if (Length > LCD_PIXEL_WIDTH - Xpos)
+            Length = LCD_PIXEL_WIDTH - Xpos;
+        LCD_SetCursor (Xpos, Ypos);
         LCD_WriteRAM_Prepare(); /* Prepare to write GRAM */
         for(i=0; i<Length; i++)
             LCD_WriteRAM(TextColor);
     }
     else
     {
+        if (Length > LCD_PIXEL_HEIGHT - Ypos)
+            Length = LCD_PIXEL_HEIGHT - Ypos;
+        if (Length == 0)
+            return;
+        LCD_SetWindow (Xpos, Ypos, Xpos, Ypos + Length - 1);
+        LCD_SetCursor (Xpos, Ypos);
+        LCD_WriteRAM_Prepare(); /* Prepare to write GRAM */
         for(i=0; i<Length; i++)
-        {
-            LCD_WriteRAM_Prepare(); /* Prepare to write GRAM */
             LCD_WriteRAM(TextColor);
-            Ypos++;
-            LCD_SetCursor(Xpos, Ypos);
-        }
+        LCD_ResetWindow ();
     }
 }
 
-#else
 
-void  LCD_DrawLine (uint16_t Xpos, uint16_t Ypos, uint16_t Length, uint8_t Direction)
+
+/**
+  * @brief  Displays a vertical line pixel by pixel (cursor move per pixel);
+  *         the former LCD_DrawLine() path, kept as benchmark reference.
+  * @param Xpos: specifies the X position.
+  * @param Ypos: specifies the Y position.
+  * @param Length: line length.
+  * @retval None
+  */
+static void  LCD_DrawVLinePixelwise (uint16_t Xpos, uint16_t Ypos, uint16_t Length)
 {
     uint32_t  i=0;
 
-    if (Direction == LCD_DIR_HORIZONTAL)
+    LCD_SetCursor (Xpos, Ypos);
+    for(i=0; i<Length; i++)
     {
-        LCD_SetCursor (Xpos, Ypos);
         LCD_WriteRAM_Prepare(); /* Prepare to write GRAM */
-        for(i=0; i<Length; i++)
-            LCD_WriteRAM(TextColor);
+        LCD_WriteRAM(TextColor);
+        Ypos++;
+        LCD_SetCursor(Xpos, Ypos);
     }
+}
 
-    else
-    {
-        LCD_SetDisplayWindow (Xpos, Ypos, 1, Length);
-        LCD_WriteRAM_Prepare(); /* Prepare to write GRAM */
-        for(i=0; i<Length; i++)
-            LCD_WriteRAM(TextColor);
-        LCD_SetDisplayWindow (0, 0, LCD_PIXEL_WIDTH-1, LCD_PIXEL_HEIGHT-1);
-    }
+
+
+/**
+  * @brief  Measures vertical line throughput, for the pixelwise and the
+  *         windowed burst path; draws LCD_BENCH_LINES full height lines each,
+  *         in the back color, from x = 0; to be called before the screen
+  *         content is drawn (the text line shadows are not updated).
+  * @param  pPixelwise: pixels/s of the pixelwise path.
+  * @param  pBurst: pixels/s of the windowed burst path.
+  * @retval None
+  */
+void  LCD_LineBenchmark (uint32_t *pPixelwise, uint32_t *pBurst)
+{
+    uint32_t  i, t0, t1, t2;
+    uint16_t  color;
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL        |= DWT_CTRL_CYCCNTENA_Msk;
+    color = TextColor;
+    TextColor = BackColor;
+
+    t0 = DWT->CYCCNT;
+    for (i=0; i<LCD_BENCH_LINES; i++)
+        LCD_DrawVLinePixelwise (i, 0, LCD_PIXEL_HEIGHT);
+    t1 = DWT->CYCCNT;
+    for (i=0; i<LCD_BENCH_LINES; i++)
+        LCD_DrawLine (i, 0, LCD_PIXEL_HEIGHT, LCD_DIR_VERTICAL);
+    t2 = DWT->CYCCNT;
+
+    TextColor   = color;
+    *pPixelwise = (uint32_t) (((uint64_t) LCD_BENCH_LINES * LCD_PIXEL_HEIGHT * SystemCoreClock) / (t1 - t0));
+    *pBurst     = (uint32_t) (((uint64_t) LCD_BENCH_LINES * LCD_PIXEL_HEIGHT * SystemCoreClock) / (t2 - t1));
 }
-#endif
 
 
 /**
@@ -981,20 +1619,12 @@ void  LCD_WriteBMP (uint32_t BmpAddress)
   */
 void  LCD_DrawFullRect (uint16_t Xpos, uint16_t Ypos, uint16_t Width, uint16_t Height)
 {
-    LCD_SetTextColor(TextColor);
-
     LCD_DrawLine (Xpos, Ypos, Width, LCD_DIR_HORIZONTAL);
     LCD_DrawLine (Xpos, (Ypos+Height), Width, LCD_DIR_HORIZONTAL);
-    LCD_DrawLine (Xpos, Ypos, Height, LCD_DIR_VERTICAL);
-    LCD_DrawLine ((Xpos+Width-1), Ypos, Height, LCD_DIR_VERTICAL);
-    Height--;
-    Ypos++;
-    LCD_SetTextColor (BackColor);
-
-    while(Height--)
-        LCD_DrawLine(Xpos, Ypos++, Width, LCD_DIR_HORIZONTAL);
 
-    LCD_SetTextColor(TextColor);
+    /* the inner rows (which cover the side lines) as one DMA fill */
+    if (Height > 1)
+        LCD_DmaFill (Xpos, Ypos+1, Width, Height-1, BackColor);
 }
 
 
@@ -1057,6 +1687,7 @@ void  LCD_DrawUniLine (uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2)
 {
     int16_t  deltax = 0, deltay = 0, x = 0, y = 0, xinc1 = 0, xinc2 = 0, yinc1 = 0;
     int16_t  yinc2 = 0, den = 0, num = 0, numadd = 0, numpixels = 0, curpixel = 0;
+    int16_t  runX = 0, runY = 0, runLen = 0;
 
     deltax = ABS(x2 - x1);          /* The difference between the x's */
     deltay = ABS(y2 - y1);          /* The difference between the y's */
@@ -1104,9 +1735,21 @@ void  LCD_DrawUniLine (uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2)
         numpixels = deltay;         /* There are more y-values than x-values */
     }
 
+    /* pixels along the major axis that share the minor coordinate form a
+       run, drawn as one line (burst) instead of pixel by pixel */
+    runX = x;
+    runY = y;
+    runLen = 0;
     for (curpixel = 0; curpixel <= numpixels; curpixel++)
     {
-        PutPixel(x, y);             /* Draw the current pixel */
+        if ((runLen > 0) && ((yinc2 != 0) ? (x != runX) : (y != runY)))
+        {
+            LCD_DrawUniRun (runX, runY, runLen, xinc2 + yinc2, (yinc2 != 0));
+            runX   = x;
+            runY   = y;
+            runLen = 0;
+        }
+        runLen++;
         num += numadd;              /* Increase the numerator by the top of the fraction */
         if (num >= den)             /* Check if numerator >= denominator */
         {
@@ -1117,6 +1760,27 @@ void  LCD_DrawUniLine (uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2)
         x += xinc2;                 /* Change the x as appropriate */
         y += yinc2;                 /* Change the y as appropriate */
     }
+    LCD_DrawUniRun (runX, runY, runLen, xinc2 + yinc2, (yinc2 != 0));
+}
+
+
+
+/**
+  * @brief  Draws one run of a uni-line.
+  * @param  x, y: first pixel of the run.
+  * @param  len: run length.
+  * @param  inc: step along the run (+1 / -1).
+  * @param  vertical: 1 for a vertical run.
+  * @retval None
+  */
+static void  LCD_DrawUniRun (int16_t x, int16_t y, int16_t len, int16_t inc, uint8_t vertical)
+{
+    if (len == 1)
+        PutPixel (x, y);
+    else if (vertical)
+        LCD_DrawLine (x, (inc > 0) ? y : y - len + 1, len, LCD_DIR_VERTICAL);
+    else
+        LCD_DrawLine ((inc > 0) ? x : x - len + 1, y, len, LCD_DIR_HORIZONTAL);
 }
 
 /**
@@ -118,6 +118,7 @@ typedef struct
 #define SSD2119_GAMMA_CTRL_8_REG       0x37
 #define SSD2119_GAMMA_CTRL_9_REG       0x3A
 #define SSD2119_GAMMA_CTRL_10_REG      0x3B
+#define SSD2119_V_SCROLL_CTRL_REG      0x41
 #define SSD2119_V_RAM_POS_REG          0x44
 #define SSD2119_H_RAM_START_REG        0x45
 #define SSD2119_H_RAM_END_REG          0x46
@@ -269,6 +270,33 @@ typedef struct
 #define LCD_PIXEL_WIDTH          320
 #define LCD_PIXEL_HEIGHT         240
 
+/** 
+  * @brief  Full height lines drawn per path by LCD_LineBenchmark()
+  */ 
+#define LCD_BENCH_LINES          64
+
+/** 
+  * @brief  DMA for fills and blits (memory-to-memory into the FSMC data
+  *         address, so DMA2 only); stream 3 is used by the SDIO driver
+  */ 
+#define LCD_DMA_CLK              RCC_AHB1Periph_DMA2
+#define LCD_DMA_STREAM           DMA2_Stream0
+#define LCD_DMA_CHANNEL          DMA_Channel_0
+#define LCD_DMA_FLAG_TCIF        DMA_FLAG_TCIF0
+#define LCD_DMA_FLAG_TEIF        DMA_FLAG_TEIF0
+#define LCD_DMA_FLAG_FEIF        DMA_FLAG_FEIF0
+#define LCD_DMA_IT_TCIF          DMA_IT_TCIF0
+#define LCD_DMA_IT_TEIF          DMA_IT_TEIF0
+#define LCD_DMA_IRQn             DMA2_Stream0_IRQn
+#define LCD_DMA_IRQHANDLER       DMA2_Stream0_IRQHandler
+#define LCD_DMA_MAX_ITEMS        65535      /* NDTR limit per transfer */
+
+#define LCD_GLYPH_MAX            (16*24)    /* largest font, pixels */
+#define LCD_GLYPH_CACHE          32         /* expanded glyph cache entries */
+#define LCD_GLYPH_CACHE_PIX      (8*12)     /* largest cached glyph, pixels */
+#define LCD_DIFF_LINES           (LCD_PIXEL_HEIGHT/8)  /* text lines tracked for diffing (all) */
+#define LCD_RUN_CHARS            10         /* changed characters per coalesced burst */
+
 /**
   * @}
   */ 
@@ -302,9 +330,18 @@ void   LCD_DisplayChar (uint16_t Line, uint16_t Column, uint8_t Ascii);
 void   LCD_SetFont (sFONT *fonts);
 sFONT *LCD_GetFont (void);
 void   LCD_DisplayStringLine (uint16_t Line, uint8_t *ptr);
+void   LCD_DisplayStringLineDiff (uint16_t Line, uint8_t *ptr);
+void   LCD_TextHold (uint32_t Hold);
+void   LCD_SetScroll (uint16_t Lines);
 void   LCD_SetDisplayWindow (uint16_t Xpos, uint16_t Ypos, uint16_t Height, uint16_t Width);
 void   LCD_WindowModeDisable (void);
 void   LCD_DrawLine (uint16_t Xpos, uint16_t Ypos, uint16_t Length, uint8_t Direction);
+void   LCD_LineBenchmark (uint32_t *pPixelwise, uint32_t *pBurst);
+void   LCD_DmaFill (uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t Color);
+void   LCD_DmaBlit (uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint16_t *pSrc);
+uint32_t  LCD_DmaBusy (void);
+void   LCD_DmaWait (void);
+void   LCD_DmaIRQ (void);
 void   LCD_DrawRect (uint16_t Xpos, uint16_t Ypos, uint8_t Height, uint16_t Width);
 void   LCD_DrawCircle (uint16_t Xpos, uint16_t Ypos, uint16_t Radius);
 void   LCD_DrawMonoPict (const uint32_t *Pict);
@@ -9,6 +9,8 @@
 #include "stm32f4xx.h"
 #include "ffconf.h"
 #include "stm32f4_discovery_sdio_sd.h"
+#include "prof.h"
+#include "trace.h"
 
 /*-----------------------------------------------------------------------*/
 /* Correspondence between physical drive number and physical drive.      */
@@ -102,11 +104,15 @@ DRESULT  disk_write (BYTE drv, const BYTE *buff, DWORD sector, BYTE count)
 {
     SD_Error status = SD_OK;
 
+    PROF_ENTER (PROF_ZONE_DISK_WRITE);
+    TRACE (TRACE_SD_BEGIN, sector);
     SD_WriteMultiBlocks ((BYTE *) buff, sector << 9, 512, 1);
 
     /* Check if the Transfer is finished */
     status = SD_WaitWriteOperation();
     while(SD_GetStatus() != SD_TRANSFER_OK);     
+    PROF_EXIT (PROF_ZONE_DISK_WRITE);
+    TRACE (TRACE_SD_END, status);
     if (status == SD_OK)
         return RES_OK;
     else
@@ -0,0 +1,118 @@
+/* ---------------------------------------------------------------------------
+ * staged start-up;
+ * the DWT cycle counter is cleared at the start of main(), and is the time
+ * base of the stage marks (the clock setup in SystemInit is not counted);
+ * bootTask runs the current step, and moves on once it returns 1; a step
+ * may block (the SD card mount), the SysTick keeps sampling into its FIFO
+ * meanwhile; with the last step done, the stage times are sent
+ * ---------------------------------------------------------------------------
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdio.h>
+#include <string.h>
+#include "stm32f4xx.h"
+#include "main.h"
+#include "boot.h"
+
+/* Private define ------------------------------------------------------------*/
+#define STAGE_OPEN             0xFFFFFFFF
+
+/* Private variables ---------------------------------------------------------*/
+extern uint16_t           serialActive;
+
+static const BootStep    *steps;
+static uint32_t           nSteps = 0;
+static uint32_t           step   = 0;
+static uint8_t            done   = 0;
+static volatile uint32_t  stageUs[BOOT_STAGES];
+static const char        *names[BOOT_STAGES] = BOOT_STAGE_NAMES;
+
+/* Private prototypes --------------------------------------------------------*/
+static void  putTimes (void);
+
+
+/* Code  ---------------------------------------------------------------------*/
+
+/* to be called first in main(); starts the time base
+ */
+void  initBoot (const BootStep *pSteps, uint32_t n)
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT       = 0;
+    DWT->CTRL        |= DWT_CTRL_CYCCNTENA_Msk;
+
+    memset ((void *) stageUs, 0xFF, sizeof (stageUs));
+    steps  = pSteps;
+    nSteps = n;
+    step   = 0;
+    done   = 0;
+}
+
+
+
+/* run the current boot step; return 1 once all steps are done
+ */
+uint8_t  bootTask (void)
+{
+    if (done)
+        return (1);
+
+    if (step < nSteps)
+    {
+        if (!steps[step].pFunc ())
+            return (0);
+        bootMark (steps[step].stage);
+        step++;
+    }
+    if (step < nSteps)
+        return (0);
+
+    putTimes ();
+    done = 1;
+    return (1);
+}
+
+
+
+/* <stage> is reached; only the first mark counts; any context
+ */
+void  bootMark (uint32_t stage)
+{
+    if (stageUs[stage] == STAGE_OPEN)
+        stageUs[stage] = bootTimeUs ();
+}
+
+
+
+uint8_t  bootReady (uint32_t stage)
+{
+    return (stageUs[stage] != STAGE_OPEN);
+}
+
+
+
+/* time since the start of main(); valid for the first 25s (168MHz)
+ */
+uint32_t  bootTimeUs (void)
+{
+    return (DWT->CYCCNT / (SystemCoreClock / 1000000));
+}
+
+
+
+/* the stage times, to the serial output (if active)
+ */
+static void  putTimes (void)
+{
+    char      lbuf[40];
+    uint32_t  i;
+    int       sl;
+
+    for (i=0; i<BOOT_STAGES; i++)
+    {
+        sl = sprintf (lbuf, "B%lu %s %lu\n", (unsigned long) i, names[i], (unsigned long) stageUs[i]);
+        if (serialActive)
+            (void) serialWrite (lbuf, sl);
+    }
+}
@@ -0,0 +1,46 @@
+#ifndef BOOT_H
+  #define BOOT_H
+
+/* staged start-up;
+ * main() only brings up what the sampling needs (sensor, SysTick, rate
+ * streams) and starts the scheduler; the rest (SD card, LCD, reports) runs
+ * as boot steps from a low priority task, one step per run, while the
+ * samples are buffered in RAM; the time of every stage since the reset is
+ * recorded, and sent as 'B' records once the boot is complete:
+ *   B<stage> <name> <us since reset>
+ */
+
+/* ---------------- definitions ----------------
+ */
+#define BOOT_STAGE_SAMPLING    0        // sensor and SysTick sampling running
+#define BOOT_STAGE_SAMPLE      1        // first sample taken
+#define BOOT_STAGE_STORAGE     2        // data file open, RAM buffer written
+#define BOOT_STAGE_DISPLAY     3        // LCD and renderer up
+#define BOOT_STAGE_REPORTS     4        // serial header, crash / reset reports
+#define BOOT_STAGES            5
+
+#define BOOT_STAGE_NAMES       { "sampling", "sample", "storage", "display", "reports" }
+
+#define BOOT_LCD_SETTLE_US     100000   // LCD power-up time, since the reset
+#define BOOT_BUF_SIZE          2048     // samples held until the file is open (13.6s)
+
+
+/* a boot step; returns 1 when done, 0 to be called again (waiting, without
+ * blocking); completes <stage>
+ */
+typedef struct
+{
+    uint8_t     stage;
+    uint8_t    (*pFunc) (void);
+} BootStep;
+
+
+/* ------------ function prototypes ------------
+ */
+void      initBoot      (const BootStep *pSteps, uint32_t n);
+uint8_t   bootTask      (void);
+void      bootMark      (uint32_t stage);
+uint8_t   bootReady     (uint32_t stage);
+uint32_t  bootTimeUs    (void);
+
+#endif  //  BOOT_H
@@ -0,0 +1,368 @@
+/* ---------------------------------------------------------------------------
+ * run-time configuration;
+ * the parser is a character state machine, so the file can be fed in
+ * chunks as read; key and value are collected into fixed buffers in the
+ * parser state, and applied at the end of their line:
+ *   KEY_WS -> KEY -> EQ_WS -> '=' -> VAL_WS -> VAL -> (blank) -> '\n'
+ * a '#' starts a comment, up to the line end; a malformed line is
+ * skipped to its end, and counted as error
+ * ---------------------------------------------------------------------------
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdio.h>
+#include <string.h>
+#include "config.h"
+
+/* Private define ------------------------------------------------------------*/
+#define ST_KEY_WS              0        // line start, blanks
+#define ST_KEY                 1
+#define ST_EQ_WS               2        // blanks after the key
+#define ST_VAL_WS              3        // blanks after '='
+#define ST_VAL                 4
+#define ST_END                 5        // value done, blanks up to the line end
+#define ST_COMMENT             6        // after a value or on an empty line
+#define ST_ERROR               7        // malformed, counted at the line end
+
+#define FMT_TONES              15       // configFormat line of tone0
+
+#define IS_BLANK(c)            (((c) == ' ') || ((c) == '\t') || ((c) == '\r'))
+#define IS_KEY(c)              ((((c) >= 'a') && ((c) <= 'z')) || (((c) >= 'A') && ((c) <= 'Z')) || \
+                                (((c) >= '0') && ((c) <= '9')) || ((c) == '_'))
+
+/* Private prototypes --------------------------------------------------------*/
+static uint8_t   apply     (Config *pCfg, const char *pKey, const char *pVal);
+static uint8_t   number    (const char *pVal, uint32_t min, uint32_t max, uint32_t *pNum);
+static uint8_t   choice    (const char *pVal, const char *pA, const char *pB, uint8_t *pSel);
+static uint8_t   tone      (const char *pVal, CfgTone *pTone);
+static void      endLine   (CfgParser *pp);
+
+
+/* Code  ---------------------------------------------------------------------*/
+
+void  configDefaults (Config *pCfg)
+{
+    static const CfgTone  defTones[] = { CFG_DEF_TONE0, CFG_DEF_TONE1 };
+
+    memset (pCfg, 0, sizeof (Config));
+    memcpy (pCfg->tone, defTones, sizeof (defTones));
+    strcpy (pCfg->name, CFG_DEF_NAME);
+    pCfg->sensor       = CFG_DEF_SENSOR;
+    pCfg->decimation   = CFG_DEF_DECIMATION;
+    pCfg->lowRateHz    = CFG_DEF_LOWRATE_HZ;
+    pCfg->format       = CFG_DEF_FORMAT;
+    pCfg->fsync        = CFG_DEF_FSYNC;
+    pCfg->serial       = CFG_DEF_SERIAL;
+    pCfg->serialFormat = CFG_DEF_SERIAL_FORMAT;
+    pCfg->display      = CFG_DEF_DISPLAY;
+    pCfg->hud          = CFG_DEF_HUD;
+    pCfg->zoom         = CFG_DEF_ZOOM;
+    pCfg->calItems     = CFG_DEF_CAL_ITEMS;
+    pCfg->selftest     = CFG_DEF_SELFTEST;
+    pCfg->wind         = CFG_DEF_WIND;
+}
+
+
+
+/* start parsing into <pCfg>, which holds the defaults (or an earlier
+ * configuration) to be overridden
+ */
+void  configBegin (CfgParser *pp, Config *pCfg)
+{
+    memset (pp, 0, sizeof (CfgParser));
+    pp->pCfg  = pCfg;
+    pp->state = ST_KEY_WS;
+}
+
+
+
+/* parse the next <n> characters of the file
+ */
+void  configFeed (CfgParser *pp, const char *pData, uint32_t n)
+{
+    char  c;
+
+    while (n--)
+    {
+        c = *pData++;
+        if (c == '\n')
+        {
+            endLine (pp);
+            continue;
+        }
+        if ((c == '#') && (pp->state != ST_ERROR))
+        {
+            if ((pp->state == ST_KEY) || (pp->state == ST_EQ_WS) || (pp->state == ST_VAL_WS))
+                pp->state = ST_ERROR;   // key without value
+            else
+                pp->state = ST_COMMENT;
+            continue;
+        }
+
+        switch (pp->state)
+        {
+            case ST_KEY_WS:
+                if (IS_BLANK(c))
+                    break;
+                pp->state = ST_KEY;
+                // fall through
+            case ST_KEY:
+                if (IS_KEY(c))
+                {
+                    if (pp->kLen < CFG_KEY_SIZE - 1)
+                        pp->key[pp->kLen++] = c;
+                    else
+                        pp->overflow = 1;
+                }
+                else if (IS_BLANK(c))
+                    pp->state = ST_EQ_WS;
+                else if ((c == '=') && (pp->kLen > 0))
+                    pp->state = ST_VAL_WS;
+                else
+                    pp->state = ST_ERROR;
+                break;
+            case ST_EQ_WS:
+                if (c == '=')
+                    pp->state = ST_VAL_WS;
+                else if (!IS_BLANK(c))
+                    pp->state = ST_ERROR;
+                break;
+            case ST_VAL_WS:
+                if (IS_BLANK(c))
+                    break;
+                pp->state = ST_VAL;
+                // fall through
+            case ST_VAL:
+                if (IS_BLANK(c))
+                    pp->state = ST_END;
+                else if (pp->vLen < CFG_VAL_SIZE - 1)
+                    pp->val[pp->vLen++] = c;
+                else
+                    pp->overflow = 1;
+                break;
+            case ST_END:
+                if (!IS_BLANK(c))
+                    pp->state = ST_ERROR;   // blank inside the value
+                break;
+            default:                    // ST_COMMENT, ST_ERROR
+                break;
+        }
+    }
+}
+
+
+
+/* end of the file; a last line without line feed is applied as well;
+ * returns the number of errors
+ */
+uint32_t  configEnd (CfgParser *pp)
+{
+    endLine (pp);
+    pp->pCfg->loaded = 1;
+    return (pp->pCfg->errors);
+}
+
+
+
+/* format line <line> of the configuration, in the file syntax, as a
+ * comment: "# key = value\n"; returns its length, or 0 past the last line
+ */
+int  configFormat (const Config *pCfg, uint32_t line, char *pBuf)
+{
+    static const char  *fmtNames[]  = { "hex", "dec" };
+    static const char  *dispNames[] = { "sweep", "scroll" };
+    const CfgTone      *pt;
+
+    if ((line >= FMT_TONES) && (line < FMT_TONES + CFG_TONES))
+    {
+        pt = &pCfg->tone[line - FMT_TONES];
+        if (pt->freq == 0)
+            return (sprintf (pBuf, "# tone%lu = 0\n", (unsigned long) (line - FMT_TONES)));
+        return (sprintf (pBuf, "# tone%lu = %u,%u,%lu\n", (unsigned long) (line - FMT_TONES),
+                         pt->freq, pt->bw, (unsigned long) pt->alarm));
+    }
+
+    switch (line)
+    {
+        case 0:
+            return (sprintf (pBuf, "# config = %s, %u errors\n",
+                             pCfg->loaded ? CFG_FILENAME : "defaults", pCfg->errors));
+        case 1:
+            return (sprintf (pBuf, "# name = %s\n", pCfg->name));
+        case 2:
+            return (sprintf (pBuf, "# sensor = %s\n", pCfg->sensor ? "filtered" : "fast"));
+        case 3:
+            return (sprintf (pBuf, "# decimate = %u\n", pCfg->decimation));
+        case 4:
+            return (sprintf (pBuf, "# lowrate = %u\n", pCfg->lowRateHz));
+        case 5:
+            return (sprintf (pBuf, "# format = %s\n", fmtNames[pCfg->format]));
+        case 6:
+            return (sprintf (pBuf, "# fsync = %u\n", pCfg->fsync));
+        case 7:
+            return (sprintf (pBuf, "# serial = %u\n", pCfg->serial));
+        case 8:
+            return (sprintf (pBuf, "# serial_format = %s\n", fmtNames[pCfg->serialFormat]));
+        case 9:
+            return (sprintf (pBuf, "# display = %s\n", dispNames[pCfg->display]));
+        case 10:
+            return (sprintf (pBuf, "# hud = %u\n", pCfg->hud));
+        case 11:
+            return (sprintf (pBuf, "# cal_items = %u\n", pCfg->calItems));
+        case 12:
+            return (sprintf (pBuf, "# selftest = %u\n", pCfg->selftest));
+        case 13:
+            return (sprintf (pBuf, "# zoom = %u\n", pCfg->zoom));
+        case 14:
+            return (sprintf (pBuf, "# wind = %u\n", pCfg->wind));
+        default:
+            return (0);
+    }
+}
+
+
+
+/* a line is complete; apply a key / value pair, or count the error
+ */
+static void  endLine (CfgParser *pp)
+{
+    uint8_t  ok = 1;
+
+    if (pp->kLen == 0)
+        ok = (pp->state != ST_ERROR);   // blank or comment line
+    else if ((pp->state == ST_VAL) || (pp->state == ST_END) || ((pp->state == ST_COMMENT) && pp->vLen))
+    {
+        pp->key[pp->kLen] = '\0';
+        pp->val[pp->vLen] = '\0';
+        ok = !pp->overflow && apply (pp->pCfg, pp->key, pp->val);
+    }
+    else
+        ok = 0;                         // key without value, or malformed
+
+    if (!ok)
+        pp->pCfg->errors++;
+    pp->state    = ST_KEY_WS;
+    pp->kLen     = pp->vLen = 0;
+    pp->overflow = 0;
+}
+
+
+
+/* set one key; returns 0 for an unknown key or a bad value, which leave
+ * the configuration unchanged
+ */
+static uint8_t  apply (Config *pCfg, const char *pKey, const char *pVal)
+{
+    CfgTone   t;
+    uint32_t  n;
+    uint8_t   sel;
+
+    if (!strcmp (pKey, "name"))
+    {
+        if ((strlen (pVal) >= CFG_NAME_SIZE) || strpbrk (pVal, ".\\/:*?\"<>|"))
+            return (0);
+        strcpy (pCfg->name, pVal);
+    }
+    else if (!strcmp (pKey, "sensor") && choice (pVal, "fast", "filtered", &sel))
+        pCfg->sensor = sel;
+    else if (!strcmp (pKey, "decimate") && number (pVal, 1, 3, &n) && (n != 2))
+        pCfg->decimation = (uint8_t) n;
+    else if (!strcmp (pKey, "lowrate") && number (pVal, 1, 10, &n))
+        pCfg->lowRateHz = (uint8_t) n;
+    else if (!strcmp (pKey, "format") && choice (pVal, "hex", "dec", &sel))
+        pCfg->format = sel;
+    else if (!strcmp (pKey, "fsync") && number (pVal, 1, 4096, &n))
+        pCfg->fsync = (uint16_t) n;
+    else if (!strcmp (pKey, "serial") && number (pVal, 0, 1, &n))
+        pCfg->serial = (uint8_t) n;
+    else if (!strcmp (pKey, "serial_format") && choice (pVal, "hex", "dec", &sel))
+        pCfg->serialFormat = sel;
+    else if (!strcmp (pKey, "display") && choice (pVal, "sweep", "scroll", &sel))
+        pCfg->display = sel;
+    else if (!strcmp (pKey, "hud") && number (pVal, 0, 1, &n))
+        pCfg->hud = (uint8_t) n;
+    else if (!strcmp (pKey, "zoom") && number (pVal, 0, CFG_ZOOM_MAX, &n))
+        pCfg->zoom = (uint8_t) n;
+    else if (!strcmp (pKey, "cal_items") && number (pVal, 1, 1024, &n))
+        pCfg->calItems = (uint16_t) n;
+    else if (!strcmp (pKey, "selftest") && number (pVal, 0, 1, &n))
+        pCfg->selftest = (uint8_t) n;
+    else if (!strcmp (pKey, "wind") && number (pVal, 0, 1, &n))
+        pCfg->wind = (uint8_t) n;
+    else if (!strncmp (pKey, "tone", 4) && (pKey[4] >= '0') && (pKey[4] < '0' + CFG_TONES)
+             && (pKey[5] == '\0') && tone (pVal, &t))
+        pCfg->tone[pKey[4] - '0'] = t;
+    else
+        return (0);
+    return (1);
+}
+
+
+
+/* a decimal number in [min, max]
+ */
+static uint8_t  number (const char *pVal, uint32_t min, uint32_t max, uint32_t *pNum)
+{
+    uint32_t  n = 0;
+
+    if (*pVal == '\0')
+        return (0);
+    for ( ; *pVal; pVal++)
+    {
+        if ((*pVal < '0') || (*pVal > '9') || (n > max))
+            return (0);
+        n = n * 10 + (*pVal - '0');
+    }
+    if ((n < min) || (n > max))
+        return (0);
+    *pNum = n;
+    return (1);
+}
+
+
+
+/* a tone line "<freq>,<bw>,<alarm>" (0.01Hz, 0.001Hz, 0.01 LSB), or "0"
+ * for off; the centre frequency below Nyquist, the bandwidth non-zero and
+ * below the frequency, as toneSetLine requires
+ */
+static uint8_t  tone (const char *pVal, CfgTone *pTone)
+{
+    char      buf[CFG_VAL_SIZE];
+    char     *pBw, *pAlarm;
+    uint32_t  f, bw, alarm;
+
+    if (!strcmp (pVal, "0"))
+    {
+        memset (pTone, 0, sizeof (CfgTone));
+        return (1);
+    }
+    strcpy (buf, pVal);
+    pBw    = strchr (buf, ',');
+    pAlarm = (pBw != NULL) ? strchr (pBw + 1, ',') : NULL;
+    if (pAlarm == NULL)
+        return (0);
+    *pBw++    = '\0';
+    *pAlarm++ = '\0';
+    if (!number (buf, 1, CFG_TONE_FREQ_MAX, &f) || !number (pBw, 1, 65535, &bw)
+        || !number (pAlarm, 0, CFG_TONE_ALARM_MAX, &alarm) || (bw >= f * 10))
+        return (0);
+    pTone->freq  = (uint16_t) f;
+    pTone->bw    = (uint16_t) bw;
+    pTone->alarm = alarm;
+    return (1);
+}
+
+
+
+/* one of two words; <pSel> is 0 for <pA>, 1 for <pB>
+ */
+static uint8_t  choice (const char *pVal, const char *pA, const char *pB, uint8_t *pSel)
+{
+    if (!strcmp (pVal, pA))
+        *pSel = 0;
+    else if (!strcmp (pVal, pB))
+        *pSel = 1;
+    else
+        return (0);
+    return (1);
+}
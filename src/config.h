@@ -0,0 +1,110 @@
+#ifndef CONFIG_H
+  #define CONFIG_H
+
+/* run-time configuration;
+ * read at boot from the "infra.cfg" file on the SD card, as lines of
+ *   key = value          # comment
+ * by a streaming parser without allocations (the file is fed in chunks
+ * of any size); an unknown key, or a value out of range, keeps the
+ * default for that key and is counted as error; no file keeps all the
+ * defaults; the parser only needs the C library, and builds on the host
+ * (tools/cfgcheck.c)
+ */
+
+#include <stdint.h>
+
+/* ---------------- definitions ----------------
+ */
+#define CFG_FILENAME           "infra.cfg"
+#define CFG_KEY_SIZE           16       // longest key + 1
+#define CFG_VAL_SIZE           24       // longest value + 1 (a tone line)
+#define CFG_NAME_SIZE          7        // file name base, max. 6 characters (8.3 names)
+#define CFG_CHUNK_SIZE         64       // file read size, parser input
+
+#define CFG_SENSOR_FAST        0        // no filter in the sensor
+#define CFG_SENSOR_FILTERED    1        // sensor IIR filter, coefficient 2
+
+#define CFG_FORMAT_HEX         0        // number format, data file and serial stream
+#define CFG_FORMAT_DEC         1
+
+#define CFG_TONES              4        // tone monitor lines, TONE_MAX_LINES
+#define CFG_TONE_FREQ_MAX      7499     // 0.01Hz, below Nyquist at 150Hz
+#define CFG_TONE_ALARM_MAX     99999999 // 0.01 LSB
+
+// defaults; as the former build-time settings
+#define CFG_DEF_NAME           "APsmpl"
+#define CFG_DEF_SENSOR         CFG_SENSOR_FAST
+#define CFG_DEF_DECIMATION     1
+#define CFG_DEF_LOWRATE_HZ     2
+#define CFG_DEF_FORMAT         CFG_FORMAT_HEX
+#define CFG_DEF_FSYNC          64
+#define CFG_DEF_SERIAL         0
+#define CFG_DEF_SERIAL_FORMAT  CFG_FORMAT_DEC
+#define CFG_DEF_DISPLAY        0        // RENDER_MODE_SWEEP
+#define CFG_DEF_HUD            1
+#define CFG_DEF_WIND           0
+#define CFG_DEF_TONE0          { 100, 50, 0 }   // 1.00Hz +- 0.025Hz, typical blade-pass region
+#define CFG_DEF_TONE1          { 200, 50, 0 }   // and its second harmonic
+#define CFG_DEF_ZOOM           2        // RENDER_ZOOM_DEFAULT
+#define CFG_ZOOM_MAX           13       // RENDER_LEVELS - 1
+#define CFG_DEF_CAL_ITEMS      32
+#define CFG_DEF_SELFTEST       0
+
+
+/* one tone monitor line, as taken by toneSetLine
+ */
+typedef struct
+{
+    uint16_t  freq;                     // centre frequency, 0.01Hz; 0 = off
+    uint16_t  bw;                       // bandwidth, 0.001Hz
+    uint32_t  alarm;                    // amplitude threshold, 0.01 LSB; 0 = none
+} CfgTone;
+
+
+/* the effective configuration
+ */
+typedef struct
+{
+    char      name[CFG_NAME_SIZE];      // name      data file name base
+    uint8_t   sensor;                   // sensor    fast | filtered
+    uint8_t   decimation;               // decimate  1 (150Hz) | 3 (50Hz), data file
+    uint8_t   lowRateHz;                // lowrate   1 .. 10, Stop mode sample rate
+    uint8_t   format;                   // format    hex | dec, data file
+    uint16_t  fsync;                    // fsync     1 .. 4096, data items per sync
+    uint8_t   serial;                   // serial    0 | 1, output at start
+    uint8_t   serialFormat;             // serial_format  hex | dec
+    uint8_t   display;                  // display   sweep | scroll
+    uint8_t   hud;                      // hud       0 | 1
+    uint8_t   zoom;                     // zoom      0 .. 13, 2^zoom samples per column
+    uint16_t  calItems;                 // cal_items 1 .. 1024, calibration samples
+    uint8_t   selftest;                 // selftest  0 | 1, benchmarks at boot
+    uint8_t   wind;                     // wind      0 | 1, wind noise stage output
+    CfgTone   tone[CFG_TONES];          // tone<N>   <freq>,<bw>,<alarm> | 0
+    uint16_t  errors;                   // lines rejected
+    uint8_t   loaded;                   // read from the file
+} Config;
+
+
+/* parser state; owned by the caller
+ */
+typedef struct
+{
+    Config   *pCfg;
+    uint8_t   state;
+    uint8_t   kLen;
+    uint8_t   vLen;
+    uint8_t   overflow;                 // key or value too long
+    char      key[CFG_KEY_SIZE];
+    char      val[CFG_VAL_SIZE];
+} CfgParser;
+
+
+/* ------------ function prototypes ------------
+ */
+void      configDefaults (Config *pCfg);
+void      configBegin    (CfgParser *pp, Config *pCfg);
+void      configFeed     (CfgParser *pp, const char *pData, uint32_t n);
+uint32_t  configEnd      (CfgParser *pp);
+int       configFormat   (const Config *pCfg, uint32_t line, char *pBuf);
+
+#endif  //  CONFIG_H
@@ -0,0 +1,247 @@
+/* ---------------------------------------------------------------------------
+ * crash dump capture;
+ * the four fault handlers enter crashHandler with the exception frame
+ * (MSP or PSP, as selected by EXC_RETURN); the watchdog is started first
+ * with a short timeout, so a second fault while the dump is written
+ * (lockup) resets the MCU as well; the frame and the stack snapshot are
+ * only read if they lie in SRAM / CCM, a stack overflow leaves them out;
+ * the dump survives the reset in the backup SRAM, and is reported once,
+ * as text lines (also the serial record format):
+ *   C<count> <fault> pc <pc> lr <lr> psr <xpsr>
+ *   C r0 <r0> r1 <r1> r2 <r2> r3 <r3> r12 <r12>
+ *   C cfsr <cfsr> hfsr <hfsr> mmfar <mmfar> bfar <bfar>
+ *   C sp <sp> exc <EXC_RETURN> cyc <cycles> rst <RCC_CSR>
+ *   C s<offset> <word> <word> <word> <word>        (stack snapshot)
+ *   X<count> <Hz>  /  x<record>                    (trace, see trace.c)
+ * ---------------------------------------------------------------------------
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdio.h>
+#include <string.h>
+#include "stm32f4xx.h"
+#include "main.h"
+#include "trace.h"
+#include "crash.h"
+
+/* Private define ------------------------------------------------------------*/
+#define DUMP                   ((CrashDump *) (BKPSRAM_BASE + CRASH_BKP_OFFSET))
+#define HEAD_LINES             4
+#define STACK_LINES            (CRASH_STACK_WORDS / 4)
+
+#define CCM_END                (CCMDATARAM_BASE + 0x10000)
+#define SRAM_END               (SRAM1_BASE + 0x20000)
+
+/* Private variables ---------------------------------------------------------*/
+static uint32_t  resetFlags = 0;        // RCC_CSR at boot
+
+/* Private prototypes --------------------------------------------------------*/
+static uint32_t  ramWords   (uint32_t addr);
+static void      bkpAccess  (void);
+
+
+/* Code  ---------------------------------------------------------------------*/
+
+/* enable the fault handlers, open the backup SRAM, and keep the reset
+ * flags; to be called early, before any other initialisation
+ */
+void  initCrash (void)
+{
+    resetFlags = RCC->CSR;
+    RCC->CSR  |= RCC_CSR_RMVF;
+
+    bkpAccess ();
+    SCB->SHCSR |= SCB_SHCSR_USGFAULTENA_Msk | SCB_SHCSR_BUSFAULTENA_Msk | SCB_SHCSR_MEMFAULTENA_Msk;
+}
+
+
+
+/* fault handler body; writes the dump and waits for the watchdog reset
+ */
+void  crashHandler (uint32_t *pFrame, uint32_t excReturn)
+{
+    CrashDump  *pd = DUMP;
+    uint32_t   *ps;
+    uint32_t    n;
+
+    __disable_irq ();
+    IWDG->KR  = 0xCCCC;                 // start, if not running yet
+    IWDG->KR  = 0x5555;
+    IWDG->PR  = IWDG_Prescaler_4;
+    IWDG->RLR = CRASH_WDG_RELOAD;
+    IWDG->KR  = 0xAAAA;
+
+    bkpAccess ();
+    if ((pd->magic != CRASH_MAGIC) || (pd->count > 0xFFFF))
+        pd->count = 0;
+    pd->magic     = 0;                  // incomplete until the end
+    pd->count++;
+    pd->exception = __get_IPSR ();
+    pd->excReturn = excReturn;
+    pd->sp        = (uint32_t) pFrame;
+    pd->cfsr      = SCB->CFSR;
+    pd->hfsr      = SCB->HFSR;
+    pd->mmfar     = SCB->MMFAR;
+    pd->bfar      = SCB->BFAR;
+    pd->cycles    = DWT->CYCCNT;
+    pd->hz        = SystemCoreClock;
+
+    if (ramWords ((uint32_t) pFrame) >= 8)
+    {
+        pd->r0   = pFrame[0];
+        pd->r1   = pFrame[1];
+        pd->r2   = pFrame[2];
+        pd->r3   = pFrame[3];
+        pd->r12  = pFrame[4];
+        pd->lr   = pFrame[5];
+        pd->pc   = pFrame[6];
+        pd->xpsr = pFrame[7];
+
+        ps = pFrame + ((excReturn & 0x10) ? 8 : 26);     // basic / FPU frame
+        n  = ramWords ((uint32_t) ps);
+        if (n > CRASH_STACK_WORDS)
+            n = CRASH_STACK_WORDS;
+        pd->stackWords = n;
+        memcpy (pd->stack, ps, n * sizeof (uint32_t));
+    }
+    else
+    {
+        memset (&pd->r0, 0xFF, 8 * sizeof (uint32_t));
+        pd->stackWords = 0;
+    }
+
+    pd->traceEvents = traceCopy (pd->trace, CRASH_TRACE_EVENTS);
+    pd->state       = CRASH_STATE_NEW;
+    pd->magic       = CRASH_MAGIC;
+    __DSB ();
+
+    while (1);                          // watchdog reset
+}
+
+
+
+/* the dump of the last fault, if not reported yet; NULL otherwise
+ */
+const CrashDump  *crashGet (void)
+{
+    if ((DUMP->magic != CRASH_MAGIC) || (DUMP->state != CRASH_STATE_NEW))
+        return (NULL);
+    return (DUMP);
+}
+
+
+
+const char  *crashName (uint32_t exception)
+{
+    static const char  *names[] = { "HardFault", "MemManage", "BusFault", "UsageFault" };
+
+    if ((exception < 3) || (exception > 6))
+        return ("fault");
+    return (names[exception - 3]);
+}
+
+
+
+/* RCC_CSR at boot: the reset cause flags
+ */
+uint32_t  crashResetFlags (void)
+{
+    return (resetFlags);
+}
+
+
+
+/* format report line <line> of the last dump (pending or reported) into
+ * <pBuf>, at least CRASH_LINE_SIZE bytes; return its length, or 0 past
+ * the last line
+ */
+int  crashLine (uint32_t line, char *pBuf)
+{
+    const CrashDump    *pd;
+    const TraceRecord  *pr;
+    uint32_t            i;
+
+    pd = DUMP;
+    if (pd->magic != CRASH_MAGIC)
+        return (0);
+
+    switch (line)
+    {
+        case 0:
+            return (sprintf (pBuf, "C%lu %s pc %08lX lr %08lX psr %08lX\n", (unsigned long) pd->count,
+                             crashName (pd->exception), (unsigned long) pd->pc, (unsigned long) pd->lr,
+                             (unsigned long) pd->xpsr));
+        case 1:
+            return (sprintf (pBuf, "C r0 %08lX r1 %08lX r2 %08lX r3 %08lX r12 %08lX\n", (unsigned long) pd->r0,
+                             (unsigned long) pd->r1, (unsigned long) pd->r2, (unsigned long) pd->r3,
+                             (unsigned long) pd->r12));
+        case 2:
+            return (sprintf (pBuf, "C cfsr %08lX hfsr %08lX mmfar %08lX bfar %08lX\n", (unsigned long) pd->cfsr,
+                             (unsigned long) pd->hfsr, (unsigned long) pd->mmfar, (unsigned long) pd->bfar));
+        case 3:
+            return (sprintf (pBuf, "C sp %08lX exc %08lX cyc %lu rst %08lX\n", (unsigned long) pd->sp,
+                             (unsigned long) pd->excReturn, (unsigned long) pd->cycles,
+                             (unsigned long) resetFlags));
+        default:
+            break;
+    }
+
+    line -= HEAD_LINES;
+    if (line < STACK_LINES)
+    {
+        i = line * 4;
+        if (i >= pd->stackWords)
+            return (sprintf (pBuf, "C s%02lX -\n", (unsigned long) i * 4));
+        return (sprintf (pBuf, "C s%02lX %08lX %08lX %08lX %08lX\n", (unsigned long) i * 4,
+                         (unsigned long) pd->stack[i], (unsigned long) pd->stack[i + 1],
+                         (unsigned long) pd->stack[i + 2], (unsigned long) pd->stack[i + 3]));
+    }
+
+    line -= STACK_LINES;
+    if (line == 0)
+        return (sprintf (pBuf, "X%lu %lu\n", (unsigned long) pd->traceEvents, (unsigned long) pd->hz));
+    if (line <= pd->traceEvents)
+    {
+        pr = &pd->trace[line - 1];
+        return (sprintf (pBuf, "x%08lX%02X%02X%04X\n", (unsigned long) pr->time, pr->event, pr->ctx, pr->arg));
+    }
+    return (0);
+}
+
+
+
+/* the dump is reported; it stays in the backup SRAM for crashLine, but
+ * crashGet does not return it again
+ */
+void  crashReported (void)
+{
+    DUMP->state = CRASH_STATE_REPORTED;
+}
+
+
+
+/* number of words from <addr> to the end of its RAM region; 0 if <addr>
+ * is not in SRAM or CCM
+ */
+static uint32_t  ramWords (uint32_t addr)
+{
+    if (addr & 3)
+        return (0);
+    if ((addr >= SRAM1_BASE) && (addr < SRAM_END))
+        return ((SRAM_END - addr) / 4);
+    if ((addr >= CCMDATARAM_BASE) && (addr < CCM_END))
+        return ((CCM_END - addr) / 4);
+    return (0);
+}
+
+
+
+/* backup domain write access, and the backup SRAM clock
+ */
+static void  bkpAccess (void)
+{
+    RCC->APB1ENR |= RCC_APB1ENR_PWREN;
+    PWR->CR      |= PWR_CR_DBP;
+    RCC->AHB1ENR |= RCC_AHB1ENR_BKPSRAMEN;
+    __DSB ();
+}
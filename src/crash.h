@@ -0,0 +1,64 @@
+#ifndef CRASH_H
+  #define CRASH_H
+
+/* crash dump capture;
+ * the fault handlers save the stacked registers, the fault status
+ * registers, a stack snapshot and the last trace events into the backup
+ * SRAM, and reset the MCU via the independent watchdog; on the next boot,
+ * the dump is reported to the LCD, the serial output and the SD card, and
+ * recording resumes; it counts as reported once it is on the SD card
+ */
+
+#include "trace.h"
+
+/* ---------------- definitions ----------------
+ */
+#define CRASH_BKP_OFFSET       0        // dump area in the 4kB backup SRAM
+#define CRASH_BKP_SIZE         2048
+#define CRASH_MAGIC            0xDEADC0DE
+#define CRASH_STACK_WORDS      32       // stack snapshot above the exception frame
+#define CRASH_TRACE_EVENTS     64       // last trace records
+#define CRASH_WDG_RELOAD       40       // watchdog reset after ~5ms (LSI / 4)
+
+#define CRASH_FILENAME         "crash.log"
+#define CRASH_LINE_SIZE        80       // crashLine buffer
+
+/* the dump; <state> tells a fresh dump from one already reported
+ */
+typedef struct
+{
+    uint32_t     magic;
+    uint32_t     state;                 // CRASH_STATE_xxx
+    uint32_t     count;                 // faults since the backup domain reset
+    uint32_t     exception;             // IPSR; 3 HardFault .. 6 UsageFault
+    uint32_t     excReturn;             // LR at fault entry
+    uint32_t     sp;                    // exception frame address
+    uint32_t     r0, r1, r2, r3;        // exception frame
+    uint32_t     r12, lr, pc, xpsr;
+    uint32_t     cfsr;                  // fault status
+    uint32_t     hfsr;
+    uint32_t     mmfar;
+    uint32_t     bfar;
+    uint32_t     cycles;                // DWT->CYCCNT at the fault
+    uint32_t     hz;                    // core clock at the fault
+    uint32_t     stackWords;            // valid snapshot words
+    uint32_t     stack[CRASH_STACK_WORDS];
+    uint32_t     traceEvents;           // valid trace records, oldest first
+    TraceRecord  trace[CRASH_TRACE_EVENTS];
+} CrashDump;
+
+#define CRASH_STATE_NEW        1
+#define CRASH_STATE_REPORTED   2
+
+
+/* ------------ function prototypes ------------
+ */
+void              initCrash        (void);
+void              crashHandler     (uint32_t *pFrame, uint32_t excReturn);
+const CrashDump  *crashGet         (void);
+const char       *crashName        (uint32_t exception);
+uint32_t          crashResetFlags  (void);
+int               crashLine        (uint32_t line, char *pBuf);
+void              crashReported    (void);
+
+#endif  //  CRASH_H
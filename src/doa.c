@@ -0,0 +1,296 @@
+/* ---------------------------------------------------------------------------
+ * direction of arrival estimation for a multi-sensor array;
+ * per analysis window, each channel is mean-removed, normalised (block
+ * floating point), Hann-windowed, zero padded and transformed with a
+ * fixed-point radix-2 FFT; the cross spectrum of each channel pair is
+ * transformed back to the cross-correlation, and its peak (with parabolic
+ * interpolation) gives the pair delay; the correlation is divided by the
+ * autocorrelation of the window first, which would pull the peak towards
+ * lag 0 (the delays came out ~4% short);
+ * a least squares fit of the pair delays to a plane wave gives the
+ * slowness vector, i.e. back-azimuth and apparent velocity; the delay
+ * closure over sensor triangles (PMCC-like) rates the consistency
+ * ---------------------------------------------------------------------------
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include <math.h>
+#include <string.h>
+#include "stm32f4xx.h"
+#include "doa.h"
+#include "fft.h"
+
+/* Private define ------------------------------------------------------------*/
+#define BFP_BITS               26       // normalised input magnitude, bits
+#define XSPEC_SHIFT            26       // cross spectrum product scaling
+#define Q15_ONE                32768.0f
+#define DOA_PI                 3.14159265f
+#define RAD2DEG                57.29578f
+
+/* Private typedef -----------------------------------------------------------*/
+typedef struct
+{
+    float  x;
+    float  y;
+} DoaPos;
+
+/* Private variables ---------------------------------------------------------*/
+static uint16_t      winBuf[DOA_CHANNELS][DOA_WIN];
+static int32_t       spec[DOA_CHANNELS][2*DOA_FFT];   // interleaved re, im
+static int32_t       xcorr[2*DOA_FFT];
+static int16_t       hann[DOA_WIN];                   // Q15 window
+static float         wGain[DOA_MAX_LAG+2];            // 1 / window autocorrelation, per lag
+static float         energy[DOA_CHANNELS];
+static float         tau[DOA_PAIRS];
+static float         rho[DOA_PAIRS];
+static uint32_t      winIndex = 0;
+static uint32_t      haveResult = 0;
+static DoaResult     result;
+
+static const DoaPos  pos[DOA_CHANNELS] = DOA_POSITIONS;
+
+/* Private prototypes --------------------------------------------------------*/
+static void      loadChannel    (uint32_t ch);
+static void      correlatePair  (uint32_t i, uint32_t j, uint32_t p);
+static uint32_t  fitPlaneWave   (void);
+static void      processWindow  (void);
+static float     lagValue       (int32_t lag);
+
+
+/* Code  ---------------------------------------------------------------------*/
+
+/* set up the FFT and window tables, and reset the window buffer
+ */
+void  initDoa (void)
+{
+    uint32_t  i, l;
+    float     r0, r;
+
+    initFft ();
+    for (i=0; i<DOA_WIN; i++)
+        hann[i] = (int16_t) ((0.5f - 0.5f * cosf (2.0f * DOA_PI * i / (DOA_WIN - 1))) * (Q15_ONE - 1.0f));
+    for (l=0, r0=1.0f; l<DOA_MAX_LAG+2; l++)
+    {
+        for (i=0, r=0.0f; i+l<DOA_WIN; i++)
+            r += (float) hann[i] * hann[i+l];
+        if (l == 0)
+            r0 = r;
+        wGain[l] = r0 / r;
+    }
+
+    winIndex   = 0;
+    haveResult = 0;
+}
+
+
+
+/* add one sample per channel (taken at the same instant);
+ * returns 1 when a window was completed and a new result is available
+ */
+uint32_t  doaInput (const uint16_t *pSamples)
+{
+    uint32_t  ch;
+
+    for (ch=0; ch<DOA_CHANNELS; ch++)
+        winBuf[ch][winIndex] = pSamples[ch];
+
+    if (++winIndex < DOA_WIN)
+        return 0;
+    winIndex = 0;
+
+    processWindow ();
+    return (haveResult);
+}
+
+
+
+/* get the last estimate;
+ * returns DOA_RET_NONE if there is none (yet)
+ */
+uint32_t  doaGetResult (DoaResult *pResult)
+{
+    if (!haveResult)
+        return (DOA_RET_NONE);
+    *pResult = result;
+    return (DOA_RET_OK);
+}
+
+
+
+/* run the complete analysis on a filled window
+ */
+static void  processWindow (void)
+{
+    uint32_t  i, j, p, t0;
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL        |= DWT_CTRL_CYCCNTENA_Msk;
+    t0 = DWT->CYCCNT;
+
+    for (i=0; i<DOA_CHANNELS; i++)
+        loadChannel (i);
+
+    for (i=0, p=0; i<DOA_CHANNELS; i++)
+        for (j=i+1; j<DOA_CHANNELS; j++, p++)
+            correlatePair (i, j, p);
+
+    haveResult    = (fitPlaneWave () == DOA_RET_OK);
+    result.cycles = DWT->CYCCNT - t0;
+}
+
+
+
+/* prepare the spectrum of one channel:
+ * mean removal, normalisation to BFP_BITS, Hann window, zero padding, FFT
+ */
+static void  loadChannel (uint32_t ch)
+{
+    int32_t   *ps;
+    int32_t    mean, d, maxd;
+    uint32_t   n, shift;
+    float      e, re, im;
+
+    for (n=0, mean=0; n<DOA_WIN; n++)
+        mean += winBuf[ch][n];
+    mean /= DOA_WIN;
+
+    for (n=0, maxd=1; n<DOA_WIN; n++)
+    {
+        d = winBuf[ch][n] - mean;
+        if (d < 0)
+            d = -d;
+        if (d > maxd)
+            maxd = d;
+    }
+    for (shift=0; (maxd << (shift+1)) < (1L << BFP_BITS); shift++)
+        ;
+
+    ps = spec[ch];
+    for (n=0; n<DOA_WIN; n++)
+    {
+        d         = (winBuf[ch][n] - mean) << shift;
+        ps[2*n]   = (int32_t) (((int64_t) d * hann[n]) >> 15);
+        ps[2*n+1] = 0;
+    }
+    memset (&ps[2*DOA_WIN], 0, 2 * (DOA_FFT - DOA_WIN) * sizeof (int32_t));
+
+    fftQ31 (ps, DOA_FFT_BITS);
+
+    for (n=0, e=0.0f; n<DOA_FFT; n++)
+    {
+        re = (float) ps[2*n];
+        im = (float) ps[2*n+1];
+        e += re * re + im * im;
+    }
+    energy[ch] = e;
+}
+
+
+
+/* cross-correlate channels <i> and <j> via the cross spectrum
+ * conj(Xi)*Xj; the peak lag is the delay of channel j versus i
+ */
+static void  correlatePair (uint32_t i, uint32_t j, uint32_t p)
+{
+    int32_t   *pa, *pb;
+    int32_t    lag, best, idx, k;
+    int64_t    ar, ai, br, bi;
+    float      ym, y0, yp, den, frac;
+
+    pa = spec[i];
+    pb = spec[j];
+    for (k=0; k<DOA_FFT; k++)
+    {
+        ar = pa[2*k];  ai = pa[2*k+1];
+        br = pb[2*k];  bi = pb[2*k+1];
+        // inverse transform via the forward FFT of the conjugate
+        xcorr[2*k]   =  (int32_t) ((ar * br + ai * bi) >> XSPEC_SHIFT);
+        xcorr[2*k+1] = -(int32_t) ((ar * bi - ai * br) >> XSPEC_SHIFT);
+    }
+    fftQ31 (xcorr, DOA_FFT_BITS);
+
+    best = 0;
+    for (lag=-DOA_MAX_LAG; lag<=DOA_MAX_LAG; lag++)
+        if (lagValue (lag) > lagValue (best))
+            best = lag;
+
+    // parabolic interpolation around the peak
+    y0   = lagValue (best);
+    ym   = lagValue (best - 1);
+    yp   = lagValue (best + 1);
+    den  = ym - 2.0f * y0 + yp;
+    frac = (den < 0.0f) ? 0.5f * (ym - yp) / den : 0.0f;
+
+    tau[p] = ((float) best + frac) / DOA_SAMPLE_HZ;
+    idx    = (best < 0) ? (DOA_FFT + best) : best;
+    den    = sqrtf (energy[i] * energy[j]);
+    rho[p] = (den > 0.0f) ? (float) xcorr[2*idx] * DOA_FFT * (float) (1L << XSPEC_SHIFT) / den : 0.0f;
+}
+
+
+
+/* the cross-correlation at <lag> (|lag| <= DOA_MAX_LAG+1), corrected
+ * for the window autocorrelation
+ */
+static float  lagValue (int32_t lag)
+{
+    if (lag < 0)
+        return ((float) xcorr[2*(DOA_FFT + lag)] * wGain[-lag]);
+    return ((float) xcorr[2*lag] * wGain[lag]);
+}
+
+
+
+/* least squares plane-wave fit of the pair delays,
+ *   tau_ij = s . (p_j - p_i)
+ * solved via the 2x2 normal equations; fills the result
+ */
+static uint32_t  fitPlaneWave (void)
+{
+    float     a11, a12, a22, b1, b2, dx, dy, det, sx, sy, s, c, closure;
+    uint32_t  i, j, k, p, n;
+
+    a11 = a12 = a22 = b1 = b2 = c = 0.0f;
+    for (i=0, p=0; i<DOA_CHANNELS; i++)
+        for (j=i+1; j<DOA_CHANNELS; j++, p++)
+        {
+            dx   = pos[j].x - pos[i].x;
+            dy   = pos[j].y - pos[i].y;
+            a11 += dx * dx;
+            a12 += dx * dy;
+            a22 += dy * dy;
+            b1  += dx * tau[p];
+            b2  += dy * tau[p];
+            c   += rho[p];
+        }
+
+    det = a11 * a22 - a12 * a12;
+    if (fabsf (det) < 1.0e-3f)
+        return (DOA_RET_NONE);      // collinear (or too few) sensors
+    sx = ( a22 * b1 - a12 * b2) / det;
+    sy = (-a12 * b1 + a11 * b2) / det;
+    s  = sqrtf (sx * sx + sy * sy);
+    if (s < 1.0e-6f)
+        return (DOA_RET_NONE);
+
+    // delay closure tau_ij + tau_jk - tau_ik over all triangles
+    // pair index of (i,j), i<j:  i*(2*CH-i-1)/2 + (j-i-1)
+    #define PAIR(a,b)  ((a)*(2*DOA_CHANNELS-(a)-1)/2 + ((b)-(a)-1))
+    for (i=0, n=0, closure=0.0f; i<DOA_CHANNELS; i++)
+        for (j=i+1; j<DOA_CHANNELS; j++)
+            for (k=j+1; k<DOA_CHANNELS; k++, n++)
+            {
+                det      = tau[PAIR(i,j)] + tau[PAIR(j,k)] - tau[PAIR(i,k)];
+                closure += det * det;
+            }
+    #undef PAIR
+
+    result.azimuth     = atan2f (-sx, -sy) * RAD2DEG;
+    if (result.azimuth < 0.0f)
+        result.azimuth += 360.0f;
+    result.velocity    = 1.0f / s;
+    result.correlation = c / DOA_PAIRS;
+    result.consistency = n ? sqrtf (closure / n) : 0.0f;
+    return (DOA_RET_OK);
+}
+
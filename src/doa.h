@@ -0,0 +1,46 @@
+#ifndef DOA_H
+  #define DOA_H
+
+/* direction of arrival estimation for a multi-sensor array;
+ * FFT based cross-correlation between channel pairs, and a
+ * least squares plane-wave fit (back-azimuth, apparent velocity);
+ * the stage takes one simultaneous sample per channel via doaInput();
+ * tools/doatest.c checks it on synthetic plane waves (host build)
+ */
+
+/* ---------------- definitions ----------------
+ */
+#define DOA_CHANNELS           3        // sensors in the array
+#define DOA_PAIRS              ((DOA_CHANNELS * (DOA_CHANNELS-1)) / 2)
+#define DOA_WIN                256      // samples per analysis window (~1.7s)
+#define DOA_FFT                (2*DOA_WIN)   // zero padded, linear correlation
+#define DOA_FFT_BITS           9
+#define DOA_MAX_LAG            48       // max. pair delay searched, samples
+#define DOA_SAMPLE_HZ          150
+
+#define DOA_RET_OK             0
+#define DOA_RET_NONE           1        // no (valid) estimate
+
+// sensor positions in metres; x = east, y = north
+#define DOA_POSITIONS          { {0.0f, 0.0f}, {50.0f, 0.0f}, {25.0f, 43.3f} }
+
+
+/* result of one analysis window
+ */
+typedef struct
+{
+    float     azimuth;        // back-azimuth, degrees from north (0..360)
+    float     velocity;       // apparent velocity, m/s
+    float     correlation;    // mean pair correlation coefficient (0..1)
+    float     consistency;    // RMS delay closure over the triangles, s
+    uint32_t  cycles;         // processing cost of the window
+} DoaResult;
+
+
+/* ------------ function prototypes ------------
+ */
+void      initDoa      (void);
+uint32_t  doaInput     (const uint16_t *pSamples);
+uint32_t  doaGetResult (DoaResult *pResult);
+
+#endif  //  DOA_H
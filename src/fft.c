@@ -0,0 +1,88 @@
+/* ---------------------------------------------------------------------------
+ * fixed-point radix-2 FFT;
+ * in-place decimation in time on interleaved complex int32 data, with
+ * Q31 twiddles and a 1/2 scaling per stage (i.e. 1/N overall), so the
+ * input must stay below 2^30 in magnitude to rule out overflows;
+ * the inverse transform is the forward one applied to the conjugate
+ * ---------------------------------------------------------------------------
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include <math.h>
+#include "stm32f4xx.h"
+#include "fft.h"
+
+/* Private define ------------------------------------------------------------*/
+#define Q31_ONE                2147483648.0f
+#define FFT_PI                 3.14159265f
+
+/* Private variables ---------------------------------------------------------*/
+static int32_t   twCos[FFT_MAX/2];
+static int32_t   twSin[FFT_MAX/2];
+static uint32_t  fftReady = 0;
+
+
+/* Code  ---------------------------------------------------------------------*/
+
+/* set up the twiddle tables (for FFT_MAX, smaller sizes use a stride)
+ */
+void  initFft (void)
+{
+    uint32_t  i;
+
+    if (fftReady)
+        return;
+
+    for (i=0; i<FFT_MAX/2; i++)
+    {
+        twCos[i] = (int32_t) (cosf (2.0f * FFT_PI * i / FFT_MAX) * (Q31_ONE - 128.0f));
+        twSin[i] = (int32_t) (sinf (2.0f * FFT_PI * i / FFT_MAX) * (Q31_ONE - 128.0f));
+    }
+    fftReady = 1;
+}
+
+
+
+/* transform 2^bits complex points (interleaved re, im) in place
+ */
+void  fftQ31 (int32_t *pData, uint32_t bits)
+{
+    uint32_t  i, j, k, m, n, len, half, step;
+    int32_t   tr, ti, wr, wi, t;
+
+    n = 1UL << bits;
+
+    // bit reversal permutation
+    for (i=0, j=0; i<n; i++)
+    {
+        if (i < j)
+        {
+            t = pData[2*i];    pData[2*i]   = pData[2*j];    pData[2*j]   = t;
+            t = pData[2*i+1];  pData[2*i+1] = pData[2*j+1];  pData[2*j+1] = t;
+        }
+        for (m=n>>1; (m >= 1) && (j & m); m >>= 1)
+            j ^= m;
+        j |= m;
+    }
+
+    for (len=2; len<=n; len<<=1)
+    {
+        half = len >> 1;
+        step = FFT_MAX / len;
+        for (i=0; i<n; i+=len)
+            for (k=0; k<half; k++)
+            {
+                int32_t  *pa = &pData[2*(i+k)];
+                int32_t  *pb = &pData[2*(i+k+half)];
+
+                wr    =  twCos[k*step];           // e^(-j*2*pi*k/len)
+                wi    = -twSin[k*step];
+                tr    = (int32_t) (((int64_t) wr * pb[0] - (int64_t) wi * pb[1]) >> 31);
+                ti    = (int32_t) (((int64_t) wr * pb[1] + (int64_t) wi * pb[0]) >> 31);
+                pb[0] = (pa[0] - tr) >> 1;
+                pb[1] = (pa[1] - ti) >> 1;
+                pa[0] = (pa[0] + tr) >> 1;
+                pa[1] = (pa[1] + ti) >> 1;
+            }
+    }
+}
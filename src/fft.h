@@ -0,0 +1,18 @@
+#ifndef FFT_H
+  #define FFT_H
+
+/* fixed-point radix-2 FFT, shared by the array processing stages
+ */
+
+/* ---------------- definitions ----------------
+ */
+#define FFT_MAX_BITS           9
+#define FFT_MAX                (1 << FFT_MAX_BITS)   // largest transform size
+
+
+/* ------------ function prototypes ------------
+ */
+void  initFft  (void);
+void  fftQ31   (int32_t *pData, uint32_t bits);
+
+#endif  //  FFT_H
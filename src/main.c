@@ -39,9 +39,26 @@
 #include "bmp280.h"
 #include "hal_spi.h"
 #include "sd_card.h"
+#include "multirate.h"
+#include "tones.h"
+#include "stats.h"
+#include "wind.h"
+#include "render.h"
+#include "perf.h"
+#include "sched.h"
+#include "power.h"
+#include "prof.h"
+#include "trace.h"
+#include "crash.h"
+#include "wdog.h"
+#include "boot.h"
+#include "config.h"
+#include "persist.h"
 #include "ff.h"
 
-#define _HW_TEST_
+#if (CFG_TONES != TONE_MAX_LINES)
+  #error "the configuration needs one tone key per detector line"
+#endif
 
 /* external variables ---------------------------*/
 
@@ -49,15 +66,25 @@
 RCC_ClocksTypeDef     RCC_Clocks;
 volatile uint32_t     toDelay             = 0;   /* Timeout Delay, in ms    */
 volatile uint16_t     currentAPvalue      = 0;   /* current pressure sample */
-volatile uint32_t     runChain            = 0;
 volatile uint32_t     txTimer             = 0;
 uint16_t              calValue            = 0;   /* calibration value      */
 uint16_t              serialActive        = 0;   /* activate serial output */
 uint8_t               sysMode             = 0;   /* system state           */
 uint8_t               btnState            = 0;
 char                  sBuffer[32]         = {0};  // string buffer for some UART operations
-uint8_t               txIndex             = 0;    // associated index
+uint8_t               txBuffer[TX_BUF_SIZE];      // UART transmit ring buffer
+volatile uint16_t     txHead              = 0;    // associated indices
+volatile uint16_t     txTail              = 0;
+uint32_t              txDropped           = 0;    // bytes lost on a full buffer
+volatile uint8_t      serialCmd           = 0;    // command character received
 uint8_t               SmplBuffer          = 0;
+uint16_t              smplBuffer[SMPL_BUF_SIZE];  // SysTick sample FIFO
+volatile uint16_t     smplHead            = 0;    // associated indices
+volatile uint16_t     smplTail            = 0;
+static uint16_t       bootBuffer[BOOT_BUF_SIZE];  // samples until the file is open
+static uint32_t       bootCount           = 0;
+static const char    *bootError           = NULL; // storage message, for the LCD
+Config                cfg;                        // run-time configuration (infra.cfg)
 
 static uint8_t        msgBuffer[MSG_SIZE] = {0};
 volatile uint8_t      devStatus           = DEV_STATUS_NONE;
@@ -66,6 +93,8 @@ volatile uint8_t      devStatus           = DEV_STATUS_NONE;
 volatile uint32_t     TimingDelay         = 0;
 static uint16_t       btCount             = 0;  // received button press counter
 static uint16_t       btLastState         = 0;  // button press flag
+static uint16_t       btHeld              = 0;  // polls the button is held
+static uint8_t        hudSaved            = 0;  // HUD state before field mode
 
 static const int8_t   DbgMsg[]            = "Infrasound sensing Application V1.0";
 static const int8_t   AtMsg[]             = "< @f.m.  04 / 2024 >";
@@ -77,18 +106,11 @@ FATFS                 fatfs;
 int32_t               fileState = 0;
 uint32_t              FileID    = 0;
 FIL                   file;
+FIL                   sumFile;
 
 /// --- graphics related ---
-#define GFX_AVGBUF_SIZE             8   // buffer for Gfx averaging
-#define GFX_AVG                     3   // number of data items per gfx point
-
-static uint32_t       dataCount   = 0;
-static uint16_t       gfxCalValue = 0;
 static uint16_t       fgColor     = GFX_COLOR_TEXT;
 static uint16_t       bgColor     = GFX_COLOR_BACKGOUND;
-static uint16_t       curGX       = 0;
-static uint16_t       avBuffer[GFX_AVGBUF_SIZE];
-static uint16_t       avIndex     = 0;
 
 
 /* function prototypes --------------------------
@@ -99,34 +121,86 @@ static void      sysdelay            (uint32_t delaytime);
 static void      eLoop               (void);
 void             tdelay              (uint16_t ticks);
 void             putItem             (uint16_t);
+static void      putToneReports      (void);
+static void      putSummaries        (void);
+static void      setToneLines        (void);
 void             writeItem           (void);
 void             writeBuffer         (uint8_t *str, uint8_t size);
 static uint16_t  getCalibrationValue (uint16_t *pBuffer, uint16_t items);
-
-static void      initGfx             (void);
-static void      gfxUpdate           (uint16_t data);
+static void      checkButton         (void);
+static void      setFieldMode        (uint8_t on);
+static void      runLowRate          (void);
+static void      serialCommand       (uint8_t cmd);
+static void      reportCrash         (void);
+static void      reportReset         (void);
+static uint8_t   sensorMode          (void);
+static void      keepItem            (uint16_t data, uint8_t stored);
+static void      keepWind            (uint16_t data, uint8_t stored);
+
+static void      taskAcquire         (void);
+static void      taskStore           (void);
+static void      taskRender          (void);
+static void      taskSerial          (void);
+static void      taskHousekeeping    (void);
+static void      taskBoot            (void);
+
+static uint8_t   bootStorage         (void);
+static uint8_t   bootDisplay         (void);
+static uint8_t   bootReports         (void);
+static uint8_t   bootTestSensor      (void);
+static uint8_t   bootTestTone        (void);
+static uint8_t   bootTestWind        (void);
+static void      initLcd             (void);
 
 static void      initUART6           (void);
 static void      sendDataItem        (uint16_t data);
 static void      sendHeader          (void);
 
+/// --- task table, in priority order (see sched.h) ---
+static const SchedTask  taskTable[SCHED_TASKS] =
+{
+    { "acq",    taskAcquire,      0,  SCHED_TICK_US,         1000 },   // posted per sample
+    { "store",  taskStore,        0,  50000,                 2000 },   // SD card stalls
+    { "render", taskRender,       1,  1000000 / RENDER_FPS,  2000 },   // frame timing in renderTask
+    { "serial", taskSerial,       0,  100000,                2000 },
+    { "house",  taskHousekeeping, 15, 100000,                2000 },   // 100ms
+    { "boot",   taskBoot,         1,  0,                     WDOG_BOOT_MS },
+};
+
+/// --- boot steps, after the sampling is running (see boot.h) ---
+/// the self tests (config "selftest") take one step each, so the other
+/// tasks run in between; they are part of the (already marked) reports stage
+#define BOOT_STEPS            6
+static const BootStep   bootSteps[BOOT_STEPS] =
+{
+    { BOOT_STAGE_STORAGE,  bootStorage },
+    { BOOT_STAGE_DISPLAY,  bootDisplay },
+    { BOOT_STAGE_REPORTS,  bootReports },
+    { BOOT_STAGE_REPORTS,  bootTestSensor },
+    { BOOT_STAGE_REPORTS,  bootTestTone },
+    { BOOT_STAGE_REPORTS,  bootTestWind },
+};
+
 
 /* -------- main() --------
+ * only the sampling path is brought up here, the rest follows in the
+ * boot steps (bootSteps), run by the boot task
  */
 int  main (void)
 {
-    int       i;
-    uint16_t  data;
-    uint8_t   len, ret;
-    char     *pm;
-
-    i = 0;
+    uint8_t   ret;
+
+    initBoot (bootSteps, BOOT_STEPS);   // time base; first
+    configDefaults (&cfg);    // until infra.cfg is read, in bootStorage
+    initCrash ();             // fault handlers, backup SRAM
+    initWdog ();              // supervised boot from here on
+    (void) initPersist ();    // file ID, calibration, totals
+    calValue = (uint16_t) persistGet ()->calValue;      // until recalibrated
     RCC_GetClocksFreq (&RCC_Clocks);
     SysTick_Config (RCC_Clocks.HCLK_Frequency / 150);  /* 100 => <10ms-tick> */
 
     /* init Discovery LEDs and user button */
     initF4LEDsButtons ();
-    STM_EVAL_LEDOn (LED4);    /// green LED, main init done
 
     // initialize serial output; possibly used
     initUART6 ();
@@ -139,15 +213,8 @@ int  main (void)
         sysMode = DEV_STATUS_CALIBRATE;
 #endif
 
-    // init the LCD display; wait 15 ticks (100ms) to settle before
-    tdelay (15);
-    STM32f4_Discovery_LCD_Init();
-    LCD_Clear (LCD_COLOR_BLACK);
-    LCD_SetBackColor (bgColor);
-    LCD_SetTextColor (fgColor);
-
-    LCD_DisplayStringLine (LINE(HEADER_LINE), (uint8_t *) DbgMsg);
-    LCD_DisplayStringLine (LINE(CUR_POS_LINE), (uint8_t *) AtMsg);
+    if (serialActive == 1)
+        sendHeader ();
 
     // setup SPI for the sensor
     setup_spi ();
@@ -156,61 +223,410 @@ int  main (void)
     ret = initSensor (BMP280_CONFIG_MODE_0);
     if (ret != BMP280_ID)
     {
+        initLcd ();
         sprintf ((char *) msgBuffer, "sensor init failure (ID read) !");
-        LCD_DisplayStringLine (LINE(ERR_MSG_LINE), msgBuffer);
+        LCD_DisplayStringLineDiff (LINE(ERR_MSG_LINE), msgBuffer);
         devStatus = DEV_STATUS_ERROR;
         eLoop ();
     }
 
-#ifdef _HW_TEST_
-    ret = getReg (REG_STATUS);
-    printf ("STAT = 0x%02x\n", ret);
-    ret = getReg (REG_CTRL);
-    printf ("CTRL = 0x%02x\n", ret);
-    ret = getReg (REG_CONFIG);
-    printf ("CFG  = 0x%02x\n", ret);
+#ifdef _AUTO_CALIBRATION_
+    sysMode = DEV_STATUS_CALIBRATE;
 #endif
 
-    // open SD card file; don't choke on errors
-    if (openDataFile () != 0)
+    // init the output rate streams and the monitors; then start sampling
+    initRates ();
+    initTones ();
+    setToneLines ();          // the defaults, until infra.cfg is read
+    initWind ();
+    initStats ();
+    initPerf ();
+    initPower ();
+    initProf ();
+    initTrace ();
+    devStatus = DEV_STATUS_RUN;
+    bootMark (BOOT_STAGE_SAMPLING);
+    STM_EVAL_LEDOn (LED4);    /// green LED, sampling
+
+    ///> main loop; the SysTick posts the samples, tasks run by priority,
+    ///> each one supervised by the watchdog once the boot is done
+    initSched (taskTable, SCHED_TASKS);
+    wdogRegister (WDOG_ID_LOWRATE, "lowrate", LOWRATE_ALIVE_MS);
+    wdogSelect (SCHED_EV(SCHED_TASK_BOOT), WDOG_TICK_HZ);
+    schedRun ();
+}
+
+
+
+/* boot step: read the configuration, and open SD card file; don't choke
+ * on errors; skipped after repeated watchdog resets (a hanging card), to
+ * keep at least the serial output; a file continued after a watchdog
+ * reset gets a mark; then the samples buffered meanwhile go to the file
+ * (at the full rate, as the decimation was not known yet)
+ */
+static uint8_t  bootStorage (void)
+{
+    const WdogRecord  *pr;
+    uint32_t           i;
+
+    if (wdogDegraded ())
+        bootError = "SD card skipped after resets !";
+    else
+    {
+        (void) readConfigFile (&cfg);   // no file: the defaults
+        setToneLines ();
+        if (sensorMode () != BMP280_CONFIG_MODE_0)
+        {
+            devStatus = DEV_STATUS_NONE;    // a gap of ~30ms, no SPI access
+            (void) initSensor (sensorMode ());
+            devStatus = DEV_STATUS_RUN;
+        }
+        if (openDataFile () != 0)
+            bootError = "SD card file failure; no storage !";
+    }
+
+    if (((bootError != NULL) || cfg.serial) && !serialActive)
     {
-        sprintf ((char *) msgBuffer, "SD card file failure; no storage !");
-        LCD_DisplayStringLine (LINE(ERR_MSG_LINE), msgBuffer);
         serialActive = 1;
+        sendHeader ();
     }
 
-#ifdef _AUTO_CALIBRATION_
-    sysMode = DEV_STATUS_CALIBRATE;
-#endif
+    pr = wdogGet ();
+    if ((fileState == 1) && (pr->cause == WDOG_CAUSE_IWDG) && (pr->starved != WDOG_ID_NONE))
+        (void) putResetMark (wdogName (pr->starved), &file);
+
+    // the boot buffer is at the full rate; the summary timing follows
+    // the rate of the samples stored
+    if ((fileState == 1) && (cfg.decimation != 1) && (bootCount > 0))
+        (void) putRateMark (RATE_INPUT_HZ, &file);
+    statsSetRate (RATE_INPUT_HZ);
+    for (i=0; i<bootCount; i++)
+        putItem (bootBuffer[i]);
+    if ((fileState == 1) && (cfg.decimation != 1) && (bootCount > 0))
+        (void) putRateMark (RATE_INPUT_HZ / cfg.decimation, &file);
+    statsSetRate (RATE_INPUT_HZ / cfg.decimation);
+    bootCount = 0;
+    return (1);
+}
 
-    devStatus = DEV_STATUS_RUN;
 
+
+/* boot step: the LCD, once it had its power-up time; the header, the
+ * mode and error messages, and the renderer
+ */
+static uint8_t  bootDisplay (void)
+{
+    if (bootTimeUs () < BOOT_LCD_SETTLE_US)
+        return (0);
+
+    initLcd ();
+    if (bootError != NULL)
+        LCD_DisplayStringLineDiff (LINE(ERR_MSG_LINE), (uint8_t *) bootError);
     if (sysMode == DEV_STATUS_CALIBRATE)
+        LCD_DisplayStringLineDiff (LINE(SYSMOD_LINE), (uint8_t *) CalMsg);
+    initRender (calValue);
+    renderSetMode (cfg.display);
+    renderSetZoom (cfg.zoom);
+    perfSetHud (cfg.hud);
+    return (1);
+}
+
+
+
+/* boot step: a crash dump or a watchdog reset from before the last
+ * reset, and the persistent state
+ */
+static uint8_t  bootReports (void)
+{
+    char     lbuf[PERSIST_LINE_SIZE];
+    int      sl;
+
+    reportCrash ();
+    reportReset ();
+    if (serialActive)
     {
-        pm = (char *) CalMsg;
-        LCD_DisplayStringLine (LINE(SYSMOD_LINE), (uint8_t *) pm);
+        sl = persistLine (lbuf);
+        (void) serialWrite (lbuf, sl);
     }
+    return (1);
+}
 
-    // init data display graphics
-    initGfx ();
 
-    if (serialActive == 1)
-        sendHeader ();
 
-    ///> main loop; read pressure value regularly
-    do
+/* boot step, self test: the sensor registers; the SysTick sampling
+ * is paused for the SPI access
+ */
+static uint8_t  bootTestSensor (void)
+{
+    uint8_t  stat, ctrl, conf, status;
+
+    if (!cfg.selftest)
+        return (1);
+    status    = devStatus;
+    devStatus = DEV_STATUS_NONE;
+    stat = getReg (REG_STATUS);
+    ctrl = getReg (REG_CTRL);
+    conf = getReg (REG_CONFIG);
+    devStatus = status;
+    printf ("STAT = 0x%02x\nCTRL = 0x%02x\nCFG  = 0x%02x\n", stat, ctrl, conf);
+    return (1);
+}
+
+
+
+/* boot step, self test: tone detector cost (state kept)
+ */
+static uint8_t  bootTestTone (void)
+{
+    if (cfg.selftest)
+        printf ("tone = %u cycles/line\n", (unsigned) toneBenchmark ());
+    return (1);
+}
+
+
+
+/* boot step, self test: wind noise stage cost
+ */
+static uint8_t  bootTestWind (void)
+{
+    uint32_t  cyc, budget;
+
+    if (!cfg.selftest)
+        return (1);
+    cyc = windBenchmark (&budget);
+    printf ("wind = %u cycles/block (%u permille)\n", (unsigned) cyc, (unsigned) budget);
+    return (1);
+}
+
+
+
+/* the boot steps, one per boot task run; once done, all tasks are
+ * supervised by the watchdog
+ */
+static void  taskBoot (void)
+{
+    static uint8_t  done = 0;
+
+    if (done || !bootTask ())
+        return;
+    done = 1;
+    wdogSelect (SCHED_EV(SCHED_TASKS) - 1, WDOG_TICK_HZ);
+}
+
+
+
+/* init the LCD display, and show the header; the line benchmark (self
+ * test) draws over the left screen part, so it runs before anything is
+ * shown
+ */
+static void  initLcd (void)
+{
+    uint32_t  pxPixelwise, pxBurst;
+
+    STM32f4_Discovery_LCD_Init();
+    if (cfg.selftest)
     {
-        if (runChain)
-        {
-            STM_EVAL_LEDOn (LED6);    // blue LED on
-            data = currentAPvalue;    // get value from interrupt handler
-            runChain = 0;
-            putItem (data);
-            gfxUpdate (data);
-            STM_EVAL_LEDOff (LED6);   // blue LED off
-        }
+        LCD_LineBenchmark (&pxPixelwise, &pxBurst);
+        printf ("vline = %u px/s pixelwise, %u px/s burst\n", (unsigned) pxPixelwise, (unsigned) pxBurst);
+    }
+    LCD_Clear (LCD_COLOR_BLACK);
+    LCD_SetBackColor (bgColor);
+    LCD_SetTextColor (fgColor);
+
+    LCD_DisplayStringLineDiff (LINE(HEADER_LINE), (uint8_t *) DbgMsg);
+    LCD_DisplayStringLineDiff (LINE(CUR_POS_LINE), (uint8_t *) AtMsg);
+}
+
+
+
+/* sample drain; the values read by the SysTick handler go to the
+ * tone monitor and the rate streams; a backlog (a blocking boot step)
+ * is taken SMPL_BATCH samples per run, so the storage keeps up
+ */
+static void  taskAcquire (void)
+{
+    uint16_t  data, n;
+
+    STM_EVAL_LEDOn (LED6);    // blue LED on
+    for (n=0; (n < SMPL_BATCH) && (smplTail != smplHead); n++)
+    {
+        data     = smplBuffer[smplTail];    // get value from interrupt handler
+        smplTail = (smplTail + 1) & (SMPL_BUF_SIZE - 1);
+        TRACE (TRACE_CONSUME, data);
+        if (toneInput (data))
+            putToneReports ();
+        rateInput (data);
+    }
+    persistSamples (n);
+    schedPost (SCHED_EV(SCHED_TASK_STORE) | SCHED_EV(SCHED_TASK_SERIAL));
+    STM_EVAL_LEDOff (LED6);   // blue LED off
+}
+
+
+
+/* full rate (or 50Hz, as configured) samples to the data file, full
+ * rate samples to the renderer, and the barometer channel to the file;
+ * with the wind key set, the wind noise stage output (full rate) as well;
+ * the queues are drained in calibration mode as well; until the storage
+ * boot step is done, the samples are kept in RAM, and the renderer waits
+ * for the display
+ */
+static void  taskStore (void)
+{
+    uint16_t  data, n;
+    uint8_t   stored, shown;
+
+    stored = bootReady (BOOT_STAGE_STORAGE);
+    shown  = bootReady (BOOT_STAGE_DISPLAY);
+    for (n=0; rateGet (RATE_OUT_FULL, &data); n++)
+    {
+        if ((cfg.decimation == 1) || !stored)
+            keepItem (data, stored);
+        if (cfg.wind)
+            keepWind (data, stored);
+        if (shown)
+            renderInput (data);   // full rate; envelopes keep short spikes
+    }
+    TRACE (TRACE_BLOCK, n);
+
+    while (rateGet (RATE_OUT_MID, &data))
+    {
+        if ((cfg.decimation != 1) && stored)
+            keepItem (data, stored);
+    }
+
+    while (rateGet (RATE_OUT_BARO, &data))
+    {
+        if ((sysMode != DEV_STATUS_CALIBRATE) && stored)
+            (void) putBaroItem (data, &file);
+    }
+}
+
+
+
+/* a sample to the data file, or to the boot buffer until the storage
+ * boot step is done
+ */
+static void  keepItem (uint16_t data, uint8_t stored)
+{
+    if (stored)
+        putItem (data);
+    else if (bootCount < BOOT_BUF_SIZE)
+        bootBuffer[bootCount++] = data;
+}
+
+
+
+/* a sample through the wind noise stage, and its flags and average
+ * channel to the data file; this board has a single sensor, so all
+ * channels get the same sample (coherent, no flags, the average is the
+ * input) until further inlets are wired in here
+ */
+static void  keepWind (uint16_t data, uint8_t stored)
+{
+    uint16_t  ch[WIND_CHANNELS];
+    uint16_t  avg;
+    uint32_t  i;
+
+    for (i=0; i<WIND_CHANNELS; i++)
+        ch[i] = data;
+    avg = windInput (ch);
+    if (stored && (sysMode != DEV_STATUS_CALIBRATE))
+        (void) putWindItem (windFlags (), avg, &file);
+}
+
+
+
+/* fixed frame rate; yields to samples and storage
+ */
+static void  taskRender (void)
+{
+    uint32_t  t0;
+
+    if (!bootReady (BOOT_STAGE_DISPLAY))
+        return;
+    t0 = DWT->CYCCNT;
+    PROF_ENTER (PROF_ZONE_RENDER);
+    if (renderTask (&schedPreempt))
+    {
+        PROF_EXIT (PROF_ZONE_RENDER);
+        TRACE (TRACE_FRAME, (DWT->CYCCNT - t0) / (SystemCoreClock / 1000000));
+    }
+}
+
+
+
+/* the decimated stream to the serial output, received commands, and
+ * the profiling table dump
+ */
+static void  taskSerial (void)
+{
+    uint16_t  data;
+    uint8_t   cmd;
+
+    while (rateGet (RATE_OUT_SERIAL, &data))
+    {
+        if (serialActive && (sysMode != DEV_STATUS_CALIBRATE))
+            sendDataItem (data);
+    }
+
+    if (serialCmd)
+    {
+        cmd       = serialCmd;
+        serialCmd = 0;
+        serialCommand (cmd);
+    }
+    profTask ();
+    traceTask ();
+}
+
+
+
+/* single character commands from the serial line:
+ *   z  dump the profiling zones
+ *   Z  dump, and reset them
+ *   t  dump the event trace
+ *   +  zoom in, half the time per screen
+ *   -  zoom out, double the time per screen
+ */
+static void  serialCommand (uint8_t cmd)
+{
+    switch (cmd)
+    {
+        case 'z':
+            profDump (0);
+            break;
+        case 'Z':
+            profDump (1);
+            break;
+        case 't':
+            traceDump ();
+            break;
+        case '+':
+            if (bootReady (BOOT_STAGE_DISPLAY) && (renderGetZoom () > 0))
+                renderSetZoom (renderGetZoom () - 1);
+            break;
+        case '-':
+            if (bootReady (BOOT_STAGE_DISPLAY))
+                renderSetZoom (renderGetZoom () + 1);
+            break;
+        default:
+            break;
+    }
+}
+
+
+
+static void  taskHousekeeping (void)
+{
+    if (bootReady (BOOT_STAGE_DISPLAY))
+    {
+        checkButton ();
+        perfTask ();
     }
-    while (1);
+    schedReport ();
+    powerReport ();
+    persistTick (100);
 }
 
 
@@ -235,7 +651,7 @@ static void  initF4LEDsButtons (void)
 static void  sysdelay (uint32_t delaytime)
 {
     TimingDelay = delaytime / 10;  // 10ms granularity
-    while (TimingDelay);            // decremented in Systick interrupt
+    powerWait (&TimingDelay);       // decremented in Systick interrupt
 }
 
 
@@ -246,17 +662,18 @@ static void  putLcdDbgLine (void)
     char  dBuf[24] = { 0 };
 
     sprintf (dBuf, "some data...");
-    LCD_DisplayStringLine (LINE(CUR_POS_LINE), (uint8_t *) dBuf);
+    LCD_DisplayStringLineDiff (LINE(CUR_POS_LINE), (uint8_t *) dBuf);
 }
 
 
 
 /* a simpler delay function version, based on ticks instead of milliseconds;
+ * sleeps until the SysTick counted down
  */
 void  tdelay (uint16_t ticks)
 {
     toDelay = ticks;
-    while (toDelay > 0);
+    powerWait (&toDelay);
 }
 
 
@@ -268,6 +685,124 @@ void  delay (uint32_t  count)
 }
 
 
+/* user button, polled every 100ms (debounce);
+ * a short press toggles between the sweeping and the scrolling chart,
+ * a long press (2s) steps from run to field to low-rate mode; the press
+ * that wakes the low-rate mode returns to run mode
+ */
+static void  checkButton (void)
+{
+    uint16_t  state;
+
+    state = STM_EVAL_PBGetState (BUTTON_USER);
+    if (state)
+    {
+        if (++btHeld == BTN_LONG_POLLS)
+        {
+            if (powerGetMode () == POWER_MODE_RUN)
+                setFieldMode (1);
+            else
+            {
+                runLowRate ();
+                setFieldMode (0);
+                btHeld = BTN_LONG_POLLS + 1;    // ignore the waking press
+            }
+        }
+    }
+    else
+    {
+        if (btLastState && (btHeld < BTN_LONG_POLLS) && (powerGetMode () == POWER_MODE_RUN))
+        {
+            btCount++;
+            renderSetMode ((renderGetMode () == RENDER_MODE_SWEEP) ? RENDER_MODE_SCROLL : RENDER_MODE_SWEEP);
+        }
+        btHeld = 0;
+    }
+    btLastState = state;
+}
+
+
+/* field mode: acquisition, storage and serial output only; the display
+ * is switched off, and the core clock lowered
+ */
+static void  setFieldMode (uint8_t on)
+{
+    if (on)
+    {
+        hudSaved = perfGetHud ();
+        perfSetHud (0);
+        renderPause (1);
+        LCD_DisplayOff ();
+        powerSetMode (POWER_MODE_FIELD);
+    }
+    else
+    {
+        powerSetMode (POWER_MODE_RUN);
+        LCD_DisplayOn ();
+        renderPause (0);
+        perfSetHud (hudSaved);
+    }
+}
+
+
+/* low-rate mode, entered from field mode; the sensor oversamples and
+ * filters by itself, and the core sleeps in Stop mode between samples,
+ * which are written to the file per block, and go to the interval
+ * statistics at their rate; the SysTick sampling and the
+ * tasks are suspended (this runs inside the housekeeping task), until
+ * the user button is pressed
+ */
+static void  runLowRate (void)
+{
+    static uint16_t  block[LOWRATE_BLOCK];
+    uint32_t         n;
+
+    wdogSelect (WDOG_EV(WDOG_ID_LOWRATE), cfg.lowRateHz);
+    devStatus = DEV_STATUS_LOWRATE;     // no more SysTick sampling, or polls
+    (void) initSensor (BMP280_CONFIG_MODE_1);
+    if (sysMode != DEV_STATUS_CALIBRATE)
+        (void) putRateMark (cfg.lowRateHz, &file);
+    statsSetRate (cfg.lowRateHz);       // the summary timeline goes on
+    powerSetMode (POWER_MODE_STOP);
+    initPowerStop (cfg.lowRateHz);
+
+    n = 0;
+    while (!(powerStop () & POWER_WAKE_BUTTON))
+    {
+        wdogCheckin (WDOG_ID_LOWRATE);
+        wdogPoll ();                    // no SysTick in Stop mode
+        STM_EVAL_LEDOn (LED6);
+        block[n++] = readPSensor ();
+        STM_EVAL_LEDOff (LED6);
+        persistSamples (1);
+        persistTick (1000 / cfg.lowRateHz);
+        if (sysMode != DEV_STATUS_CALIBRATE)
+        {
+            statsInput (block[n-1]);
+            putSummaries ();
+        }
+        if (n == LOWRATE_BLOCK)
+        {
+            if (sysMode != DEV_STATUS_CALIBRATE)
+                (void) putDataBlock (block, n, &file);
+            n = 0;
+        }
+    }
+
+    powerStopExit ();
+    powerSetMode (POWER_MODE_FIELD);
+    if (sysMode != DEV_STATUS_CALIBRATE)
+    {
+        (void) putDataBlock (block, n, &file);
+        (void) putRateMark (RATE_INPUT_HZ / cfg.decimation, &file);
+    }
+    statsSetRate (RATE_INPUT_HZ / cfg.decimation);
+    (void) initSensor (sensorMode ());
+    wdogSelect (SCHED_EV(SCHED_TASKS) - 1, WDOG_TICK_HZ);
+    devStatus = DEV_STATUS_RUN;
+}
+
+
 /* process the sample item;
  * consequently, save it to file in run mode;
  * in calibration mode, just evaluate the calibration value
@@ -282,22 +817,166 @@ void  putItem (uint16_t data)
         avg += data;
         avcount++;
 
-        if (avcount >= CAL_ITEMS)
+        if (avcount >= cfg.calItems)
         {
             sysMode  = DEV_STATUS_RUN;
-            calValue = avg / CAL_ITEMS;
+            calValue = avg / cfg.calItems;
+            persistSetCal (calValue);
         }
     }
     else
     {
+        PROF_ENTER (PROF_ZONE_PUT_DATA);
         (void) putDataItem (data, &file);
+        PROF_EXIT (PROF_ZONE_PUT_DATA);
+        statsInput (data);
+        putSummaries ();
+    }
+}
+
+
+
+/* pass completed interval statistics records to the summary file,
+ * and to the serial output (prefixed with 'S'), except in low-rate mode,
+ * where the serial output is not served in Stop mode
+ */
+static void  putSummaries (void)
+{
+    StatsRecord  rec;
+    char         lbuf[64];
+    int          sl;
+
+    while (statsGet (&rec))
+    {
+        (void) putSummaryItem (&rec, &sumFile);
+        if (serialActive && (devStatus != DEV_STATUS_LOWRATE))
+        {
+            lbuf[0] = 'S';
+            sl = statsFormat (&rec, &lbuf[1]);
+            (void) serialWrite (lbuf, sl + 1);
+        }
+    }
+}
+
+
+
+/* set up the tone monitor lines of the configuration; the parser took
+ * only lines the detector accepts
+ */
+static void  setToneLines (void)
+{
+    uint8_t  i;
+
+    for (i=0; i<CFG_TONES; i++)
+        (void) toneSetLine (i, cfg.tone[i].freq, cfg.tone[i].bw, cfg.tone[i].alarm);
+}
+
+
+
+/* pass the tone monitor results to file and serial output,
+ * and signal a tonal alarm with the orange LED
+ */
+static void  putToneReports (void)
+{
+    ToneReport  rep;
+    uint8_t     i;
+    int         sl;
+
+    if (toneAlarms ())
+        STM_EVAL_LEDOn (LED3);
+    else
+        STM_EVAL_LEDOff (LED3);
+
+    if (sysMode == DEV_STATUS_CALIBRATE)
+        return;
+
+    for (i=0; i<TONE_MAX_LINES; i++)
+    {
+        if (toneGetReport (i, &rep) != TONE_RET_OK)
+            continue;
+        if (bootReady (BOOT_STAGE_STORAGE))
+            (void) putToneItem (i, &rep, &file);
         if (serialActive)
-            sendDataItem (data);
+        {
+            sl = sprintf ((char *) msgBuffer, "T%u %lu %d%s\n", i, (unsigned long) rep.amp, rep.phase, rep.alarm ? " A" : "");
+            (void) serialWrite ((char *) msgBuffer, sl);
+        }
     }
 }
 
 
 
+/* post-mortem report of a fault before the last (watchdog) reset:
+ * a summary on the LCD, the full dump to the crash log on the SD card
+ * and to the serial output; the serial lines are paced by the transmit
+ * buffer, about 0.3s at most; the dump is marked reported only once it
+ * is in the crash log, until then it is reported at every boot
+ */
+static void  reportCrash (void)
+{
+    const CrashDump  *pd;
+    char              lbuf[CRASH_LINE_SIZE];
+    uint32_t          i;
+    int               sl;
+
+    pd = crashGet ();
+    if (pd == NULL)
+        return;
+
+    sprintf ((char *) msgBuffer, "crash: %s at %08lX", crashName (pd->exception), (unsigned long) pd->pc);
+    LCD_DisplayStringLineDiff (LINE(ERR_MSG_LINE), msgBuffer);
+    STM_EVAL_LEDOn (LED5);    // red LED, crash indication
+
+    if (putCrashReport () == FR_OK)
+        crashReported ();   // else shown again at the next boot, until in crash.log
+
+    if (!serialActive)
+        return;
+    for (i=0; (sl = crashLine (i, lbuf)) > 0; i++)
+    {
+        while (serialFree () < (uint32_t) sl)
+            tdelay (1);
+        (void) serialWrite (lbuf, sl);
+    }
+}
+
+
+
+/* the reset cause to the serial output, as 'R' record:
+ *   R<watchdog resets> <cause> <starved task> <its time since check-in, ms>
+ * after a watchdog reset, also to the LCD (the data file got its mark
+ * in bootStorage)
+ */
+static void  reportReset (void)
+{
+    const WdogRecord  *pr;
+    int                sl;
+
+    pr = wdogGet ();
+    if (serialActive)
+    {
+        sl = sprintf ((char *) msgBuffer, "R%lu %s %s %u\n", (unsigned long) pr->resets,
+                      wdogCauseName (pr->cause), wdogName (pr->starved), pr->ageMs);
+        (void) serialWrite ((char *) msgBuffer, sl);
+    }
+
+    if ((pr->cause != WDOG_CAUSE_IWDG) || (pr->starved == WDOG_ID_NONE))
+        return;
+    sprintf ((char *) msgBuffer, "watchdog reset: %s, %ums", wdogName (pr->starved), pr->ageMs);
+    LCD_DisplayStringLineDiff (LINE(ERR_MSG_LINE + 1), msgBuffer);
+}
+
+
+
+/* the configured sensor mode, at the full sample rate
+ */
+static uint8_t  sensorMode (void)
+{
+    return ((cfg.sensor == CFG_SENSOR_FILTERED) ? BMP280_CONFIG_MODE_2 : BMP280_CONFIG_MODE_0);
+}
+
+
+
 /* endless error loop;
  * cannot init sensor; blink LED
  */
@@ -315,98 +994,54 @@ static void  eLoop (void)
 
 
 /* initialize the transmission of a data item via serial line;
- * function is executed in "real time", and supposedly finishes
- * long before the 6.6ms sample cycle (ca. 10Byte/ms throughput);
- * otherwise Tx data could overlap / be corrupted;
+ * the item is queued, and sent from the UART TXE interrupt
  */
 static void  sendDataItem (uint16_t data)
 {
-    sprintf (sBuffer, "%hu\n", data);
+    char  lbuf[8];
+    int   sl;
 
-    // initialize UART TXE interrupt, and send first character
-    USART6->CR1 |= USART_CR1_TXEIE;
-    txIndex      = 1;
-    USART6->DR   = sBuffer[0];
+    sl = sprintf (lbuf, (cfg.serialFormat == CFG_FORMAT_HEX) ? "%hX\n" : "%hu\n", data);
+    (void) serialWrite (lbuf, sl);
 }
 
 
 
-/* initialize internal graphics-related variables,
- * and draw the diagram frame
+/* copy data into the UART transmit ring buffer, and enable the
+ * TXE interrupt to start sending; data that do not fit are dropped
+ * (and counted), the function never waits;
+ * returns the number of bytes queued
  */
-static void  initGfx (void)
+uint32_t  serialWrite (const char *pStr, uint32_t len)
 {
     uint32_t  i;
+    uint16_t  next;
 
-    dataCount   = 0;
-    gfxCalValue = 0;
-    avIndex     = 0;
-    for (i=0; i<GFX_AVGBUF_SIZE; i++)
-        avBuffer[i] = 0;
+    for (i=0; i<len; i++)
+    {
+        next = (txHead + 1) & (TX_BUF_SIZE - 1);
+        if (next == txTail)
+        {
+            txDropped += len - i;
+            break;
+        }
+        txBuffer[txHead] = pStr[i];
+        txHead           = next;
+    }
 
-    // draw the diagram frame
-    fgColor = AXIS_COLOR;
-    LCD_SetColors (fgColor, bgColor);
-    LCD_DrawLine (X_AXIS_START, Y_AXIS_MID, X_AXIS_END - X_AXIS_START, LCD_DIR_HORIZONTAL);
-    LCD_DrawLine (X_AXIS_START, Y_AXIS_HIGH, Y_AXIS_LOW - Y_AXIS_HIGH, LCD_DIR_VERTICAL);
+    if (!(USART6->CR1 & USART_CR1_TXEIE))
+        TRACE (TRACE_TX_BEGIN, i);
+    USART6->CR1 |= USART_CR1_TXEIE;
+    return (i);
 }
 
 
 
-/* update the graphics display
+/* free space in the UART transmit ring buffer
  */
-static void  gfxUpdate (uint16_t data)
+uint32_t  serialFree (void)
 {
-    uint32_t  dg;
-    int16_t   y;
-
-    // set calibration value upon first data item
-    if (dataCount == 0)
-    {
-        if (calValue == 0)  // no calibration, just use first value ...
-            gfxCalValue = data;
-        else
-            gfxCalValue = calValue;
-    }
-    dataCount++;
-
-    // average over <n> data
-    avBuffer[avIndex++] = data;
-    if (avIndex < GFX_AVG)
-        return;
-    avIndex = 0;
-    for (dg=0, y=0; y<GFX_AVG; y++)
-        dg += avBuffer[y];
-    dg /= GFX_AVG;
-
-    // draw the data
-    // reset x index on last item of cycle
-    if (((dataCount+1) % GFX_CYCLE) == 0)
-        curGX = 0;
-
-    // set x drawing index
-    curGX++;
-
-    // overpaint previous cursor/data line
-    LCD_SetColors (GFX_COLOR_BACKGOUND, bgColor);
-    LCD_DrawLine (X_AXIS_START + curGX, Y_AXIS_HIGH, Y_AXIS_LOW - Y_AXIS_HIGH, LCD_DIR_VERTICAL);
-
-    // draw data
-    y = Y_AXIS_MID - dg;  // perhaps add some adaptive scaling here later ...
-    if (y < Y_AXIS_HIGH)
-        y = Y_AXIS_HIGH;
-    else if (y > Y_AXIS_LOW)
-        y = Y_AXIS_LOW;
-    fgColor = DATA_COLOR;
-    LCD_SetColors (fgColor, bgColor);
-    LCD_DrawLine (X_AXIS_START + curGX, Y_AXIS_MID, y, LCD_DIR_VERTICAL);
-
-    // new cursor line (unless for the very last)
-    if (curGX >= GFX_CYCLE)
-        return;
-    fgColor = CURSOR_COLOR;
-    LCD_SetColors (fgColor, bgColor);
-    LCD_DrawLine (X_AXIS_START + curGX + 1, Y_AXIS_MID - GFX_CURSOR_SIZE, 2 * GFX_CURSOR_SIZE, LCD_DIR_VERTICAL);
+    return ((uint32_t) (txTail - txHead - 1) & (TX_BUF_SIZE - 1));
 }
 
 
@@ -458,11 +1093,10 @@ static void  initUART6 (void)
     NVIC_InitStructure.NVIC_IRQChannelCmd         = ENABLE;
     NVIC_Init (&NVIC_InitStructure);
 
-    /* Interrupt at reception and receive errors */
-#if 0
+    /* Interrupt at reception and receive errors; the single character
+     * commands (serialCommand) */
     USART_ITConfig (USART6, USART_IT_RXNE, ENABLE);
     USART_ITConfig (USART6, USART_IT_ERR, ENABLE);
-#endif
     /* transmit interrupt enabled on demand */
 }
 
@@ -474,7 +1108,8 @@ static void  sendHeader (void)
 
     sl = index = 0;
 
-    sl = sprintf (sBuffer, "#infra_%d @150\n", PROTOCOL_VERSION);
+    sl = sprintf (sBuffer, "#infra_%d @%d%s\n", PROTOCOL_VERSION, RATE_SERIAL_HZ,
+                  (cfg.serialFormat == CFG_FORMAT_HEX) ? " hex" : "");
     if (sl <= 0)  // an unlikely sprintf() error
         return;
 
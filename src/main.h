@@ -31,8 +31,10 @@
 #define USARTx_RX_SOURCE        GPIO_PinSource5
 #define USARTx_RX_AF            GPIO_AF_7
 
-#define TX_BUF_SIZE             80
+#define TX_BUF_SIZE             256  //> UART Tx ring buffer, power of 2
 #define RX_BUF_SIZE             32
+#define SMPL_BUF_SIZE           1024 //> SysTick sample FIFO, power of 2 (6.8s)
+#define SMPL_BATCH              16   //> samples per acquisition task run
 #define TX_IDX_BTSTATE          4    //> data index into Tx/Rx buffer
 #define RX_TIMEOUT              11   //> >100ms receive timeout
 
@@ -41,17 +43,20 @@
 #define DEV_STATUS_INIT         0x01
 #define DEV_STATUS_CALIBRATE    0x02
 #define DEV_STATUS_RUN          0x03
+#define DEV_STATUS_LOWRATE      0x04    // Stop mode duty cycling
 #define DEV_STATUS_ERROR        0x80
 #define BUFFER_0                0       // transmit definitions ...
 #define BUFFER_1                1
 #define DB_SIZE                 32
-#define CAL_ITEMS               32
 #define MSG_SIZE                48      // display message buffer size
+#define BTN_LONG_POLLS          20      // button polls (100ms) of a long press
+#define LOWRATE_BLOCK           64      // samples per SD card write, low-rate mode
+#define LOWRATE_ALIVE_MS        2000    // low-rate loop, watchdog deadline
 #define WR_LSIZE                8       // size of a data file line
-#define FSYNC_SIZE              64      // fwrite operations before sync
 
-#define DATA_FILENAME_BASE      "APsmpl"
+// the sample settings, file name base and sync are run-time settings (config.h)
 #define DATA_FILENAME_EXT       ".dat"
+#define SUMMARY_FILENAME_EXT    ".sum"
 #define MAX_FILE_ID_NUM         100
 
 /* ------------------ graphics/display settings  ------------------ */
@@ -62,14 +67,17 @@
 #define HEADER_POS_X            0               // header (logo) position on display -> x
 #define HEADER_POS_Y            0               // header (logo) position on display -> y
 #define HEADER_LINE             0
-#define SYSMOD_LINE             3               // system mode display line
+#define RANGE_LINE              1               // Y scale / time base labels
+#define SYSMOD_LINE             2               // system mode display line
+#define PERF_HUD_LINE           3               // performance HUD, 2 lines
 #define ERR_MSG_LINE            12              // error message display line
+#define PERF_LINE               28              // render performance line
 #define CUR_POS_LINE            29
 #define X_AXIS_START            10
 #define X_AXIS_END              300
 #define Y_AXIS_LOW              220
-#define Y_AXIS_HIGH             20
-#define Y_AXIS_MID              120
+#define Y_AXIS_HIGH             40              // below the HUD lines
+#define Y_AXIS_MID              130
 #define GFX_CURSOR_SIZE         20
 #define GFX_CYCLE               (X_AXIS_END - X_AXIS_START - 1)
 #define GFX_COLOR_TEXT          LCD_COLOR_WHITE
@@ -82,4 +90,8 @@
  */
 void  delay (uint32_t  count);
 
-// #define _HW_TEST_
+/* queue data for the serial output (USART6, interrupt driven)
+ */
+uint32_t  serialWrite (const char *pStr, uint32_t len);
+uint32_t  serialFree  (void);
+
@@ -0,0 +1,253 @@
+/* ---------------------------------------------------------------------------
+ * multi-rate output streams;
+ * all output rates are computed in one pass from the single sensor
+ * input stream, using a small graph of polyphase FIR resampling stages;
+ * lower rates are derived from the already decimated higher ones,
+ * i.e. each stage is fed by the output of its source stage, into a
+ * delay line of its own:
+ *
+ *   150Hz --+--------------------------------------------> FULL
+ *           +-- /3 --> 50Hz --+--------------------------> MID
+ *                             +-- *2/5 --> 20Hz --+------> SERIAL
+ *                                                 +-- /5 --> 4Hz -- /4 --> BARO
+ *
+ * each output has its own subscriber queue, so a consumer only sees
+ * the items at its own rate;
+ * the filters are Q15 windowed-sinc (Hamming) lowpass designs
+ * ---------------------------------------------------------------------------
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include "stm32f4xx.h"
+#include "multirate.h"
+
+/* Private typedef -----------------------------------------------------------*/
+typedef struct
+{
+    uint16_t           buf[RATE_QUEUE_SIZE];
+    volatile uint16_t  head;
+    volatile uint16_t  tail;
+    uint32_t           overruns;
+} RateQueue;
+
+/* Private define ------------------------------------------------------------*/
+#define QUEUE_MASK             (RATE_QUEUE_SIZE - 1)
+#define Q15_ROUND              (1 << 14)
+
+/* Private variables ---------------------------------------------------------*/
+
+// 150Hz -> 50Hz, fc = 20Hz
+static const int16_t  coef_D3[24] =
+{
+       -15,     57,    160,    206,      0,   -532,  -1076,   -945,
+       498,   3237,   6354,   8439,   8441,   6354,   3237,    498,
+      -945,  -1076,   -532,      0,    206,    160,     57,    -15
+};
+
+// 50Hz -> 20Hz (via 100Hz), fc = 9Hz
+static const int16_t  coef_I2D5[40] =
+{
+       -43,    -42,    -28,      8,     71,    150,    210,    203,
+        82,   -163,   -485,   -773,   -873,   -630,     50,   1154,
+      2544,   3975,   5154,   5820,   5820,   5154,   3975,   2544,
+      1154,     50,   -630,   -873,   -773,   -485,   -163,     82,
+       203,    210,    150,     71,      8,    -28,    -42,    -43
+};
+
+// 20Hz -> 4Hz, fc = 1.6Hz
+static const int16_t  coef_D5[20] =
+{
+       -89,   -119,   -147,    -59,    304,   1052,   2162,   3444,
+      4582,   5254,   5254,   4582,   3444,   2162,   1052,    304,
+       -59,   -147,   -119,    -89
+};
+
+// 4Hz -> 1Hz, fc = 0.4Hz
+static const int16_t  coef_D4[16] =
+{
+      -114,   -159,   -139,    291,   1450,   3284,   5246,   6524,
+      6526,   5246,   3284,   1450,    291,   -139,   -159,   -114
+};
+
+// the decimation graph; stages must be ordered after their source
+static RateStage  stages[RATE_NUM_STAGES] =
+{
+    { coef_D3,   24, 1, 3, RATE_SRC_INPUT, RATE_OUT_MID     },
+    { coef_I2D5, 40, 2, 5, 0,              RATE_OUT_SERIAL  },
+    { coef_D5,   20, 1, 5, 1,              RATE_OUT_NONE    },
+    { coef_D4,   16, 1, 4, 2,              RATE_OUT_BARO    }
+};
+
+static RateQueue  queues[RATE_NUM_OUTPUTS];
+static uint32_t   primed = 0;
+
+/* Private prototypes --------------------------------------------------------*/
+static void       queuePut    (uint8_t output, int32_t value);
+static void       primeStages (int32_t value);
+static uint32_t   runStage    (RateStage *pStage, int32_t x, int32_t *pOut);
+
+
+/* Code  ---------------------------------------------------------------------*/
+
+/* reset all stage delay lines and output queues
+ */
+void  initRates (void)
+{
+    uint32_t  i;
+
+    for (i=0; i<RATE_NUM_STAGES; i++)
+    {
+        stages[i].dIndex = 0;
+        stages[i].phase  = 0;
+    }
+    memset (queues, 0, sizeof (queues));
+    primed = 0;
+}
+
+
+
+/* feed one sensor sample into the graph;
+ * every stage is evaluated at most once per input sample (L <= M),
+ * and results are pushed to the subscribed output queues
+ */
+void  rateInput (uint16_t data)
+{
+    int32_t   sOut[RATE_NUM_STAGES];
+    uint8_t   sValid[RATE_NUM_STAGES];
+    int32_t   x;
+    uint32_t  i;
+
+    // pre-load the delay lines with the first value, avoids a long settling ramp
+    if (!primed)
+    {
+        primeStages (data);
+        primed = 1;
+    }
+
+    queuePut (RATE_OUT_FULL, data);
+
+    for (i=0; i<RATE_NUM_STAGES; i++)
+    {
+        sValid[i] = 0;
+        if (stages[i].src == RATE_SRC_INPUT)
+            x = data;
+        else if (sValid[stages[i].src])
+            x = sOut[stages[i].src];
+        else
+            continue;
+
+        sValid[i] = runStage (&stages[i], x, &sOut[i]);
+        if (sValid[i] && (stages[i].out != RATE_OUT_NONE))
+            queuePut (stages[i].out, sOut[i]);
+    }
+}
+
+
+
+/* fetch the next item of an output stream;
+ * returns 1 if an item was available, 0 otherwise
+ */
+uint32_t  rateGet (uint8_t output, uint16_t *pData)
+{
+    RateQueue  *pq;
+
+    if (output >= RATE_NUM_OUTPUTS)
+        return 0;
+
+    pq = &queues[output];
+    if (pq->tail == pq->head)
+        return 0;
+
+    *pData   = pq->buf[pq->tail];
+    pq->tail = (pq->tail + 1) & QUEUE_MASK;
+    return 1;
+}
+
+
+
+/* number of items dropped because a consumer did not keep up
+ */
+uint32_t  rateOverruns (uint8_t output)
+{
+    if (output >= RATE_NUM_OUTPUTS)
+        return 0;
+    return (queues[output].overruns);
+}
+
+
+
+/* push a value into an output queue, saturated to the 16-bit sensor range;
+ * on a full queue, the newest item is dropped and counted
+ */
+static void  queuePut (uint8_t output, int32_t value)
+{
+    RateQueue  *pq;
+    uint16_t    next;
+
+    pq   = &queues[output];
+    next = (pq->head + 1) & QUEUE_MASK;
+    if (next == pq->tail)
+    {
+        pq->overruns++;
+        return;
+    }
+
+    if (value < 0)
+        value = 0;
+    else if (value > 0xFFFF)
+        value = 0xFFFF;
+
+    pq->buf[pq->head] = (uint16_t) value;
+    pq->head          = next;
+}
+
+
+
+static void  primeStages (int32_t value)
+{
+    uint32_t  i, k;
+
+    for (i=0; i<RATE_NUM_STAGES; i++)
+        for (k=0; k<2*stages[i].taps; k++)
+            stages[i].dline[k] = value;
+}
+
+
+
+/* run one polyphase resampling stage on input sample <x>;
+ * returns 1 and the output in <pOut> if the stage produced an item;
+ * the branch for phase p uses the coefficients h[k*L + p]
+ */
+static uint32_t  runStage (RateStage *pStage, int32_t x, int32_t *pOut)
+{
+    const int16_t  *ph;
+    const int32_t  *px;
+    int64_t         acc;
+    uint32_t        k, n, ret;
+
+    // insert newest sample at the front, x[n-k] = dline[dIndex+k]
+    if (pStage->dIndex == 0)
+        pStage->dIndex = pStage->taps;
+    pStage->dIndex--;
+    pStage->dline[pStage->dIndex]                = x;
+    pStage->dline[pStage->dIndex + pStage->taps] = x;
+
+    ret = 0;
+    if (pStage->phase < pStage->up)
+    {
+        ph  = &pStage->coef[pStage->phase];
+        px  = &pStage->dline[pStage->dIndex];
+        n   = pStage->taps / pStage->up;
+        acc = 0;
+        for (k=0; k<n; k++, ph += pStage->up)
+            acc += (int64_t) px[k] * *ph;
+
+        *pOut          = (int32_t) ((acc * pStage->up + Q15_ROUND) >> 15);
+        pStage->phase += pStage->down;
+        ret            = 1;
+    }
+    pStage->phase -= pStage->up;
+
+    return (ret);
+}
@@ -0,0 +1,52 @@
+#ifndef MULTIRATE_H
+  #define MULTIRATE_H
+
+/* multi-rate output streams;
+ * a polyphase decimation graph derives all output rates from the
+ * single sensor sample stream, every output has its own queue
+ */
+
+/* ---------------- definitions ----------------
+ */
+#define RATE_INPUT_HZ          150      // sensor sample rate
+#define RATE_SERIAL_HZ         20       // serial link, long-term monitoring
+#define RATE_BARO_HZ           1        // barometer channel (archive)
+
+#define RATE_OUT_FULL          0        // unfiltered input rate (storage, display)
+#define RATE_OUT_SERIAL        1
+#define RATE_OUT_BARO          2
+#define RATE_OUT_MID           3        // 50Hz, decimated storage
+#define RATE_NUM_OUTPUTS       4
+#define RATE_OUT_NONE          0xFF     // stage without a subscriber
+
+#define RATE_NUM_STAGES        4
+#define RATE_SRC_INPUT         0xFF     // stage is fed by the sensor input
+#define RATE_MAX_TAPS          40
+#define RATE_QUEUE_SIZE        32       // items per output queue, power of 2
+
+
+/* one resampling stage of the graph (L/M polyphase FIR, L <= M);
+ * the delay line is stored twice to keep the MAC loop linear
+ */
+typedef struct
+{
+    const int16_t  *coef;                    // Q15 prototype filter, DC gain 1.0
+    uint8_t         taps;                    // filter length, multiple of <up>
+    uint8_t         up;                      // interpolation factor L
+    uint8_t         down;                    // decimation factor M
+    uint8_t         src;                     // source stage, or RATE_SRC_INPUT
+    uint8_t         out;                     // output queue, or RATE_OUT_NONE
+    uint8_t         dIndex;                  // delay line write index
+    uint8_t         phase;                   // polyphase branch accumulator
+    int32_t         dline[2*RATE_MAX_TAPS];  // delay line (doubled)
+} RateStage;
+
+
+/* ------------ function prototypes ------------
+ */
+void      initRates     (void);
+void      rateInput     (uint16_t data);
+uint32_t  rateGet       (uint8_t output, uint16_t *pData);
+uint32_t  rateOverruns  (uint8_t output);
+
+#endif  //  MULTIRATE_H
@@ -0,0 +1,271 @@
+/* ---------------------------------------------------------------------------
+ * run-time performance counters;
+ * the idle share is the time the scheduler sleeps in WFI, the SysTick
+ * handler reports its duration and samples found still pending (lost),
+ * and the SD card layer the duration of every data write,
+ * into a log-linear histogram (4 bins per octave, < 19% error) from which
+ * p50 / p99 are read per 10s window; the report is drawn as a two line
+ * HUD through the dirty-diffed text path, and sent as a 'P' record:
+ *   P<idle %> <isr max us> <lost> <queue max> <queue ovr> <sd p50 us>
+ *    <sd p99 us> <sd max us> <tx backlog> <tx dropped>
+ * ---------------------------------------------------------------------------
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdio.h>
+#include <string.h>
+#include "stm32f4xx.h"
+#include "main.h"
+#include "stm32f4_discovery_lcd.h"
+#include "render.h"
+#include "perf.h"
+
+/* Private define ------------------------------------------------------------*/
+#define SUB_MASK               ((1UL << PERF_LAT_SUB_BITS) - 1)
+
+/* Private variables ---------------------------------------------------------*/
+extern uint16_t           serialActive;
+extern volatile uint16_t  txHead;
+extern volatile uint16_t  txTail;
+extern uint32_t           txDropped;
+
+static volatile uint32_t  isrMax   = 0;     // cycles
+static volatile uint32_t  lost     = 0;
+static uint64_t           idleSum  = 0;     // cycles
+static uint32_t           latHist[PERF_LAT_BINS];
+static uint32_t           latCount = 0;
+static uint32_t           latMax   = 0;     // us
+static uint32_t           reports  = 0;
+static uint32_t           period;           // report period, cycles
+static uint32_t           nextReport;
+static uint32_t           winStart;
+static uint8_t            hud      = PERF_HUD_DEFAULT;
+static PerfReport         last;
+static char               lineBuf[128];
+
+/* Private prototypes --------------------------------------------------------*/
+static uint32_t  latBin     (uint32_t us);
+static uint32_t  binUpper   (uint32_t bin);
+static uint32_t  percentile (uint32_t pct);
+static void      putReport  (void);
+
+
+/* Code  ---------------------------------------------------------------------*/
+
+void  initPerf (void)
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL        |= DWT_CTRL_CYCCNTENA_Msk;
+
+    memset (latHist, 0, sizeof (latHist));
+    memset (&last, 0, sizeof (last));
+    latCount   = latMax = 0;
+    idleSum    = 0;
+    isrMax     = 0;
+    reports    = 0;
+    period     = SystemCoreClock / PERF_HZ;
+    winStart   = DWT->CYCCNT;
+    nextReport = winStart + period;
+}
+
+
+
+/* duration of one SysTick handler run; interrupt context
+ */
+void  perfIsr (uint32_t cycles)
+{
+    if (cycles > isrMax)
+        isrMax = cycles;
+}
+
+
+
+/* a new sample found the sample FIFO full; interrupt context
+ */
+void  perfSampleLost (void)
+{
+    lost++;
+}
+
+
+
+/* time spent asleep, waiting for events
+ */
+void  perfIdle (uint32_t cycles)
+{
+    idleSum += cycles;
+}
+
+
+
+/* duration of one SD card data write (including syncs)
+ */
+void  perfSdWrite (uint32_t cycles)
+{
+    uint32_t  us;
+
+    us = cycles / (SystemCoreClock / 1000000);
+    latHist[latBin (us)]++;
+    latCount++;
+    if (us > latMax)
+        latMax = us;
+}
+
+
+
+/* compose a report when due; to be called from the main loop
+ */
+void  perfTask (void)
+{
+    uint32_t  now, elapsed, cpu, fill;
+
+    now = DWT->CYCCNT;
+    if ((int32_t) (now - nextReport) < 0)
+        return;
+
+    cpu     = SystemCoreClock / 1000000;
+    elapsed = now - winStart;
+    last.idlePermille = (uint16_t) ((idleSum * 1000) / (elapsed ? elapsed : 1));
+    last.isrMaxUs     = isrMax / cpu;
+    isrMax            = 0;
+    last.lost         = lost;
+    last.queueMax     = renderQueue (&last.queueOvr);
+    last.sdP50Us      = percentile (50);
+    last.sdP99Us      = percentile (99);
+    last.sdMaxUs      = latMax;
+    fill              = (txHead - txTail) & (TX_BUF_SIZE - 1);
+    last.txBacklog    = fill;
+    last.txDropped    = txDropped;
+
+    idleSum  = 0;
+    winStart = now;
+    period   = SystemCoreClock / PERF_HZ;   // the core clock may have changed
+    nextReport += period;
+    if ((int32_t) (now - nextReport) >= 0)
+        nextReport = now + period;          // fell behind, resync
+    if (++reports % PERF_LAT_WINDOW == 0)
+    {
+        memset (latHist, 0, sizeof (latHist));
+        latCount = latMax = 0;
+    }
+    putReport ();
+}
+
+
+
+/* the last report
+ */
+void  perfGet (PerfReport *pRep)
+{
+    *pRep = last;
+}
+
+
+
+/* show or remove the HUD
+ */
+void  perfSetHud (uint8_t on)
+{
+    uint16_t  text, back;
+
+    if (hud && !on)
+    {
+        LCD_GetColors (&text, &back);
+        LCD_SetColors (GFX_COLOR_TEXT, GFX_COLOR_BACKGOUND);
+        LCD_ClearLine (LINE(PERF_HUD_LINE));
+        LCD_ClearLine (LINE(PERF_HUD_LINE + 1));
+        LCD_SetColors (text, back);
+    }
+    hud = on;
+}
+
+
+
+uint8_t  perfGetHud (void)
+{
+    return (hud);
+}
+
+
+
+/* log-linear histogram bin of a latency: values below 2^SUB_BITS have a
+ * bin each, above, every octave is split into 2^SUB_BITS bins
+ */
+static uint32_t  latBin (uint32_t us)
+{
+    uint32_t  msb, bin;
+
+    if (us <= SUB_MASK)
+        return (us);
+    msb = 31 - __CLZ (us);
+    bin = ((msb - PERF_LAT_SUB_BITS + 1) << PERF_LAT_SUB_BITS) | ((us >> (msb - PERF_LAT_SUB_BITS)) & SUB_MASK);
+    return ((bin < PERF_LAT_BINS) ? bin : PERF_LAT_BINS - 1);
+}
+
+
+
+/* largest latency of a bin
+ */
+static uint32_t  binUpper (uint32_t bin)
+{
+    uint32_t  msb;
+
+    if (bin <= SUB_MASK)
+        return (bin);
+    msb = (bin >> PERF_LAT_SUB_BITS) + PERF_LAT_SUB_BITS - 1;
+    return ((((SUB_MASK + 1) | (bin & SUB_MASK)) << (msb - PERF_LAT_SUB_BITS)) + (1UL << (msb - PERF_LAT_SUB_BITS)) - 1);
+}
+
+
+
+/* latency percentile of the current window (bin upper bound), us
+ */
+static uint32_t  percentile (uint32_t pct)
+{
+    uint32_t  target, sum, b;
+
+    if (latCount == 0)
+        return (0);
+    target = (latCount * pct + 99) / 100;
+    for (b=0, sum=0; b<PERF_LAT_BINS; b++)
+    {
+        sum += latHist[b];
+        if (sum >= target)
+            return (binUpper (b));
+    }
+    return (latMax);
+}
+
+
+
+/* HUD lines, and the serial record
+ */
+static void  putReport (void)
+{
+    uint16_t  text, back;
+    int       sl;
+
+    if (hud)
+    {
+        LCD_GetColors (&text, &back);
+        LCD_SetColors (GFX_COLOR_TEXT, GFX_COLOR_BACKGOUND);
+        sprintf (lineBuf, "idle %3u.%u%% isr %3luus lost %lu  ", last.idlePermille / 10, last.idlePermille % 10,
+                 (unsigned long) last.isrMaxUs, (unsigned long) last.lost);
+        LCD_DisplayStringLineDiff (LINE(PERF_HUD_LINE), (uint8_t *) lineBuf);
+        sprintf (lineBuf, "q %3lu/%lu sd %lu/%luus tx %lu/%lu  ", (unsigned long) last.queueMax,
+                 (unsigned long) last.queueOvr, (unsigned long) last.sdP50Us, (unsigned long) last.sdP99Us,
+                 (unsigned long) last.txBacklog, (unsigned long) last.txDropped);
+        LCD_DisplayStringLineDiff (LINE(PERF_HUD_LINE + 1), (uint8_t *) lineBuf);
+        LCD_SetColors (text, back);
+    }
+
+    if (serialActive)
+    {
+        sl = sprintf (lineBuf, "P%u.%u %lu %lu %lu %lu %lu %lu %lu %lu %lu\n",
+                      last.idlePermille / 10, last.idlePermille % 10, (unsigned long) last.isrMaxUs,
+                      (unsigned long) last.lost, (unsigned long) last.queueMax, (unsigned long) last.queueOvr,
+                      (unsigned long) last.sdP50Us, (unsigned long) last.sdP99Us, (unsigned long) last.sdMaxUs,
+                      (unsigned long) last.txBacklog, (unsigned long) last.txDropped);
+        (void) serialWrite (lineBuf, sl);
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef PERF_H
+  #define PERF_H
+
+/* run-time performance counters;
+ * CPU idle share (scheduler sleep time), worst-case SysTick duration, lost
+ * samples, render queue fill, SD write latency percentiles and serial
+ * backlog; shown as a HUD on the display, and sent as 'P' records
+ */
+
+/* ---------------- definitions ----------------
+ */
+#define PERF_HZ                1        // report rate
+#define PERF_LAT_WINDOW        10       // reports per SD latency window (10s)
+#define PERF_LAT_SUB_BITS      2        // latency histogram: 4 bins per octave
+#define PERF_LAT_BINS          (24 << PERF_LAT_SUB_BITS)   // up to 2^24 us
+#define PERF_HUD_DEFAULT       1        // HUD shown at startup
+
+/* counters of one report interval
+ */
+typedef struct
+{
+    uint16_t  idlePermille;             // CPU idle share
+    uint32_t  isrMaxUs;                 // worst SysTick duration
+    uint32_t  lost;                     // samples lost (total)
+    uint32_t  queueMax;                 // render queue fill, max
+    uint32_t  queueOvr;                 // render queue overruns (total)
+    uint32_t  sdP50Us;                  // SD write latency, this window
+    uint32_t  sdP99Us;
+    uint32_t  sdMaxUs;
+    uint32_t  txBacklog;                // serial bytes pending
+    uint32_t  txDropped;                // serial bytes dropped (total)
+} PerfReport;
+
+
+/* ------------ function prototypes ------------
+ */
+void      initPerf       (void);
+void      perfIsr        (uint32_t cycles);
+void      perfSampleLost (void);
+void      perfIdle       (uint32_t cycles);
+void      perfSdWrite    (uint32_t cycles);
+void      perfTask       (void);
+void      perfGet        (PerfReport *pRep);
+void      perfSetHud     (uint8_t on);
+uint8_t   perfGetHud     (void);
+
+#endif  //  PERF_H
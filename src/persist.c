@@ -0,0 +1,215 @@
+/* ---------------------------------------------------------------------------
+ * persistent state;
+ * the working copy is in RAM; persistSave writes it to the copy in the
+ * backup SRAM not holding the latest state, the CRC last; at boot, the
+ * valid copy with the higher sequence number is restored; a copy is valid
+ * with its magic, a plausible size, and the CRC over its <size> bytes
+ * before the CRC word (CRC-32, word wise, by the CRC unit);
+ * sample counts are collected by the acquisition task, and folded into
+ * the record on the next save, the run time is counted by the tick;
+ * a reset loses at most PERSIST_SAVE_MS of both
+ * ---------------------------------------------------------------------------
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include "stm32f4xx.h"
+#include "main.h"
+#include "crash.h"
+#include "wdog.h"
+#include "persist.h"
+
+/* Private define ------------------------------------------------------------*/
+#define SLOT(i)                ((PersistState *) (BKPSRAM_BASE + PERSIST_BKP_OFFSET + (i) * PERSIST_SLOT_SIZE))
+#define SIZE                   (offsetof (PersistState, crc) + 4)
+#define MIN_SIZE               offsetof (PersistState, samples)
+#define BRE_TIMEOUT            10000    // backup regulator ready, polls
+
+/* Private variables ---------------------------------------------------------*/
+static PersistState        state;       // working copy
+static uint32_t            slot    = 0; // copy holding the latest state
+static uint32_t            tickMs  = 0; // since the last save
+static uint32_t            restMs  = 0; // below a second, for <uptimeS>
+static uint8_t             status  = PERSIST_STATUS_NEW;
+static volatile uint32_t   pending = 0; // samples, not yet in <state>
+
+/* Private prototypes --------------------------------------------------------*/
+static uint8_t   valid  (const PersistState *ps);
+static uint32_t  crc    (const void *pData, uint32_t size);
+
+
+/* Code  ---------------------------------------------------------------------*/
+
+/* restore the state, and count this boot, its reset cause and a new
+ * crash dump; requires initCrash (backup SRAM access) and initWdog
+ * (reset cause); returns PERSIST_STATUS_xxx
+ */
+uint8_t  initPersist (void)
+{
+    const CrashDump     *pd;
+    const PersistState  *ps;
+    uint32_t             i, n;
+
+    RCC->AHB1ENR |= RCC_AHB1ENR_CRCEN;
+    PWR->CSR     |= PWR_CSR_BRE;        // keep the backup SRAM on VBAT
+    for (i=0; (i < BRE_TIMEOUT) && !(PWR->CSR & PWR_CSR_BRR); i++)
+        ;
+
+    ps = NULL;
+    if (valid (SLOT(0)))
+        ps = SLOT(0);
+    if (valid (SLOT(1)) && ((ps == NULL) || ((int32_t) (SLOT(1)->seq - ps->seq) > 0)))
+        ps = SLOT(1);
+    slot = (ps == SLOT(1)) ? 1 : 0;
+
+    memset (&state, 0, sizeof (state));
+    status = PERSIST_STATUS_NEW;
+    if (ps != NULL)
+    {
+        n = (ps->size < SIZE) ? ps->size : SIZE;
+        memcpy (&state, ps, n - 4);     // the fields known to both versions
+        status = PERSIST_STATUS_OK;
+    }
+
+    state.boots++;
+    state.resets[wdogGet ()->cause]++;
+    pd = crashGet ();
+    if ((pd != NULL) && (pd->count != state.faultSeen))
+    {
+        state.faults++;                 // once, though reported later
+        state.faultSeen = pd->count;
+    }
+    persistSave ();
+    return (status);
+}
+
+
+
+/* <n> more samples taken; the acquisition task
+ */
+void  persistSamples (uint32_t n)
+{
+    pending += n;
+}
+
+
+
+/* <ms> of run time passed; saves once per PERSIST_SAVE_MS; to be called
+ * from one task only (housekeeping, or the low-rate loop)
+ */
+void  persistTick (uint32_t ms)
+{
+    restMs        += ms;
+    state.uptimeS += restMs / 1000;
+    restMs        %= 1000;
+    tickMs        += ms;
+    if (tickMs < PERSIST_SAVE_MS)
+        return;
+    tickMs = 0;
+    persistSave ();
+}
+
+
+
+/* the data file opened; the next file search starts after it
+ */
+void  persistSetFile (uint32_t fileID)
+{
+    state.fileID = fileID;
+    persistSave ();
+}
+
+
+
+/* a calibration completed; restored as calibration value at the
+ * next boot
+ */
+void  persistSetCal (uint16_t value)
+{
+    state.calValue   = value;
+    state.calUptimeS = state.uptimeS;
+    persistSave ();
+}
+
+
+
+/* write the working copy to the older copy in the backup SRAM; about
+ * 1us with the interrupts disabled, as tasks of any priority may save
+ */
+void  persistSave (void)
+{
+    PersistState  *ps;
+
+    __disable_irq ();
+    state.samples += pending;
+    pending        = 0;
+    state.magic    = PERSIST_MAGIC;
+    state.version  = PERSIST_VERSION;
+    state.size     = SIZE;
+    state.seq++;
+    state.crc      = crc (&state, SIZE - 4);
+
+    slot ^= 1;
+    ps    = SLOT(slot);
+    ps->magic = 0;                      // invalid while written
+    memcpy ((uint8_t *) ps + 4, (uint8_t *) &state + 4, SIZE - 4);
+    ps->magic = PERSIST_MAGIC;
+    __enable_irq ();
+}
+
+
+
+/* the working copy; as restored at boot, until updated
+ */
+const PersistState  *persistGet (void)
+{
+    return (&state);
+}
+
+
+
+/* format the 'U' record; returns its length
+ */
+int  persistLine (char *pBuf)
+{
+    return (sprintf (pBuf, "U%lu %s up %lu smpl %luk file %lu cal %lu @%lu rst %lu %lu %lu %lu %lu %lu flt %lu\n",
+                     (unsigned long) state.boots, (status == PERSIST_STATUS_OK) ? "ok" : "new",
+                     (unsigned long) state.uptimeS, (unsigned long) (state.samples / 1000),
+                     (unsigned long) state.fileID, (unsigned long) state.calValue,
+                     (unsigned long) state.calUptimeS,
+                     (unsigned long) state.resets[WDOG_CAUSE_POWER], (unsigned long) state.resets[WDOG_CAUSE_PIN],
+                     (unsigned long) state.resets[WDOG_CAUSE_SOFT], (unsigned long) state.resets[WDOG_CAUSE_IWDG],
+                     (unsigned long) state.resets[WDOG_CAUSE_WWDG], (unsigned long) state.resets[WDOG_CAUSE_LOWPOWER],
+                     (unsigned long) state.faults));
+}
+
+
+
+/* a copy with magic, plausible size, and matching CRC; the size is that
+ * of its writer, which may be an older or newer version
+ */
+static uint8_t  valid (const PersistState *ps)
+{
+    if (ps->magic != PERSIST_MAGIC)
+        return (0);
+    if ((ps->size < MIN_SIZE) || (ps->size > PERSIST_SLOT_SIZE) || (ps->size & 3))
+        return (0);
+    return (crc (ps, ps->size - 4) == *(const uint32_t *) ((const uint8_t *) ps + ps->size - 4));
+}
+
+
+
+/* CRC-32 (CRC unit, polynomial 0x04C11DB7) over <size> bytes, a multiple
+ * of 4
+ */
+static uint32_t  crc (const void *pData, uint32_t size)
+{
+    const uint32_t  *pw = pData;
+
+    CRC->CR = CRC_CR_RESET;
+    for (size /= 4; size; size--)
+        CRC->DR = *pw++;
+    return (CRC->DR);
+}
@@ -0,0 +1,65 @@
+#ifndef PERSIST_H
+  #define PERSIST_H
+
+/* persistent state;
+ * a small record in the backup SRAM with what should survive a reset:
+ * the last data file, the last calibration, and the run time, sample,
+ * reset and fault totals; restored at boot in a few microseconds,
+ * instead of probing the SD card and recalibrating; the record is kept
+ * twice, CRC protected (CRC unit), and written alternately, so a reset
+ * while saving leaves the older copy; fields are only ever appended, a
+ * record of another version is taken over as far as both know it;
+ * the Discovery board ties VBAT to VDD, so the state is lost without
+ * power unless a backup battery is fitted; sent as 'U' record:
+ *   U<boots> <ok|new> up <s> smpl <k> file <id> cal <value> @<s>
+ *     rst <power> <pin> <soft> <watchdog> <wwdg> <lowpower> flt <faults>
+ */
+
+#include "wdog.h"
+
+/* ---------------- definitions ----------------
+ */
+#define PERSIST_BKP_OFFSET     2304     // two copies in the backup SRAM, after the watchdog record
+#define PERSIST_SLOT_SIZE      128      // per copy; room for later fields
+#define PERSIST_MAGIC          0x50535431
+#define PERSIST_VERSION        1
+#define PERSIST_SAVE_MS        1000     // run time between saves
+#define PERSIST_LINE_SIZE      128      // persistLine buffer
+
+#define PERSIST_STATUS_NEW     0        // no valid copy, counting from zero
+#define PERSIST_STATUS_OK      1        // restored
+
+
+/* the record; word aligned, <crc> is its last word
+ */
+typedef struct
+{
+    uint32_t  magic;
+    uint16_t  version;                  // PERSIST_VERSION of the writer
+    uint16_t  size;                     // record size of the writer, bytes
+    uint32_t  seq;                      // saves; the newer copy wins
+    uint32_t  fileID;                   // last data file, 0 = none (always, while openDataFile is disabled)
+    uint32_t  calValue;                 // last calibration, 0 = none
+    uint32_t  calUptimeS;               // its time, in <uptimeS>
+    uint32_t  boots;
+    uint32_t  uptimeS;                  // run time, all boots
+    uint64_t  samples;                  // samples taken, all boots
+    uint32_t  faults;                   // crash dumps
+    uint32_t  faultSeen;                // count of the last dump taken into <faults>
+    uint32_t  resets[WDOG_CAUSES];      // per WDOG_CAUSE_xxx
+    uint32_t  crc;
+} PersistState;
+
+
+/* ------------ function prototypes ------------
+ */
+uint8_t              initPersist     (void);
+void                 persistSamples  (uint32_t n);
+void                 persistTick     (uint32_t ms);
+void                 persistSetFile  (uint32_t fileID);
+void                 persistSetCal   (uint16_t value);
+void                 persistSave     (void);
+const PersistState  *persistGet      (void);
+int                  persistLine     (char *pBuf);
+
+#endif  //  PERSIST_H
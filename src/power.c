@@ -0,0 +1,364 @@
+/* ---------------------------------------------------------------------------
+ * power management;
+ * powerSleep is entered by the scheduler with interrupts disabled and no
+ * event pending: WFI wakes on the next pending interrupt, which is taken
+ * once PRIMASK is cleared, and with SLEEPONEXIT set the core returns to
+ * sleep after every handler, until schedPost (powerWake) clears it;
+ * field mode divides HCLK by 4 (42MHz) with the APB buses at HCLK, so SPI2
+ * keeps its clock, and SysTick and the USART6 divider are adapted; the
+ * flash wait states stay as set for 168MHz;
+ * low-rate mode keeps the field mode clocks while awake; Stop mode leaves
+ * the core on the HSI after wakeup, and restoreClock repeats the part of
+ * SystemInit's clock setup that Stop undid (HSE on, PLL on, PLL as system
+ * clock); the PLL factors and bus prescalers are retained; SystemInit
+ * itself is not called, as it resets the prescalers and the vector table;
+ * 'W' records (totals since start, per mode):
+ *   W<mode> <HCLK MHz> <s in mode> <active permille> <est. mA x10>
+ * ---------------------------------------------------------------------------
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdio.h>
+#include <string.h>
+#include "stm32f4xx.h"
+#include "main.h"
+#include "power.h"
+
+/* Private define ------------------------------------------------------------*/
+#define SAMPLE_HZ              150      // SysTick rate
+
+/* Private variables ---------------------------------------------------------*/
+extern uint16_t           serialActive;
+
+static uint8_t            mode       = POWER_MODE_RUN;
+static PowerStats         stats[POWER_MODES];
+static uint32_t           modeStart;
+static uint32_t           nextReport;
+static uint32_t           stopPeriodUs = 0;
+static volatile uint8_t   wakeSource   = 0;
+static char               lineBuf[48];
+
+/* Private prototypes --------------------------------------------------------*/
+static void  closeMode    (void);
+static void  restoreClock (void);
+
+
+/* Code  ---------------------------------------------------------------------*/
+
+/* requires the DWT cycle counter (initPerf)
+ */
+void  initPower (void)
+{
+    memset (stats, 0, sizeof (stats));
+    stats[POWER_MODE_RUN].hclkMHz   = SystemCoreClock / 1000000;
+    stats[POWER_MODE_FIELD].hclkMHz = SystemCoreClock / 4000000;
+    stats[POWER_MODE_STOP].hclkMHz  = SystemCoreClock / 4000000;
+    mode       = POWER_MODE_RUN;
+    modeStart  = DWT->CYCCNT;
+    nextReport = modeStart + POWER_REPORT_S * SystemCoreClock;
+    SCB->SCR  &= ~(SCB_SCR_SLEEPDEEP_Msk | SCB_SCR_SLEEPONEXIT_Msk);
+}
+
+
+
+/* sleep until an event is posted; to be called with interrupts disabled,
+ * returns with interrupts enabled, and the cycles spent (including the
+ * handlers run meanwhile)
+ */
+uint32_t  powerSleep (void)
+{
+    uint32_t  t0, t;
+
+    t0 = DWT->CYCCNT;
+    SCB->SCR |= SCB_SCR_SLEEPONEXIT_Msk;
+    __DSB ();
+    __WFI ();
+    __enable_irq ();                    // handlers run here, and sleep on exit
+    SCB->SCR &= ~SCB_SCR_SLEEPONEXIT_Msk;
+    t = DWT->CYCCNT - t0;
+    stats[mode].sleep += t;
+    return (t);
+}
+
+
+
+/* return to thread mode after the current handler; interrupt context
+ */
+void  powerWake (void)
+{
+    SCB->SCR &= ~SCB_SCR_SLEEPONEXIT_Msk;
+}
+
+
+
+/* sleep until the SysTick counted <*pCount> down to 0
+ */
+void  powerWait (volatile uint32_t *pCount)
+{
+    __disable_irq ();
+    while (*pCount)
+    {
+        __WFI ();
+        __enable_irq ();
+        __disable_irq ();
+    }
+    __enable_irq ();
+}
+
+
+
+/* switch the core clock for a mode; a character in transmission is
+ * finished first, since the USART6 divider changes
+ */
+void  powerSetMode (uint8_t m)
+{
+    uint32_t  pclkOld, pclkNew;
+
+    if ((m == mode) || (m >= POWER_MODES))
+        return;
+    if ((m != POWER_MODE_RUN) && (mode != POWER_MODE_RUN))
+    {
+        closeMode ();                   // field and low-rate share the clocks
+        mode = m;
+        return;
+    }
+
+    __disable_irq ();
+    if (USART6->CR1 & USART_CR1_TE)
+        while (!(USART6->SR & USART_SR_TC));
+    closeMode ();
+    pclkOld = SystemCoreClock / ((mode == POWER_MODE_RUN) ? 2 : 1);
+
+    // the APB clocks must stay within limits (42 / 84MHz) at every step
+    if (m != POWER_MODE_RUN)
+    {
+        RCC_HCLKConfig (RCC_SYSCLK_Div4);
+        RCC_PCLK1Config (RCC_HCLK_Div1);
+        RCC_PCLK2Config (RCC_HCLK_Div1);
+    }
+    else
+    {
+        RCC_PCLK1Config (RCC_HCLK_Div4);
+        RCC_PCLK2Config (RCC_HCLK_Div2);
+        RCC_HCLKConfig (RCC_SYSCLK_Div1);
+    }
+    SystemCoreClockUpdate ();
+    mode    = m;
+    pclkNew = SystemCoreClock / ((mode == POWER_MODE_RUN) ? 2 : 1);
+
+    USART6->BRR   = (uint16_t) (((uint64_t) USART6->BRR * pclkNew + pclkOld / 2) / pclkOld);
+    SysTick->LOAD = SystemCoreClock / SAMPLE_HZ - 1;
+    SysTick->VAL  = 0;
+    __enable_irq ();
+}
+
+
+
+uint8_t  powerGetMode (void)
+{
+    return (mode);
+}
+
+
+
+/* set up the Stop mode wakeups: the RTC wakeup timer from the LSI
+ * (RTCCLK / 16) every 1 / <hz> s on EXTI line 22, and the user button
+ * (PA0) on EXTI line 0; the flash powers down during Stop
+ */
+void  initPowerStop (uint32_t hz)
+{
+    EXTI_InitTypeDef  EXTI_InitStructure;
+    NVIC_InitTypeDef  NVIC_InitStructure;
+    uint32_t          count;
+
+    RCC_APB1PeriphClockCmd (RCC_APB1Periph_PWR, ENABLE);
+    RCC_APB2PeriphClockCmd (RCC_APB2Periph_SYSCFG, ENABLE);
+    PWR_BackupAccessCmd (ENABLE);
+
+    RCC_LSICmd (ENABLE);
+    while (RCC_GetFlagStatus (RCC_FLAG_LSIRDY) == RESET);
+    RCC_RTCCLKConfig (RCC_RTCCLKSource_LSI);
+    RCC_RTCCLKCmd (ENABLE);
+    RTC_WaitForSynchro ();
+
+    count        = POWER_LSI_HZ / 16 / hz;
+    stopPeriodUs = 1000000 / hz;
+    RTC_WakeUpCmd (DISABLE);
+    RTC_WakeUpClockConfig (RTC_WakeUpClock_RTCCLK_Div16);
+    RTC_SetWakeUpCounter (count - 1);
+
+    EXTI_ClearITPendingBit (EXTI_Line22 | EXTI_Line0);
+    SYSCFG_EXTILineConfig (EXTI_PortSourceGPIOA, EXTI_PinSource0);
+    EXTI_InitStructure.EXTI_Line    = EXTI_Line22 | EXTI_Line0;
+    EXTI_InitStructure.EXTI_Mode    = EXTI_Mode_Interrupt;
+    EXTI_InitStructure.EXTI_Trigger = EXTI_Trigger_Rising;
+    EXTI_InitStructure.EXTI_LineCmd = ENABLE;
+    EXTI_Init (&EXTI_InitStructure);
+
+    NVIC_InitStructure.NVIC_IRQChannel                   = RTC_WKUP_IRQn;
+    NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 0x0F;
+    NVIC_InitStructure.NVIC_IRQChannelSubPriority        = 0;
+    NVIC_InitStructure.NVIC_IRQChannelCmd                = ENABLE;
+    NVIC_Init (&NVIC_InitStructure);
+    NVIC_InitStructure.NVIC_IRQChannel                   = EXTI0_IRQn;
+    NVIC_Init (&NVIC_InitStructure);
+
+    RTC_ClearITPendingBit (RTC_IT_WUT);
+    RTC_ITConfig (RTC_IT_WUT, ENABLE);
+    RTC_WakeUpCmd (ENABLE);
+    PWR_FlashPowerDownCmd (ENABLE);
+    wakeSource = 0;
+}
+
+
+
+/* enter Stop mode until the next wakeup; pending serial output is sent
+ * first (the USART stops with its clock); returns the wakeup source(s)
+ */
+uint8_t  powerStop (void)
+{
+    uint8_t  src;
+
+    while (USART6->CR1 & USART_CR1_TXEIE);          // ring buffer drained
+    if (USART6->CR1 & USART_CR1_TE)
+        while (!(USART6->SR & USART_SR_TC));
+
+    closeMode ();
+    do
+    {
+        PWR_EnterSTOPMode (PWR_Regulator_LowPower, PWR_STOPEntry_WFI);
+        restoreClock ();
+    }
+    while (wakeSource == 0);                        // another interrupt
+
+    __disable_irq ();
+    src        = wakeSource;
+    wakeSource = 0;
+    __enable_irq ();
+    if (src & POWER_WAKE_RTC)
+        stats[POWER_MODE_STOP].stopUs += stopPeriodUs;
+    modeStart = DWT->CYCCNT;                        // DWT halted meanwhile
+    return (src);
+}
+
+
+
+void  powerStopExit (void)
+{
+    NVIC_DisableIRQ (RTC_WKUP_IRQn);
+    NVIC_DisableIRQ (EXTI0_IRQn);
+    RTC_WakeUpCmd (DISABLE);
+    RTC_ITConfig (RTC_IT_WUT, DISABLE);
+    EXTI_ClearITPendingBit (EXTI_Line22 | EXTI_Line0);
+    PWR_FlashPowerDownCmd (DISABLE);
+}
+
+
+
+/* RTC wakeup timer; interrupt context (running on the HSI)
+ */
+void  powerRtcIRQ (void)
+{
+    if (RTC_GetITStatus (RTC_IT_WUT) != RESET)
+        RTC_ClearITPendingBit (RTC_IT_WUT);
+    EXTI_ClearITPendingBit (EXTI_Line22);
+    wakeSource |= POWER_WAKE_RTC;
+}
+
+
+
+/* user button; interrupt context
+ */
+void  powerButtonIRQ (void)
+{
+    EXTI_ClearITPendingBit (EXTI_Line0);
+    wakeSource |= POWER_WAKE_BUTTON;
+}
+
+
+
+/* estimated MCU current of a mode, from its shares of active, sleeping
+ * and stopped time; mA x10
+ */
+uint32_t  powerEstimate (uint8_t m)
+{
+    PowerStats  *ps;
+    uint64_t     awakeUs, totalUs, ua;
+
+    ps      = &stats[m];
+    awakeUs = ps->cycles / ps->hclkMHz;
+    totalUs = awakeUs + ps->stopUs;
+    if (totalUs == 0)
+        return (0);
+    ua = 0;
+    if (ps->cycles)
+        ua = ((ps->cycles - ps->sleep) * POWER_RUN_UA_MHZ + ps->sleep * POWER_SLEEP_UA_MHZ) / ps->cycles * ps->hclkMHz;
+    ua = (ua * awakeUs + POWER_STOP_UA * ps->stopUs) / totalUs;
+    return ((uint32_t) ((ua + POWER_BOARD_UA + 50) / 100));
+}
+
+
+
+/* send the 'W' records when due; to be called from a task
+ */
+void  powerReport (void)
+{
+    PowerStats  *ps;
+    uint64_t     awakeUs, totalUs;
+    uint32_t     now, m, secs, active;
+    int          sl;
+
+    now = DWT->CYCCNT;
+    if ((int32_t) (now - nextReport) < 0)
+        return;
+    nextReport = now + POWER_REPORT_S * SystemCoreClock;
+    closeMode ();
+
+    for (m=0; m<POWER_MODES; m++)
+    {
+        ps      = &stats[m];
+        awakeUs = ps->cycles / ps->hclkMHz;
+        totalUs = awakeUs + ps->stopUs;
+        if (totalUs == 0)
+            continue;
+        secs   = (uint32_t) (totalUs / 1000000);
+        active = (uint32_t) ((((ps->cycles - ps->sleep) / ps->hclkMHz) * 1000) / totalUs);
+        if (serialActive)
+        {
+            sl = sprintf (lineBuf, "W%lu %lu %lu %lu %lu\n", (unsigned long) m, (unsigned long) ps->hclkMHz,
+                          (unsigned long) secs, (unsigned long) active, (unsigned long) powerEstimate (m));
+            (void) serialWrite (lineBuf, sl);
+        }
+    }
+}
+
+
+
+/* add the time since the last mode switch or report to the current mode
+ */
+static void  closeMode (void)
+{
+    uint32_t  now;
+
+    now = DWT->CYCCNT;
+    stats[mode].cycles += now - modeStart;
+    modeStart = now;
+}
+
+
+
+/* back to the PLL after Stop mode; nothing to do if the core did not
+ * actually stop (an interrupt was pending)
+ */
+static void  restoreClock (void)
+{
+    if (RCC_GetSYSCLKSource () == 0x08)
+        return;
+
+    RCC_HSEConfig (RCC_HSE_ON);
+    while (RCC_WaitForHSEStartUp () != SUCCESS);
+    RCC_PLLCmd (ENABLE);
+    while (RCC_GetFlagStatus (RCC_FLAG_PLLRDY) == RESET);
+    RCC_SYSCLKConfig (RCC_SYSCLKSource_PLLCLK);
+    while (RCC_GetSYSCLKSource () != 0x08);
+}
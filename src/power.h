@@ -0,0 +1,63 @@
+#ifndef POWER_H
+  #define POWER_H
+
+/* power management;
+ * the scheduler idles in WFI with sleep-on-exit, so interrupts that post
+ * no event (UART, DMA) return straight to sleep; delays wait for the
+ * SysTick in WFI as well; in field mode (acquisition and storage only,
+ * display off) HCLK drops to SYSCLK / 4; in low-rate mode the core stays
+ * in Stop mode between samples, woken by the RTC wakeup timer (LSI) or
+ * the user button; the active, sleeping and stopped times of each mode
+ * give a current estimate, sent as 'W' records
+ */
+
+/* ---------------- definitions ----------------
+ */
+#define POWER_MODE_RUN         0        // 168MHz, display on
+#define POWER_MODE_FIELD       1        // 42MHz, display off
+#define POWER_MODE_STOP        2        // low-rate, Stop mode between samples
+#define POWER_MODES            3
+
+#define POWER_WAKE_RTC         0x01     // wakeup sources, Stop mode
+#define POWER_WAKE_BUTTON      0x02
+#define POWER_LSI_HZ           32000    // nominal; the LSI is off by up to +-50%
+
+#define POWER_REPORT_S         10       // 'W' record period
+
+// current estimate (MCU only), linear in HCLK; typical values from the
+// STM32F407 data sheet (flash with ART, all peripherals clocked, 25C)
+#define POWER_RUN_UA_MHZ       550      // run mode, ~93mA @ 168MHz
+#define POWER_SLEEP_UA_MHZ     350      // sleep mode, ~59mA @ 168MHz
+#define POWER_STOP_UA          320      // Stop mode, low-power regulator, flash
+                                        // in deep power-down
+#define POWER_BOARD_UA         0        // add the measured sensor, SD card and
+                                        // LCD module currents of the station
+
+/* accumulated cycles of one mode
+ */
+typedef struct
+{
+    uint32_t  hclkMHz;
+    uint64_t  cycles;                   // time in this mode
+    uint64_t  sleep;                    // thereof asleep
+    uint64_t  stopUs;                   // time in Stop mode (not in cycles)
+} PowerStats;
+
+
+/* ------------ function prototypes ------------
+ */
+void      initPower      (void);
+uint32_t  powerSleep     (void);
+void      powerWake      (void);
+void      powerWait      (volatile uint32_t *pCount);
+void      powerSetMode   (uint8_t mode);
+void      initPowerStop  (uint32_t hz);
+uint8_t   powerStop      (void);
+void      powerStopExit  (void);
+void      powerRtcIRQ    (void);
+void      powerButtonIRQ (void);
+uint8_t   powerGetMode   (void);
+uint32_t  powerEstimate  (uint8_t mode);
+void      powerReport    (void);
+
+#endif  //  POWER_H
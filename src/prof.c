@@ -0,0 +1,134 @@
+/* ---------------------------------------------------------------------------
+ * cycle-accurate zone profiling;
+ * profRecord adds one DWT cycle count to its zone: min / max / sum, and
+ * the log2 histogram bin (31 - CLZ); a zone is only written from one
+ * context, a dump read from the serial task may see an update half done;
+ * the dump is paced by the space in the serial ring buffer, two lines
+ * per zone:
+ *   Z<zone> <name> <count> <min> <max> <mean>      (cycles)
+ *   H<zone> <bin>:<count> ...                      (non-empty bins)
+ * ---------------------------------------------------------------------------
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdio.h>
+#include <string.h>
+#include "stm32f4xx.h"
+#include "main.h"
+#include "prof.h"
+
+#ifdef _PROFILE_
+
+/* Private define ------------------------------------------------------------*/
+#define DUMP_IDLE              0xFF
+
+/* Private variables ---------------------------------------------------------*/
+static ProfZone     zones[PROF_ZONES];
+static const char  *names[PROF_ZONES] = PROF_ZONE_NAMES;
+static uint8_t      dumpZone  = DUMP_IDLE;
+static uint8_t      dumpHist  = 0;      // histogram line of dumpZone next
+static uint8_t      dumpReset = 0;
+static char         lineBuf[160];
+
+/* Private prototypes --------------------------------------------------------*/
+static void  resetZone (uint32_t zone);
+
+
+/* Code  ---------------------------------------------------------------------*/
+
+/* requires the DWT cycle counter (initPerf)
+ */
+void  initProf (void)
+{
+    uint32_t  i;
+
+    for (i=0; i<PROF_ZONES; i++)
+        resetZone (i);
+    dumpZone = DUMP_IDLE;
+}
+
+
+
+void  profRecord (uint32_t zone, uint32_t cycles)
+{
+    ProfZone  *pz;
+
+    pz = &zones[zone];
+    pz->count++;
+    pz->sum += cycles;
+    if (cycles < pz->min)
+        pz->min = cycles;
+    if (cycles > pz->max)
+        pz->max = cycles;
+    pz->hist[31 - __CLZ (cycles | 1)]++;
+}
+
+
+
+void  profGet (uint32_t zone, ProfZone *pZone)
+{
+    *pZone = zones[zone];
+}
+
+
+
+/* start a dump of the table; <reset> clears every zone once it is sent
+ */
+void  profDump (uint8_t reset)
+{
+    dumpZone  = 0;
+    dumpHist  = 0;
+    dumpReset = reset;
+}
+
+
+
+/* send the next line of a running dump, if it fits into the serial
+ * buffer; to be called from the serial task
+ */
+void  profTask (void)
+{
+    ProfZone  *pz;
+    uint32_t   b;
+    int        sl;
+
+    while (dumpZone < PROF_ZONES)
+    {
+        pz = &zones[dumpZone];
+        if (!dumpHist)
+            sl = sprintf (lineBuf, "Z%u %s %lu %lu %lu %lu\n", dumpZone, names[dumpZone],
+                          (unsigned long) pz->count, (unsigned long) (pz->count ? pz->min : 0),
+                          (unsigned long) pz->max, (unsigned long) (pz->count ? pz->sum / pz->count : 0));
+        else
+        {
+            sl = sprintf (lineBuf, "H%u", dumpZone);
+            for (b=0; b<PROF_BINS; b++)
+                if (pz->hist[b] && (sl < (int) sizeof (lineBuf) - 16))
+                    sl += sprintf (&lineBuf[sl], " %lu:%lu", (unsigned long) b, (unsigned long) pz->hist[b]);
+            lineBuf[sl++] = '\n';
+        }
+
+        if (serialFree () < (uint32_t) sl)
+            return;                     // next run
+        (void) serialWrite (lineBuf, sl);
+
+        if (dumpHist)
+        {
+            if (dumpReset)
+                resetZone (dumpZone);
+            dumpZone++;
+        }
+        dumpHist = !dumpHist;
+    }
+    dumpZone = DUMP_IDLE;
+}
+
+
+
+static void  resetZone (uint32_t zone)
+{
+    memset (&zones[zone], 0, sizeof (ProfZone));
+    zones[zone].min = 0xFFFFFFFF;
+}
+
+#endif  //  _PROFILE_
@@ -0,0 +1,63 @@
+#ifndef PROF_H
+  #define PROF_H
+
+/* cycle-accurate zone profiling;
+ * PROF_ENTER / PROF_EXIT take the DWT cycle counter at the entry and exit
+ * of a named zone, in the same block; per zone, count, min / max / mean
+ * and a log2 histogram are kept in a static table, dumped over serial;
+ * without _PROFILE_, the macros compile to nothing
+ */
+
+#define _PROFILE_                       // comment out to compile the zones out
+
+/* ---------------- definitions ----------------
+ */
+#define PROF_BINS              32       // log2 histogram; bin b: [2^b, 2^(b+1)) cycles
+
+// zones; each one is entered from one context only
+#define PROF_ZONE_READ_SENSOR  0        // readPSensor, SysTick
+#define PROF_ZONE_PUT_DATA     1        // putDataItem
+#define PROF_ZONE_F_WRITE      2        // f_write of a data item
+#define PROF_ZONE_DISK_WRITE   3        // disk_write, SDIO
+#define PROF_ZONE_RENDER       4        // renderTask, frames drawn
+#define PROF_ZONES             5
+
+#define PROF_ZONE_NAMES        { "readPSensor", "putDataItem", "f_write", "disk_write", "render" }
+
+
+/* statistics of a zone
+ */
+typedef struct
+{
+    uint32_t  count;
+    uint32_t  min;
+    uint32_t  max;
+    uint64_t  sum;
+    uint32_t  hist[PROF_BINS];
+} ProfZone;
+
+
+#ifdef _PROFILE_
+  #define PROF_ENTER(zone)     uint32_t  profT0_##zone = DWT->CYCCNT
+  #define PROF_EXIT(zone)      profRecord ((zone), DWT->CYCCNT - profT0_##zone)
+#else
+  #define PROF_ENTER(zone)
+  #define PROF_EXIT(zone)
+#endif
+
+
+/* ------------ function prototypes ------------
+ */
+#ifdef _PROFILE_
+void      initProf      (void);
+void      profRecord    (uint32_t zone, uint32_t cycles);
+void      profGet       (uint32_t zone, ProfZone *pZone);
+void      profDump      (uint8_t reset);
+void      profTask      (void);
+#else
+  #define initProf()
+  #define profDump(reset)
+  #define profTask()
+#endif
+
+#endif  //  PROF_H
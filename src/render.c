@@ -0,0 +1,667 @@
+/* ---------------------------------------------------------------------------
+ * strip chart renderer, decoupled from the sample rate;
+ * the sample path only queues samples (renderInput), and the render task
+ * runs at a fixed frame rate: it aggregates all samples since the last
+ * frame into per-column min / max envelopes, and draws the changed columns
+ * in one batch; drawing yields to pending samples, the remaining columns
+ * are drawn with the next frame;
+ * the envelopes are kept as a min / max pyramid: level k holds one screen
+ * of columns of 2^k samples each, and every level is built from pairs of
+ * the level below; a sample costs two level updates on average, and a
+ * change of the time base (zoom) redraws the screen from the matching
+ * level, i.e. in O(columns), without any sample history;
+ * the Y axis is auto-ranged: once per second, a robust range (percentiles
+ * of the visible column minima and maxima) selects a 1-2-5 scale, zooming
+ * out at once but zooming in only after the range stayed small for a few
+ * seconds; any change is re-rendered from the pyramid as well;
+ * in scroll mode, the chart is rotated so that time runs along the gate
+ * lines of the panel: a column becomes one pixel row, written to the GRAM
+ * row after the newest one, and the vertical scroll register moves it to
+ * the bottom of the screen; a frame thus costs one row per new column and
+ * one register write, independent of the screen contents; as the whole
+ * panel scrolls, the text lines are held meanwhile;
+ * frame time, dropped frames and queue overruns are shown on the display
+ * ---------------------------------------------------------------------------
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "stm32f4xx.h"
+#include "main.h"
+#include "stm32f4_discovery_lcd.h"
+#include "multirate.h"
+#include "render.h"
+
+/* Private define ------------------------------------------------------------*/
+#define RING_MASK              (RENDER_RING_SIZE - 1)
+#define PLOT_X(col)            (X_AXIS_START + 1 + (col))
+
+/* Private variables ---------------------------------------------------------*/
+static uint16_t   ring[RENDER_RING_SIZE];
+static uint16_t   rHead       = 0;
+static uint16_t   rTail       = 0;
+static uint32_t   overruns    = 0;
+static uint16_t   queueMax    = 0;          // ring fill, max since last query
+
+static Envelope   pyr[RENDER_LEVELS][RENDER_COLUMNS];
+static uint16_t   pyrHead[RENDER_LEVELS];   // next entry (= column) per level
+static uint8_t    pyrFull[RENDER_LEVELS];   // level wrapped at least once
+static Envelope   pend[RENDER_LEVELS];      // first half of the next upper entry
+static uint8_t    pendSet[RENDER_LEVELS];
+static uint8_t    zoom        = RENDER_ZOOM_DEFAULT;
+static uint16_t   dirtyFrom   = 0;          // first column to be drawn
+static uint16_t   dirtyCount  = 0;
+static uint16_t   cursorCol   = 0xFFFF;
+static uint8_t    mode        = RENDER_MODE_SWEEP;
+static uint8_t    paused      = 0;
+static uint16_t   scrollRow   = 0;          // next GRAM row in scroll mode
+static uint16_t   scrollPend  = 0;          // columns not drawn yet
+static uint16_t   refValue    = 0;
+static uint8_t    refSet      = 0;
+static uint8_t    scaleIdx    = 4;
+static uint8_t    holdCount   = 0;
+static uint16_t   scratch[RENDER_COLUMNS];
+static char       rangeBuf[48];
+
+static const uint16_t  scales[] = { 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000 };
+#define NUM_SCALES             (sizeof (scales) / sizeof (scales[0]))
+#define PLOT_H                 (Y_AXIS_LOW - Y_AXIS_HIGH)
+
+static uint32_t   period;                   // frame period, cycles
+static uint32_t   nextFrame;
+static uint32_t   frames      = 0;
+static uint32_t   dropped     = 0;
+static uint32_t   frameCycles = 0;
+static uint32_t   frameMax    = 0;
+static char       statBuf[72];
+
+/* Private prototypes --------------------------------------------------------*/
+static void     pyrInput    (uint16_t data);
+static void     markDirty   (uint16_t col);
+static void     redrawAll   (void);
+static void     drawFrame   (void);
+static uint16_t  selectK    (uint16_t *p, uint32_t n, uint32_t k);
+static uint32_t  autoRange  (void);
+static void     putRange    (void);
+static int16_t  mapY        (uint16_t data);
+static int16_t  mapX        (uint16_t data);
+static void     drawColumn  (uint16_t col);
+static void     drawRow     (uint16_t col, uint16_t row);
+static void     drawCursor  (uint16_t col);
+static void     putStats    (void);
+
+
+/* Code  ---------------------------------------------------------------------*/
+
+/* reset the renderer, and draw the diagram frame;
+ * <ref> is the value drawn at the middle axis, 0 to use the first sample
+ */
+void  initRender (uint16_t ref)
+{
+    refValue   = ref;
+    refSet     = (ref != 0);
+    rHead      = rTail = 0;
+    memset (pyrHead, 0, sizeof (pyrHead));
+    memset (pyrFull, 0, sizeof (pyrFull));
+    memset (pendSet, 0, sizeof (pendSet));
+    dirtyFrom  = 0;
+    dirtyCount = 0;
+    cursorCol  = 0xFFFF;
+    mode       = RENDER_MODE_SWEEP;
+    paused     = 0;
+    scrollPend = 0;
+    frames     = dropped = frameMax = 0;
+    holdCount  = 0;
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL        |= DWT_CTRL_CYCCNTENA_Msk;
+    period    = SystemCoreClock / RENDER_FPS;
+    nextFrame = DWT->CYCCNT + period;
+
+    drawFrame ();
+    putRange ();
+    LCD_SetColors (GFX_COLOR_TEXT, GFX_COLOR_BACKGOUND);
+}
+
+
+
+/* queue one sample for display; never touches the LCD
+ */
+void  renderInput (uint16_t data)
+{
+    uint16_t  next;
+
+    next = (rHead + 1) & RING_MASK;
+    if (next == rTail)
+    {
+        overruns++;
+        return;
+    }
+    ring[rHead] = data;
+    rHead       = next;
+    if (((rHead - rTail) & RING_MASK) > queueMax)
+        queueMax = (rHead - rTail) & RING_MASK;
+}
+
+
+
+/* render a frame when it is due; to be called from the main loop;
+ * drawing stops early when <*pYield> gets set (pending sample);
+ * while paused, the samples only go to the pyramid;
+ * returns 1 if a frame was rendered
+ */
+uint32_t  renderTask (volatile uint32_t *pYield)
+{
+    uint32_t  now, late;
+    uint16_t  text, back;
+
+    if (paused)
+    {
+        while (rTail != rHead)
+        {
+            pyrInput (ring[rTail]);
+            rTail = (rTail + 1) & RING_MASK;
+        }
+        return (0);
+    }
+
+    now = DWT->CYCCNT;
+    if ((int32_t) (now - nextFrame) < 0)
+        return (0);
+
+    // frames missed completely count as dropped
+    late       = (now - nextFrame) / period;
+    dropped   += late;
+    nextFrame += (late + 1) * period;
+
+    while (rTail != rHead)
+    {
+        pyrInput (ring[rTail]);
+        rTail = (rTail + 1) & RING_MASK;
+    }
+
+    LCD_GetColors (&text, &back);
+    if (((frames % RENDER_STAT_FRAMES) == 0) && autoRange ())
+    {
+        redrawAll ();
+        putRange ();
+    }
+
+    if (mode == RENDER_MODE_SCROLL)
+    {
+        if (scrollPend && !*pYield)
+        {
+            while (scrollPend && !*pYield)
+            {
+                drawRow ((pyrHead[zoom] + RENDER_COLUMNS - scrollPend) % RENDER_COLUMNS, scrollRow);
+                scrollRow = (scrollRow + 1) % RENDER_SCROLL_ROWS;
+                scrollPend--;
+            }
+            LCD_SetScroll (scrollRow);      // newest row at the bottom
+        }
+    }
+    else
+    {
+        while (dirtyCount && !*pYield)
+        {
+            drawColumn (dirtyFrom);
+            dirtyFrom = (dirtyFrom + 1) % RENDER_COLUMNS;
+            dirtyCount--;
+        }
+        if ((dirtyCount == 0) && (cursorCol != pyrHead[zoom]))
+            drawCursor (pyrHead[zoom]);
+    }
+
+    frameCycles = DWT->CYCCNT - now;
+    if (frameCycles > frameMax)
+        frameMax = frameCycles;
+    if ((++frames % RENDER_STAT_FRAMES) == 0)
+        putStats ();
+    LCD_SetColors (text, back);
+    return (1);
+}
+
+
+
+/* set the time base, 2^<zoom> samples per column;
+ * the screen is redrawn from the matching pyramid level
+ */
+void  renderSetZoom (uint8_t z)
+{
+    if (z >= RENDER_LEVELS)
+        z = RENDER_LEVELS - 1;
+    zoom = z;
+    redrawAll ();
+    putRange ();
+}
+
+
+
+uint8_t  renderGetZoom (void)
+{
+    return (zoom);
+}
+
+
+
+/* stop drawing (display off), or resume with a full redraw; the frame
+ * period is taken anew, as the core clock may have changed meanwhile
+ */
+void  renderPause (uint8_t on)
+{
+    if (on == paused)
+        return;
+    paused = on;
+    if (!paused)
+    {
+        period    = SystemCoreClock / RENDER_FPS;
+        nextFrame = DWT->CYCCNT + period;
+        redrawAll ();
+    }
+}
+
+
+
+/* switch between the sweeping and the scrolling chart; the screen is
+ * cleared, and redrawn from the pyramid
+ */
+void  renderSetMode (uint8_t m)
+{
+    uint16_t  text, back;
+
+    if (m == mode)
+        return;
+    mode = m;
+
+    LCD_GetColors (&text, &back);
+    if (mode == RENDER_MODE_SCROLL)
+    {
+        LCD_TextHold (1);
+        LCD_DmaFill (0, 0, LCD_PIXEL_WIDTH, LCD_PIXEL_HEIGHT, GFX_COLOR_BACKGOUND);
+    }
+    else
+    {
+        LCD_SetScroll (0);
+        LCD_DmaFill (0, 0, LCD_PIXEL_WIDTH, LCD_PIXEL_HEIGHT, GFX_COLOR_BACKGOUND);
+        LCD_TextHold (0);
+        drawFrame ();
+    }
+    redrawAll ();
+    LCD_SetColors (text, back);
+}
+
+
+
+uint8_t  renderGetMode (void)
+{
+    return (mode);
+}
+
+
+
+/* max. queue fill since the last call, and the total of overruns
+ */
+uint32_t  renderQueue (uint32_t *pOverruns)
+{
+    uint32_t  fill;
+
+    fill      = queueMax;
+    queueMax  = 0;
+    *pOverruns = overruns;
+    return (fill);
+}
+
+
+
+/* current Y scale, LSB per division
+ */
+uint16_t  renderGetScale (void)
+{
+    return (scales[scaleIdx]);
+}
+
+
+
+/* add one sample to the pyramid; an entry is written at level 0, and
+ * every completed pair of a level is merged into the next one
+ */
+static void  pyrInput (uint16_t data)
+{
+    Envelope  e;
+    uint32_t  k;
+
+    if (!refSet)
+    {
+        refValue = data;
+        refSet   = 1;
+    }
+
+    e.min = e.max = data;
+    for (k=0; k<RENDER_LEVELS; k++)
+    {
+        pyr[k][pyrHead[k]] = e;
+        if (k == zoom)
+            markDirty (pyrHead[k]);
+        if (++pyrHead[k] >= RENDER_COLUMNS)
+        {
+            pyrHead[k] = 0;
+            pyrFull[k] = 1;
+        }
+
+        if (!pendSet[k])
+        {
+            pend[k]    = e;
+            pendSet[k] = 1;
+            return;
+        }
+        if (pend[k].min < e.min)
+            e.min = pend[k].min;
+        if (pend[k].max > e.max)
+            e.max = pend[k].max;
+        pendSet[k] = 0;
+    }
+}
+
+
+
+/* add a column to the range to be drawn
+ */
+static void  markDirty (uint16_t col)
+{
+    if (mode == RENDER_MODE_SCROLL)
+    {
+        if (scrollPend < RENDER_SCROLL_ROWS)
+            scrollPend++;
+        return;
+    }
+    if (dirtyCount == 0)
+        dirtyFrom = col;
+    if (dirtyCount < RENDER_COLUMNS)
+        dirtyCount++;
+    else
+        dirtyFrom = (dirtyFrom + 1) % RENDER_COLUMNS;
+}
+
+
+
+/* redraw all columns of the current level; in scroll mode, the screen
+ * restarts from the top with the columns that fit
+ */
+static void  redrawAll (void)
+{
+    uint16_t  n;
+
+    if (mode == RENDER_MODE_SCROLL)
+    {
+        n = pyrFull[zoom] ? RENDER_COLUMNS : pyrHead[zoom];
+        scrollPend = (n < RENDER_SCROLL_ROWS) ? n : RENDER_SCROLL_ROWS;
+        scrollRow  = 0;
+        LCD_DmaFill (0, 0, LCD_PIXEL_WIDTH, LCD_PIXEL_HEIGHT, GFX_COLOR_BACKGOUND);
+        LCD_SetScroll (0);
+        return;
+    }
+    dirtyFrom  = 0;
+    dirtyCount = RENDER_COLUMNS;
+    cursorCol  = 0xFFFF;
+}
+
+
+
+/* axes and division ticks of the sweeping chart
+ */
+static void  drawFrame (void)
+{
+    uint16_t  y;
+
+    LCD_SetColors (AXIS_COLOR, GFX_COLOR_BACKGOUND);
+    LCD_DrawLine (X_AXIS_START, Y_AXIS_MID, X_AXIS_END - X_AXIS_START, LCD_DIR_HORIZONTAL);
+    LCD_DrawLine (X_AXIS_START, Y_AXIS_HIGH, Y_AXIS_LOW - Y_AXIS_HIGH, LCD_DIR_VERTICAL);
+    for (y=Y_AXIS_MID % RENDER_DIV_PX; y<Y_AXIS_LOW; y+=RENDER_DIV_PX)
+        if (y >= Y_AXIS_HIGH)
+            LCD_DrawLine (X_AXIS_START - 3, y, 3, LCD_DIR_HORIZONTAL);
+}
+
+
+
+/* k-th smallest of <n> values (quickselect; reorders the array)
+ */
+static uint16_t  selectK (uint16_t *p, uint32_t n, uint32_t k)
+{
+    int32_t   lo, hi, i, j;
+    uint16_t  pivot, t;
+
+    lo = 0;
+    hi = n - 1;
+    while (lo < hi)
+    {
+        pivot = p[(lo + hi) >> 1];
+        i = lo;
+        j = hi;
+        while (i <= j)
+        {
+            while (p[i] < pivot)
+                i++;
+            while (p[j] > pivot)
+                j--;
+            if (i <= j)
+            {
+                t = p[i]; p[i] = p[j]; p[j] = t;
+                i++;
+                j--;
+            }
+        }
+        if ((int32_t) k <= j)
+            hi = j;
+        else if ((int32_t) k >= i)
+            lo = i;
+        else
+            break;
+    }
+    return (p[k]);
+}
+
+
+
+/* update scale and centre from the robust range of the visible columns;
+ * returns 1 if the mapping changed
+ */
+static uint32_t  autoRange (void)
+{
+    uint32_t  n, i, range, needOut, needIn, changed;
+    uint16_t  lo, hi, center;
+
+    n = pyrFull[zoom] ? RENDER_COLUMNS : pyrHead[zoom];
+    if (n < RENDER_AUTO_MIN)
+        return (0);
+
+    for (i=0; i<n; i++)
+        scratch[i] = pyr[zoom][i].min;
+    lo = selectK (scratch, n, (n * RENDER_PCT_LO) / 100);
+    for (i=0; i<n; i++)
+        scratch[i] = pyr[zoom][i].max;
+    hi = selectK (scratch, n, ((n - 1) * RENDER_PCT_HI) / 100);
+    if (hi < lo)
+        hi = lo;
+    range  = hi - lo + 1;
+    center = lo + ((hi - lo) >> 1);
+
+    // smallest scales the range fits in, with the zoom out / zoom in margins
+    for (needOut=0; (needOut < NUM_SCALES-1) &&
+         (range * RENDER_DIV_PX * 100 > (uint32_t) scales[needOut] * PLOT_H * RENDER_FIT_OUT); needOut++)
+        ;
+    for (needIn=0; (needIn < NUM_SCALES-1) &&
+         (range * RENDER_DIV_PX * 100 > (uint32_t) scales[needIn] * PLOT_H * RENDER_FIT_IN); needIn++)
+        ;
+
+    changed = 0;
+    if (needOut > scaleIdx)
+    {
+        scaleIdx  = needOut;
+        holdCount = 0;
+        changed   = 1;
+    }
+    else if (needIn < scaleIdx)
+    {
+        if (++holdCount >= RENDER_HOLD)
+        {
+            scaleIdx--;             // one step at a time
+            holdCount = 0;
+            changed   = 1;
+        }
+    }
+    else
+        holdCount = 0;
+
+    // recentre if the centre moved by more than one division
+    if ((uint32_t) abs ((int32_t) center - (int32_t) refValue) > scales[scaleIdx])
+    {
+        refValue = center;
+        changed  = 1;
+    }
+    return (changed);
+}
+
+
+
+/* display row of a value, clipped to the plot area
+ */
+static int16_t  mapY (uint16_t data)
+{
+    int32_t  y;
+
+    y = Y_AXIS_MID - (((int32_t) data - (int32_t) refValue) * RENDER_DIV_PX) / scales[scaleIdx];
+    if (y < Y_AXIS_HIGH)
+        y = Y_AXIS_HIGH;
+    else if (y > Y_AXIS_LOW - 1)
+        y = Y_AXIS_LOW - 1;
+    return ((int16_t) y);
+}
+
+
+
+/* display column of a value in scroll mode, clipped to the plot area
+ */
+static int16_t  mapX (uint16_t data)
+{
+    int32_t  x;
+
+    x = RENDER_SCROLL_X_MID + (((int32_t) data - (int32_t) refValue) * RENDER_DIV_PX) / scales[scaleIdx];
+    if (x < RENDER_SCROLL_X_LOW)
+        x = RENDER_SCROLL_X_LOW;
+    else if (x > RENDER_SCROLL_X_HIGH)
+        x = RENDER_SCROLL_X_HIGH;
+    return ((int16_t) x);
+}
+
+
+
+/* draw one column: background above, min..max span, background below;
+ * every pixel is written once, the middle axis is restored;
+ * columns without data yet are cleared
+ */
+static void  drawColumn (uint16_t col)
+{
+    int16_t  yTop, yBot;
+    uint16_t x;
+
+    x = PLOT_X(col);
+    if (!pyrFull[zoom] && (col >= pyrHead[zoom]))
+    {
+        LCD_SetColors (GFX_COLOR_BACKGOUND, GFX_COLOR_BACKGOUND);
+        LCD_DrawLine (x, Y_AXIS_HIGH, Y_AXIS_LOW - Y_AXIS_HIGH, LCD_DIR_VERTICAL);
+        LCD_SetColors (AXIS_COLOR, GFX_COLOR_BACKGOUND);
+        LCD_DrawLine (x, Y_AXIS_MID, 1, LCD_DIR_HORIZONTAL);
+        return;
+    }
+    yTop = mapY (pyr[zoom][col].max);
+    yBot = mapY (pyr[zoom][col].min);
+
+    LCD_SetColors (GFX_COLOR_BACKGOUND, GFX_COLOR_BACKGOUND);
+    if (yTop > Y_AXIS_HIGH)
+        LCD_DrawLine (x, Y_AXIS_HIGH, yTop - Y_AXIS_HIGH, LCD_DIR_VERTICAL);
+    if (yBot < Y_AXIS_LOW - 1)
+        LCD_DrawLine (x, yBot + 1, Y_AXIS_LOW - 1 - yBot, LCD_DIR_VERTICAL);
+
+    LCD_SetColors (DATA_COLOR, GFX_COLOR_BACKGOUND);
+    LCD_DrawLine (x, yTop, yBot - yTop + 1, LCD_DIR_VERTICAL);
+
+    if ((Y_AXIS_MID < yTop) || (Y_AXIS_MID > yBot))
+    {
+        LCD_SetColors (AXIS_COLOR, GFX_COLOR_BACKGOUND);
+        LCD_DrawLine (x, Y_AXIS_MID, 1, LCD_DIR_HORIZONTAL);
+    }
+}
+
+
+
+/* draw one column as GRAM row <row> in scroll mode: background left,
+ * min..max span, background right, and the middle axis pixel
+ */
+static void  drawRow (uint16_t col, uint16_t row)
+{
+    int16_t  xl, xr;
+
+    xl = mapX (pyr[zoom][col].min);
+    xr = mapX (pyr[zoom][col].max);
+
+    LCD_SetColors (GFX_COLOR_BACKGOUND, GFX_COLOR_BACKGOUND);
+    if (xl > RENDER_SCROLL_X_LOW)
+        LCD_DrawLine (RENDER_SCROLL_X_LOW, row, xl - RENDER_SCROLL_X_LOW, LCD_DIR_HORIZONTAL);
+    if (xr < RENDER_SCROLL_X_HIGH)
+        LCD_DrawLine (xr + 1, row, RENDER_SCROLL_X_HIGH - xr, LCD_DIR_HORIZONTAL);
+
+    LCD_SetColors (DATA_COLOR, GFX_COLOR_BACKGOUND);
+    LCD_DrawLine (xl, row, xr - xl + 1, LCD_DIR_HORIZONTAL);
+
+    if ((RENDER_SCROLL_X_MID < xl) || (RENDER_SCROLL_X_MID > xr))
+    {
+        LCD_SetColors (AXIS_COLOR, GFX_COLOR_BACKGOUND);
+        LCD_DrawLine (RENDER_SCROLL_X_MID, row, 1, LCD_DIR_HORIZONTAL);
+    }
+}
+
+
+
+/* cursor line at the next column to be filled;
+ * overpainted when that column is drawn
+ */
+static void  drawCursor (uint16_t col)
+{
+    LCD_SetColors (CURSOR_COLOR, GFX_COLOR_BACKGOUND);
+    LCD_DrawLine (PLOT_X(col), Y_AXIS_MID - GFX_CURSOR_SIZE, 2 * GFX_CURSOR_SIZE, LCD_DIR_VERTICAL);
+    cursorCol = col;
+}
+
+
+
+/* axis label line: Pa per division, and the time base
+ */
+static void  putRange (void)
+{
+    uint32_t  pa, secs;
+
+    pa   = (uint32_t) scales[scaleIdx] * RENDER_PA_X100;
+    secs = ((uint32_t) RENDER_COLUMNS << zoom) / RATE_INPUT_HZ;
+    sprintf (rangeBuf, "%lu.%02lu Pa/div  %lus/screen", (unsigned long) (pa / 100),
+             (unsigned long) (pa % 100), (unsigned long) secs);
+    LCD_SetColors (GFX_COLOR_TEXT, GFX_COLOR_BACKGOUND);
+    LCD_DisplayStringLineDiff (LINE(RANGE_LINE), (uint8_t *) rangeBuf);
+}
+
+
+
+/* performance line: last and max. frame time, dropped frames, overruns
+ */
+static void  putStats (void)
+{
+    uint32_t  cpu;
+
+    cpu = SystemCoreClock / 1000000;
+    snprintf (statBuf, sizeof (statBuf), "frm %4luus max %5luus drop %lu ovr %lu", (unsigned long) (frameCycles / cpu),
+              (unsigned long) (frameMax / cpu), (unsigned long) dropped, (unsigned long) overruns);
+    LCD_SetColors (GFX_COLOR_TEXT, GFX_COLOR_BACKGOUND);
+    LCD_DisplayStringLineDiff (LINE(PERF_LINE), (uint8_t *) statBuf);
+    frameMax = 0;
+}
@@ -0,0 +1,63 @@
+#ifndef RENDER_H
+  #define RENDER_H
+
+/* strip chart renderer;
+ * samples are only queued by the sample path, and rendered in batches at a
+ * fixed frame rate, as per-column min / max envelopes; a min / max pyramid
+ * provides the envelopes for all time bases (2^zoom samples per column);
+ * the chart either sweeps across the plot area, or scrolls the panel
+ */
+
+/* ---------------- definitions ----------------
+ */
+#define RENDER_FPS             20       // frame rate
+#define RENDER_RING_SIZE       256      // samples buffered between frames, power of 2
+#define RENDER_COLUMNS         GFX_CYCLE
+#define RENDER_LEVELS          14       // pyramid levels, zoom 0..13
+                                        // (1.9s .. 4.4h per screen @150Hz)
+#define RENDER_ZOOM_DEFAULT    2        // 4 samples per column (7.7s per screen)
+#define RENDER_STAT_FRAMES     RENDER_FPS   // frames per performance line update
+
+// auto-ranging Y axis
+#define RENDER_DIV_PX          25       // pixels per division
+#define RENDER_PCT_LO          5        // robust range: percentiles of the
+#define RENDER_PCT_HI          95       //   visible column minima / maxima
+#define RENDER_FIT_OUT         80       // zoom out if range exceeds % of the plot
+#define RENDER_FIT_IN          50       // zoom in if range fits in % of the plot,
+#define RENDER_HOLD            5        //   for this many range updates (s)
+#define RENDER_AUTO_MIN        16       // columns required for ranging
+#define RENDER_PA_X100         262      // Pa per LSB x100; approx., uncompensated
+                                        // 16 bit readout (osrs_p x1)
+
+// display modes
+#define RENDER_MODE_SWEEP      0        // wipe from left to right, with cursor
+#define RENDER_MODE_SCROLL     1        // time runs down, panel scrolled by hardware
+#define RENDER_SCROLL_ROWS     240      // panel gate lines (scrollable axis)
+#define RENDER_SCROLL_X_LOW    10       // amplitude axis in scroll mode
+#define RENDER_SCROLL_X_HIGH   309
+#define RENDER_SCROLL_X_MID    160
+
+
+/* min / max envelope of one column
+ */
+typedef struct
+{
+    uint16_t  min;
+    uint16_t  max;
+} Envelope;
+
+
+/* ------------ function prototypes ------------
+ */
+void      initRender     (uint16_t ref);
+void      renderInput    (uint16_t data);
+uint32_t  renderTask     (volatile uint32_t *pYield);
+void      renderSetZoom  (uint8_t zoom);
+uint8_t   renderGetZoom  (void);
+uint16_t  renderGetScale (void);
+void      renderSetMode  (uint8_t mode);
+void      renderPause    (uint8_t on);
+uint8_t   renderGetMode  (void);
+uint32_t  renderQueue    (uint32_t *pOverruns);
+
+#endif  //  RENDER_H
@@ -0,0 +1,242 @@
+/* ---------------------------------------------------------------------------
+ * cooperative run-to-completion scheduler;
+ * interrupt handlers post event flags (one per task) with an exclusive
+ * access loop, the scheduler picks the lowest set bit (highest priority),
+ * clears it and runs the task to completion; while a task runs, posting a
+ * higher priority event raises schedPreempt, which long tasks poll to return
+ * early; with nothing pending, the core sleeps in powerSleep (entered with
+ * PRIMASK set, so a post between the check and the sleep still wakes it);
+ * every completed run checks the task in with the watchdog supervisor;
+ * per task, the runs, busy time, longest run, longest start latency and
+ * deadline misses are collected, and sent as 'K' records:
+ *   K<task> <name> <runs> <busy permille> <max run us> <max latency us> <misses>
+ * ---------------------------------------------------------------------------
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdio.h>
+#include <string.h>
+#include "stm32f4xx.h"
+#include "main.h"
+#include "perf.h"
+#include "power.h"
+#include "sched.h"
+#include "trace.h"
+#include "wdog.h"
+
+/* Private define ------------------------------------------------------------*/
+
+/* Private variables ---------------------------------------------------------*/
+extern uint16_t            serialActive;
+
+volatile uint32_t          schedPreempt = 0;
+
+static volatile uint32_t   events       = 0;
+static volatile uint32_t   preemptMask  = 0;    // events above the running task
+static volatile uint32_t   postTime[SCHED_MAX_TASKS];
+static uint16_t            countdown[SCHED_MAX_TASKS];
+static const SchedTask    *tasks        = NULL;
+static uint32_t            nTasks       = 0;
+static SchedStats          stats[SCHED_MAX_TASKS];
+static uint32_t            winStart;
+static uint32_t            nextReport;
+static char                lineBuf[64];
+
+/* Private prototypes --------------------------------------------------------*/
+static void  clearEvent (uint32_t ev);
+
+
+/* Code  ---------------------------------------------------------------------*/
+
+/* install the task table (priority order, at most SCHED_MAX_TASKS);
+ * requires the DWT cycle counter (initPerf)
+ */
+void  initSched (const SchedTask *pTasks, uint32_t n)
+{
+    uint32_t  i;
+
+    if (n > SCHED_MAX_TASKS)
+        n = SCHED_MAX_TASKS;
+
+    memset (stats, 0, sizeof (stats));
+    for (i=0; i<n; i++)
+    {
+        countdown[i] = pTasks[i].periodTicks;
+        wdogRegister (i, pTasks[i].name, pTasks[i].aliveMs);
+    }
+    winStart   = DWT->CYCCNT;
+    nextReport = winStart + SCHED_REPORT_S * SystemCoreClock;
+    tasks      = pTasks;
+    nTasks     = n;                     // the SysTick starts posting here
+}
+
+
+
+/* post events (SCHED_EV bits); interrupt or task context
+ */
+void  schedPost (uint32_t ev)
+{
+    uint32_t  old, now, i, fresh;
+
+    now = DWT->CYCCNT;
+    do
+    {
+        old = __LDREXW (&events);
+    }
+    while (__STREXW (old | ev, &events));
+
+    // start of the latency is the first post of a pending event
+    fresh = ev & ~old;
+    for (i=0; fresh; i++, fresh >>= 1)
+        if (fresh & 1)
+            postTime[i] = now;
+
+    if (ev & preemptMask)
+        schedPreempt = 1;
+    powerWake ();
+}
+
+
+
+/* events still pending
+ */
+uint32_t  schedPending (uint32_t ev)
+{
+    return (events & ev);
+}
+
+
+
+/* periodic posts; called from the SysTick handler
+ */
+void  schedTick (void)
+{
+    uint32_t  i, ev;
+
+    for (i=0, ev=0; i<nTasks; i++)
+    {
+        if (tasks[i].periodTicks == 0)
+            continue;
+        if (--countdown[i] == 0)
+        {
+            countdown[i] = tasks[i].periodTicks;
+            ev |= SCHED_EV(i);
+        }
+    }
+    if (ev)
+        schedPost (ev);
+}
+
+
+
+/* the main loop; never returns
+ */
+void  schedRun (void)
+{
+    uint32_t    pend, i, bit, posted, t0, t1, dl;
+    SchedStats *ps;
+
+    while (1)
+    {
+        __disable_irq ();
+        pend = events;
+        if (pend == 0)
+        {
+            perfIdle (powerSleep ());   // returns with interrupts enabled
+            continue;
+        }
+        __enable_irq ();
+
+        i      = __CLZ (__RBIT (pend)); // highest priority first
+        bit    = SCHED_EV(i);
+        posted = postTime[i];           // stable while the bit is set
+        clearEvent (bit);
+
+        preemptMask  = bit - 1;
+        schedPreempt = (events & preemptMask) ? 1 : 0;
+        TRACE (TRACE_TASK_BEGIN, i);
+        t0 = DWT->CYCCNT;
+        tasks[i].pFunc ();
+        t1 = DWT->CYCCNT;
+        TRACE (TRACE_TASK_END, i);
+        wdogCheckin (i);
+        preemptMask  = 0;
+        schedPreempt = 0;
+
+        ps = &stats[i];
+        ps->runs++;
+        ps->busyCycles += t1 - t0;
+        if (t1 - t0 > ps->maxCycles)
+            ps->maxCycles = t1 - t0;
+        if (t0 - posted > ps->maxLatency)
+            ps->maxLatency = t0 - posted;
+        dl = tasks[i].deadlineUs * (SystemCoreClock / 1000000);   // clock may change
+        if (dl && (t1 - posted > dl))
+        {
+            ps->misses++;
+            traceTrigger (TRACE_WHY_DEADLINE);
+        }
+    }
+}
+
+
+
+void  schedGetStats (uint32_t task, SchedStats *pStats)
+{
+    if (task < nTasks)
+        *pStats = stats[task];
+    else
+        memset (pStats, 0, sizeof (SchedStats));
+}
+
+
+
+/* send the statistics window as 'K' records when due, and start a new one;
+ * to be called from a task
+ */
+void  schedReport (void)
+{
+    uint32_t    now, elapsed, cpu, i;
+    SchedStats *ps;
+    int         sl;
+
+    now = DWT->CYCCNT;
+    if ((int32_t) (now - nextReport) < 0)
+        return;
+
+    cpu     = SystemCoreClock / 1000000;
+    elapsed = (now - winStart) / 1000;
+    for (i=0; i<nTasks; i++)
+    {
+        ps = &stats[i];
+        if (serialActive)
+        {
+            sl = sprintf (lineBuf, "K%lu %s %lu %lu %lu %lu %lu\n", (unsigned long) i, tasks[i].name,
+                          (unsigned long) ps->runs, (unsigned long) (ps->busyCycles / (elapsed ? elapsed : 1)),
+                          (unsigned long) (ps->maxCycles / cpu), (unsigned long) (ps->maxLatency / cpu),
+                          (unsigned long) ps->misses);
+            (void) serialWrite (lineBuf, sl);
+        }
+        ps->runs = ps->busyCycles = ps->maxCycles = ps->maxLatency = 0;
+    }
+
+    winStart    = now;
+    nextReport += SCHED_REPORT_S * SystemCoreClock;
+    if ((int32_t) (now - nextReport) >= 0)
+        nextReport = now + SCHED_REPORT_S * SystemCoreClock;
+}
+
+
+
+/* clear an event, against concurrent posts
+ */
+static void  clearEvent (uint32_t ev)
+{
+    uint32_t  old;
+
+    do
+    {
+        old = __LDREXW (&events);
+    }
+    while (__STREXW (old & ~ev, &events));
+}
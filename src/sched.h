@@ -0,0 +1,70 @@
+#ifndef SCHED_H
+  #define SCHED_H
+
+/* cooperative run-to-completion scheduler;
+ * every task owns one event flag, posted from interrupt handlers or other
+ * tasks, or periodically from the SysTick; pending tasks run in priority
+ * order (table index, 0 = highest), one at a time and to completion; a long
+ * task polls schedPreempt to give way to a higher priority event at its own
+ * boundaries; the CPU sleeps in WFI while nothing is pending
+ */
+
+/* ---------------- definitions ----------------
+ */
+#define SCHED_MAX_TASKS        8
+#define SCHED_TICK_US          6667     // SysTick period (150Hz)
+#define SCHED_REPORT_S         10       // statistics window / 'K' record period
+
+// task table of the application, in priority order
+#define SCHED_TASK_ACQ         0        // sample drain, tone monitor, rate streams
+#define SCHED_TASK_STORE       1        // data file, summaries
+#define SCHED_TASK_RENDER      2        // strip chart frames
+#define SCHED_TASK_SERIAL      3        // decimated serial stream
+#define SCHED_TASK_HOUSE       4        // button, performance reports
+#define SCHED_TASK_BOOT        5        // boot steps, after the sampling started
+#define SCHED_TASKS            6
+
+#define SCHED_EV(task)         (1UL << (task))
+
+
+/* a task; <periodTicks> != 0 posts it from the SysTick every that many ticks,
+ * <deadlineUs> is the allowed time from posting to completion, <aliveMs>
+ * the longest time between two completions before the watchdog resets
+ */
+typedef struct
+{
+    const char  *name;
+    void        (*pFunc) (void);
+    uint16_t     periodTicks;
+    uint32_t     deadlineUs;
+    uint32_t     aliveMs;
+} SchedTask;
+
+
+/* run-time statistics of a task; the misses are counted since start,
+ * the rest per report window
+ */
+typedef struct
+{
+    uint32_t  runs;
+    uint32_t  busyCycles;
+    uint32_t  maxCycles;                // longest run
+    uint32_t  maxLatency;               // longest post to start, cycles
+    uint32_t  misses;                   // deadline misses (total)
+} SchedStats;
+
+
+extern volatile uint32_t  schedPreempt; // set while a higher priority event waits
+
+
+/* ------------ function prototypes ------------
+ */
+void      initSched     (const SchedTask *pTasks, uint32_t n);
+void      schedPost     (uint32_t events);
+uint32_t  schedPending  (uint32_t events);
+void      schedTick     (void);
+void      schedRun      (void);
+void      schedGetStats (uint32_t task, SchedStats *pStats);
+void      schedReport   (void);
+
+#endif  //  SCHED_H
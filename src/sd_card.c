@@ -4,6 +4,12 @@
 #include "stm32f4xx.h"
 #include "main.h"
 #include "sd_card.h"
+#include "multirate.h"
+#include "perf.h"
+#include "prof.h"
+#include "crash.h"
+#include "wdog.h"
+#include "persist.h"
 #include "stm32f4_discovery.h"
 
 
@@ -12,12 +18,47 @@ extern FATFS         fatfs;
 extern int32_t       fileState;
 extern uint32_t      FileID;
 extern FIL           file;
+extern FIL           sumFile;
+extern Config        cfg;
 
 /* **************************************************************
  * ******************** SD card related code ********************
  */
 
 static char   tBuffer[80] = {0};  // string buffer for some file operations
+static char   bBuffer[LOWRATE_BLOCK * WR_LSIZE];   // data block, low-rate mode
+
+#define DATA_FORMAT  ((cfg.format == CFG_FORMAT_HEX) ? "%hX\n" : "%hu\n")
+
+/* read the run-time configuration from the SD card; the file is parsed
+ * in small chunks as read, without a buffer of the file size; without a
+ * card or file, the configuration keeps its defaults;
+ * return value is that of the called f_mount() / f_open() function
+ */
+uint32_t  readConfigFile (Config *pCfg)
+{
+    CfgParser  cp;
+    FIL        F1;
+    char       cbuf[CFG_CHUNK_SIZE];
+    uint32_t   ret;
+    UINT       n;
+
+    ret = f_mount (0, &fatfs);
+    if (ret == FR_OK)
+        ret = f_open (&F1, CFG_FILENAME, FA_READ);
+    if (ret != FR_OK)
+        return (ret);
+
+    configBegin (&cp, pCfg);
+    while ((f_read (&F1, cbuf, sizeof (cbuf), &n) == FR_OK) && (n > 0))
+        configFeed (&cp, cbuf, n);
+    (void) configEnd (&cp);
+    (void) f_close (&F1);
+    return (FR_OK);
+}
+
+
+
 
 /* open the SD card file for writing the sample data;
  * use a fixed file name base with a running 2-digit number;
@@ -35,9 +76,17 @@ uint32_t   openDataFile (void)
         if (f_mount (0, &fatfs) != FR_OK)
             fileState = -1;
         fileState = 1;
-        FileID = getNextFileID ();
-        i      = openOutputFile (FileID, &file);
-        putHeader (&file);
+        FileID = wdogResumeFile ();     // after a watchdog reset, append
+        if ((FileID != 0) && (appendFile (FileID, DATA_FILENAME_EXT, &file) == FR_OK))
+            (void) appendFile (FileID, SUMMARY_FILENAME_EXT, &sumFile);
+        else
+        {
+            FileID = getNextFileID ();
+            i      = openOutputFile (FileID, &file);
+            putHeader (&file);
+            (void) openSummaryFile (FileID, &sumFile);
+        }
+        persistSetFile (FileID);
     }
 
     if (fileState == -1)
@@ -53,6 +102,8 @@ uint32_t   openDataFile (void)
 
 
 /* find the next name that does not yet exist as file on the SD card;
+ * the search starts after the last file used (in the persistent state),
+ * so a reboot usually needs a single probe instead of up to 100;
  * if all file names are used, '1' is returned (i.e. older files are overwritten)
  */
 uint32_t  getNextFileID (void)
@@ -60,11 +111,13 @@ uint32_t  getNextFileID (void)
     uint32_t  curID, found, r;
     FIL       F1;
 
-    curID = 1;
+    curID = persistGet ()->fileID + 1;
+    if (curID > MAX_FILE_ID_NUM)
+        curID = 1;
     found = 0;
     while (!found)
     {
-        sprintf (tBuffer, "%s%02d%s", DATA_FILENAME_BASE, (int) curID, DATA_FILENAME_EXT);
+        sprintf (tBuffer, "%s%02d%s", cfg.name, (int) curID, DATA_FILENAME_EXT);
         r = f_open (&F1, tBuffer, FA_READ);
         /* if already exists, close and try next */
         if (r == FR_OK)
@@ -93,22 +146,66 @@ uint32_t  getNextFileID (void)
  */
 uint32_t  openOutputFile (uint32_t curID, FIL *pFile)
 {
-    sprintf (tBuffer, "%s%02d%s", DATA_FILENAME_BASE, (int) curID, DATA_FILENAME_EXT);
+    sprintf (tBuffer, "%s%02d%s", cfg.name, (int) curID, DATA_FILENAME_EXT);
     return (f_open (pFile, (const char *) tBuffer, FA_WRITE));
 }
 
 
 
-/* write header information to the output (SD card file);
- * parameter is the current sensitivity value;
+/* open the summary file that accompanies the output file,
+ * with the same ID number, and write its header lines: the start
+ * reference (boot count and total run time from the persistent state;
+ * there is no calendar clock) and the column names;
+ * return value is that of the called f_open() function
+ */
+uint32_t  openSummaryFile (uint32_t curID, FIL *pFile)
+{
+    uint32_t  bCnt, ret;
+
+    sprintf (tBuffer, "%s%02d%s", cfg.name, (int) curID, SUMMARY_FILENAME_EXT);
+    ret = f_open (pFile, (const char *) tBuffer, FA_WRITE | FA_CREATE_ALWAYS);
+    if (ret != FR_OK)
+        return (ret);
+
+    sprintf (tBuffer, "# start boot %lu up %lu\n#level start[s] n min max mean rms\n",
+             (unsigned long) persistGet ()->boots, (unsigned long) persistGet ()->uptimeS);
+    ret = f_write (pFile, tBuffer, strlen(tBuffer), (UINT *) &bCnt);
+    return (ret);
+}
+
+
+
+/* reopen an existing output file (data or summary, by its extension),
+ * to continue it at its end; used after a watchdog reset;
+ * return value is that of the called f_open() / f_lseek() function
+ */
+uint32_t  appendFile (uint32_t curID, const char *pExt, FIL *pFile)
+{
+    uint32_t  ret;
+
+    sprintf (tBuffer, "%s%02d%s", cfg.name, (int) curID, pExt);
+    ret = f_open (pFile, (const char *) tBuffer, FA_WRITE | FA_OPEN_EXISTING);
+    if (ret != FR_OK)
+        return (ret);
+    return (f_lseek (pFile, f_size (pFile)));
+}
+
+
+
+/* write header information to the output (SD card file), followed
+ * by the effective configuration, as comment lines;
  * return value is a success/error message from the file system
  */
 uint32_t  putHeader (FIL *pFile)
 {
-    uint32_t  bCnt, ret = 0;
+    uint32_t  bCnt, i, ret = 0;
+    int       sl;
 
-    sprintf (tBuffer, "#! -Air Pressure / Infrasound Logger V%d.%d (c)fm ---\n# @150\n", SW_VERSION_MAJOR, SW_VERSION_MINOR);
+    sprintf (tBuffer, "#! -Air Pressure / Infrasound Logger V%d.%d (c)fm ---\n# @%d B@%d\n",
+             SW_VERSION_MAJOR, SW_VERSION_MINOR, RATE_INPUT_HZ / cfg.decimation, RATE_BARO_HZ);
     ret  = f_write (pFile, tBuffer, strlen(tBuffer), (UINT *) &bCnt);
+    for (i=0; (ret == 0) && ((sl = configFormat (&cfg, i, tBuffer)) > 0); i++)
+        ret = f_write (pFile, tBuffer, sl, (UINT *) &bCnt);
     if (ret == 0)
         f_sync (pFile);
 
@@ -125,22 +222,168 @@ uint32_t  putHeader (FIL *pFile)
 
 uint32_t  putDataItem (uint16_t data, FIL *pFile)
 {
-    uint32_t         ret, bCnt = 0;
+    uint32_t         ret, bCnt = 0, t0;
     char             lbuf[16];
     static uint16_t  wcount = 0;
 
-    sprintf (lbuf,"%hX\n", data);
+    sprintf (lbuf, DATA_FORMAT, data);
+    t0  = DWT->CYCCNT;
+    PROF_ENTER (PROF_ZONE_F_WRITE);
     ret = f_write (pFile, lbuf, strlen(lbuf), (UINT *) &bCnt);
+    PROF_EXIT (PROF_ZONE_F_WRITE);
     if (ret != 0)
         return (ret);
 
     // do a file sync once in a while ...
     wcount++;
-    if (wcount >= FSYNC_SIZE)
+    if (wcount >= cfg.fsync)
     {
         f_sync (pFile);
         wcount = 0;
     }
+    perfSdWrite (DWT->CYCCNT - t0);
     return 0;
 }
 
+
+
+/* write a block of data items with one file write, and sync;
+ * used in low-rate mode, where the card is only woken per block
+ */
+uint32_t  putDataBlock (const uint16_t *pData, uint32_t n, FIL *pFile)
+{
+    uint32_t  ret, bCnt = 0, t0, i, len;
+
+    for (i=0, len=0; (i < n) && (i < LOWRATE_BLOCK); i++)
+        len += sprintf (&bBuffer[len], DATA_FORMAT, pData[i]);
+
+    t0  = DWT->CYCCNT;
+    ret = f_write (pFile, bBuffer, len, (UINT *) &bCnt);
+    if (ret == 0)
+        ret = f_sync (pFile);
+    perfSdWrite (DWT->CYCCNT - t0);
+    return (ret);
+}
+
+
+
+/* mark a change of the sample rate in the data stream, in the form
+ * of the header line
+ */
+uint32_t  putRateMark (uint16_t hz, FIL *pFile)
+{
+    uint32_t  bCnt = 0;
+    char      lbuf[16];
+
+    sprintf (lbuf,"# @%u\n", hz);
+    return (f_write (pFile, lbuf, strlen(lbuf), (UINT *) &bCnt));
+}
+
+
+
+/* mark a watchdog reset in the data stream; the samples between the
+ * last sync and the reset, and while rebooting, are missing here
+ */
+uint32_t  putResetMark (const char *pWhy, FIL *pFile)
+{
+    uint32_t  bCnt = 0, ret;
+    char      lbuf[32];
+
+    snprintf (lbuf, sizeof (lbuf), "# reset %s\n", pWhy);
+    ret = f_write (pFile, lbuf, strlen(lbuf), (UINT *) &bCnt);
+    if (ret == 0)
+        ret = f_sync (pFile);
+    return (ret);
+}
+
+
+
+/* write a barometer channel item to the output (SD card file);
+ * the low-rate items are interleaved with the sample data as comment
+ * lines "# B <value>", like the rate marks; a bare letter tag would be
+ * a hex digit, and read as a sample
+ */
+uint32_t  putBaroItem (uint16_t data, FIL *pFile)
+{
+    uint32_t  bCnt = 0;
+    char      lbuf[16];
+
+    strcpy (lbuf, "# B ");
+    sprintf (&lbuf[4], DATA_FORMAT, data);
+    return (f_write (pFile, lbuf, strlen(lbuf), (UINT *) &bCnt));
+}
+
+
+
+/* write the wind noise stage output to the output (SD card file), as
+ * comment line "# W <flags> <average>": the flags of the last block
+ * (hex, WIND_FLAG_xxx), and the noise-weighted average channel
+ */
+uint32_t  putWindItem (uint8_t flags, uint16_t avg, FIL *pFile)
+{
+    uint32_t  bCnt = 0;
+    char      lbuf[20];
+
+    sprintf (lbuf, "# W %02X ", flags);
+    sprintf (&lbuf[7], DATA_FORMAT, avg);
+    return (f_write (pFile, lbuf, strlen(lbuf), (UINT *) &bCnt));
+}
+
+
+
+/* write a tone monitor report to the output (SD card file), as comment
+ * line "# T <line> <amplitude> <phase>[ A]" like the baro items: line
+ * number, amplitude (0.01 LSB) and phase (degrees), and an 'A' appended
+ * while the line is in alarm
+ */
+uint32_t  putToneItem (uint8_t line, ToneReport *pRep, FIL *pFile)
+{
+    uint32_t  bCnt = 0;
+    char      lbuf[32];
+
+    sprintf (lbuf,"# T %u %lu %d%s\n", line, (unsigned long) pRep->amp, pRep->phase, pRep->alarm ? " A" : "");
+    return (f_write (pFile, lbuf, strlen(lbuf), (UINT *) &bCnt));
+}
+
+
+
+/* write an interval statistics record to the summary file;
+ * the file is synced with every 60s record
+ */
+uint32_t  putSummaryItem (StatsRecord *pRec, FIL *pFile)
+{
+    uint32_t  ret, bCnt = 0;
+    char      lbuf[64];
+    int       sl;
+
+    sl  = statsFormat (pRec, lbuf);
+    ret = f_write (pFile, lbuf, sl, (UINT *) &bCnt);
+    if ((ret == 0) && (pRec->level == STATS_LEVELS-1))
+        f_sync (pFile);
+    return (ret);
+}
+
+
+
+/* append the pending crash dump report to the crash log file;
+ * the file system must be mounted (openDataFile);
+ * return value is a success/error message from the file system
+ */
+uint32_t  putCrashReport (void)
+{
+    FIL       F1;
+    uint32_t  i, ret, bCnt = 0;
+    int       sl;
+
+    if (fileState != 1)
+        return (FR_NOT_READY);
+    ret = f_open (&F1, CRASH_FILENAME, FA_WRITE | FA_OPEN_ALWAYS);
+    if (ret != FR_OK)
+        return (ret);
+
+    ret = f_lseek (&F1, f_size (&F1));
+    for (i=0; (ret == FR_OK) && ((sl = crashLine (i, tBuffer)) > 0); i++)
+        ret = f_write (&F1, tBuffer, sl, (UINT *) &bCnt);
+    (void) f_close (&F1);
+    return (ret);
+}
@@ -3,11 +3,25 @@
  */
 
 #include "ff.h"
+#include "tones.h"
+#include "stats.h"
+#include "config.h"
 
 /* ---- interface functions ----
  */
+uint32_t  readConfigFile      (Config *pCfg);
 uint32_t  openDataFile        (void);
 uint32_t  getNextFileID       (void);
 uint32_t  putHeader           (FIL *pFile);
 uint32_t  openOutputFile      (uint32_t curID, FIL *pFile);
+uint32_t  openSummaryFile     (uint32_t curID, FIL *pFile);
+uint32_t  appendFile          (uint32_t curID, const char *pExt, FIL *pFile);
 uint32_t  putDataItem         (uint16_t data, FIL *pFile);
+uint32_t  putDataBlock        (const uint16_t *pData, uint32_t n, FIL *pFile);
+uint32_t  putRateMark         (uint16_t hz, FIL *pFile);
+uint32_t  putResetMark        (const char *pWhy, FIL *pFile);
+uint32_t  putBaroItem         (uint16_t data, FIL *pFile);
+uint32_t  putToneItem         (uint8_t line, ToneReport *pRep, FIL *pFile);
+uint32_t  putWindItem         (uint8_t flags, uint16_t avg, FIL *pFile);
+uint32_t  putSummaryItem      (StatsRecord *pRec, FIL *pFile);
+uint32_t  putCrashReport      (void);
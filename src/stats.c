@@ -0,0 +1,196 @@
+/* ---------------------------------------------------------------------------
+ * interval statistics engine;
+ * every sample updates the level 0 (1s) accumulator only; a completed
+ * interval is emitted as a record and merged into the next level, i.e.
+ * the 10s and 60s summaries cost one merge per second and ten seconds;
+ * since the accumulators hold n, min, max, sum and sum of squares,
+ * merging is exact, and a host tool can answer arbitrary time-range
+ * queries from the records without touching the raw data
+ * ---------------------------------------------------------------------------
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "stm32f4xx.h"
+#include "stats.h"
+
+/* Private define ------------------------------------------------------------*/
+#define QUEUE_MASK             (STATS_QUEUE_SIZE - 1)
+
+/* Private variables ---------------------------------------------------------*/
+static StatsAcc        acc[STATS_LEVELS];
+static StatsRecord     queue[STATS_QUEUE_SIZE];
+static uint16_t        qHead   = 0;
+static uint16_t        qTail   = 0;
+static uint32_t        seconds = 0;     // completed level 0 intervals
+static uint32_t        ticks   = 0;     // level 0 interval time, STATS_TICKS_S per second
+static uint32_t        step    = STATS_TICKS_S / STATS_RATE_HZ;   // per sample
+static uint32_t        ref     = 0;     // reference for the sums
+static uint32_t        refSet  = 0;
+
+static const uint16_t  rollup[STATS_LEVELS]   = { 0, STATS_ROLLUP_1, STATS_ROLLUP_2 };   // level 0 by <ticks>
+static const uint16_t  duration[STATS_LEVELS] = { 1, STATS_ROLLUP_1, STATS_ROLLUP_1 * STATS_ROLLUP_2 };
+
+/* Private prototypes --------------------------------------------------------*/
+static void  clearAcc  (StatsAcc *pAcc);
+static void  mergeAcc  (StatsAcc *pDst, StatsAcc *pSrc);
+static void  emitLevel (uint8_t level);
+
+
+/* Code  ---------------------------------------------------------------------*/
+
+void  initStats (void)
+{
+    uint32_t  i;
+
+    for (i=0; i<STATS_LEVELS; i++)
+        clearAcc (&acc[i]);
+    qHead   = qTail = 0;
+    seconds = 0;
+    ticks   = 0;
+    step    = STATS_TICKS_S / STATS_RATE_HZ;
+    refSet  = 0;
+}
+
+
+
+/* the rate of the following samples, in Hz; a divisor of STATS_TICKS_S
+ * (150, 50 and 1 .. 10); the current interval keeps the time of the
+ * samples it has, so a change does not shift the interval boundaries
+ */
+void  statsSetRate (uint16_t hz)
+{
+    if ((hz > 0) && ((STATS_TICKS_S % hz) == 0))
+        step = STATS_TICKS_S / hz;
+}
+
+
+
+/* add one sample to the current 1s interval;
+ * completed intervals are queued as records, and rolled up
+ */
+void  statsInput (uint16_t data)
+{
+    StatsAcc  *pa;
+    int32_t    d;
+    uint32_t   level;
+
+    if (!refSet)
+    {
+        ref    = data;
+        refSet = 1;
+    }
+
+    pa = &acc[0];
+    d  = (int32_t) data - (int32_t) ref;
+    if ((pa->n == 0) || (data < pa->min))
+        pa->min = data;
+    if ((pa->n == 0) || (data > pa->max))
+        pa->max = data;
+    pa->sum   += d;
+    pa->sumsq += (uint64_t) ((int64_t) d * d);
+    pa->n++;
+
+    ticks += step;
+    if (ticks < STATS_TICKS_S)
+        return;
+    ticks -= STATS_TICKS_S;
+
+    // interval complete; emit and merge upwards as far as levels complete
+    for (level=0; level<STATS_LEVELS; level++)
+    {
+        emitLevel (level);
+        if (level+1 < STATS_LEVELS)
+        {
+            mergeAcc (&acc[level+1], &acc[level]);
+            clearAcc (&acc[level]);
+            if (++acc[level+1].count < rollup[level+1])
+                break;
+        }
+        else
+            clearAcc (&acc[level]);
+    }
+    seconds++;
+}
+
+
+
+/* fetch the next summary record;
+ * returns 1 if a record was available
+ */
+uint32_t  statsGet (StatsRecord *pRec)
+{
+    if (qTail == qHead)
+        return 0;
+
+    *pRec = queue[qTail];
+    qTail = (qTail + 1) & QUEUE_MASK;
+    return 1;
+}
+
+
+
+/* format a record as one text line (the summary file format):
+ *   <level> <start[s]> <n> <min> <max> <mean> <rms>
+ * returns the string length
+ */
+int  statsFormat (StatsRecord *pRec, char *pBuf)
+{
+    return (sprintf (pBuf, "%u %lu %lu %u %u %.2f %.2f\n", pRec->level, (unsigned long) pRec->time,
+                     (unsigned long) pRec->n, pRec->min, pRec->max, pRec->mean, pRec->rms));
+}
+
+
+
+static void  clearAcc (StatsAcc *pAcc)
+{
+    memset (pAcc, 0, sizeof (StatsAcc));
+}
+
+
+
+static void  mergeAcc (StatsAcc *pDst, StatsAcc *pSrc)
+{
+    if (pSrc->n == 0)
+        return;
+    if ((pDst->n == 0) || (pSrc->min < pDst->min))
+        pDst->min = pSrc->min;
+    if ((pDst->n == 0) || (pSrc->max > pDst->max))
+        pDst->max = pSrc->max;
+    pDst->n     += pSrc->n;
+    pDst->sum   += pSrc->sum;
+    pDst->sumsq += pSrc->sumsq;
+}
+
+
+
+/* convert a completed accumulator into a record, and queue it;
+ * the oldest record is overwritten if the consumer lags behind
+ */
+static void  emitLevel (uint8_t level)
+{
+    StatsAcc     *pa;
+    StatsRecord  *pr;
+    double        m, v;
+
+    pa = &acc[level];
+    if (pa->n == 0)
+        return;
+
+    pr        = &queue[qHead];
+    qHead     = (qHead + 1) & QUEUE_MASK;
+    if (qHead == qTail)
+        qTail = (qTail + 1) & QUEUE_MASK;
+
+    m         = (double) pa->sum / pa->n;
+    v         = (double) pa->sumsq / pa->n - m * m;
+    pr->level = level;
+    pr->time  = ((seconds + 1) - duration[level]);
+    pr->n     = pa->n;
+    pr->min   = pa->min;
+    pr->max   = pa->max;
+    pr->mean  = (float) (m + ref);
+    pr->rms   = (v > 0.0) ? (float) sqrt (v) : 0.0f;
+}
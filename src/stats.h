@@ -0,0 +1,57 @@
+#ifndef STATS_H
+  #define STATS_H
+
+/* interval statistics engine;
+ * min / max / mean / RMS summaries per 1s, 10s and 60s interval,
+ * with the longer intervals rolled up from the shorter ones; the 1s
+ * intervals are timed by the input rate (statsSetRate), which may change
+ * within an interval
+ */
+
+/* ---------------- definitions ----------------
+ */
+#define STATS_LEVELS           3
+#define STATS_RATE_HZ          150      // input rate, until set otherwise
+#define STATS_TICKS_S          12600    // level 0 time base per second; a multiple of every input rate
+#define STATS_ROLLUP_1         10       // level 0 intervals per level 1 (10s)
+#define STATS_ROLLUP_2         6        // level 1 intervals per level 2 (60s)
+#define STATS_QUEUE_SIZE       8        // pending records, power of 2
+
+
+/* running accumulator of one interval;
+ * sums are kept relative to a reference value, so they stay exact
+ */
+typedef struct
+{
+    uint32_t  n;
+    uint16_t  min;
+    uint16_t  max;
+    int64_t   sum;
+    uint64_t  sumsq;
+    uint16_t  count;      // sub-intervals merged so far
+} StatsAcc;
+
+
+/* one summary record, as written to file / serial line
+ */
+typedef struct
+{
+    uint8_t   level;      // 0 = 1s, 1 = 10s, 2 = 60s
+    uint32_t  time;       // interval start, seconds since recording start
+    uint32_t  n;          // samples in the interval
+    uint16_t  min;
+    uint16_t  max;
+    float     mean;
+    float     rms;        // RMS of the AC part (standard deviation)
+} StatsRecord;
+
+
+/* ------------ function prototypes ------------
+ */
+void      initStats   (void);
+void      statsSetRate (uint16_t hz);
+void      statsInput  (uint16_t data);
+uint32_t  statsGet    (StatsRecord *pRec);
+int       statsFormat (StatsRecord *pRec, char *pBuf);
+
+#endif  //  STATS_H
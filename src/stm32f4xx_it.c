@@ -16,6 +16,15 @@
 #include "stm32f4xx_conf.h"
 #include "main.h"
 #include "bmp280.h"
+#include "stm32f4_discovery_lcd.h"
+#include "perf.h"
+#include "sched.h"
+#include "power.h"
+#include "prof.h"
+#include "trace.h"
+#include "crash.h"
+#include "wdog.h"
+#include "boot.h"
 
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
@@ -30,10 +39,15 @@ extern volatile uint32_t    sysMode;
 
 extern volatile uint8_t     devStatus;
 extern volatile uint16_t    currentAPvalue;
-extern volatile uint32_t    runChain;
 
-extern volatile char        sBuffer[32];
-extern volatile uint8_t     txIndex;
+extern uint8_t              txBuffer[TX_BUF_SIZE];
+extern volatile uint16_t    txHead;
+extern volatile uint16_t    txTail;
+extern volatile uint8_t     serialCmd;
+
+extern uint16_t             smplBuffer[SMPL_BUF_SIZE];
+extern volatile uint16_t    smplHead;
+extern volatile uint16_t    smplTail;
 
 /* Private variables ---------------------------------------------------------*/
 
@@ -51,38 +65,46 @@ void NMI_Handler(void)
 {
 }
 
-/* handle Hard Fault exceptions
+/* fault handlers; pass the exception frame (main or process stack, from
+ * EXC_RETURN) and EXC_RETURN to the crash dump, which resets the MCU;
+ * no C prologue may touch a possibly broken stack before
  */
-static volatile uint32_t  __hvi;
+#define FAULT_ENTRY                   \
+    __asm volatile (                  \
+        " tst   lr, #4          \n"   \
+        " ite   eq              \n"   \
+        " mrseq r0, msp         \n"   \
+        " mrsne r0, psp         \n"   \
+        " mov   r1, lr          \n"   \
+        " b     crashHandler    \n")
 
-void  HardFault_Handler (void)
+/* handle Hard Fault exceptions
+ */
+__attribute__((naked)) void  HardFault_Handler (void)
 {
-    while (1)  /* infinite loop */
-    {
-        __hvi++;
-    }
+    FAULT_ENTRY;
 }
 
 
 /* handle Memory Manage exceptions
  */
-void MemManage_Handler(void)
+__attribute__((naked)) void  MemManage_Handler (void)
 {
-    while (1);  /* infinite loop */
+    FAULT_ENTRY;
 }
 
 /* handle Bus Fault exceptions
  */
-void BusFault_Handler(void)
+__attribute__((naked)) void  BusFault_Handler (void)
 {
-    while (1);  /* infinite loop */
+    FAULT_ENTRY;
 }
 
 /* handle Usage Fault exceptions
  */
-void UsageFault_Handler(void)
+__attribute__((naked)) void  UsageFault_Handler (void)
 {
-    while (1);  /* infinite loop */
+    FAULT_ENTRY;
 }
 
 /* handle SVCall exceptions
@@ -107,20 +129,44 @@ void PendSV_Handler(void)
  */
 void  SysTick_Handler (void)
 {
+    uint32_t  t0 = DWT->CYCCNT;
+    uint16_t  next;
+
     /* decrement the delay counter */
     if (TimingDelay)
         TimingDelay--;
 
     if (devStatus == DEV_STATUS_RUN)
     {
+        PROF_ENTER (PROF_ZONE_READ_SENSOR);
         currentAPvalue = readPSensor ();
-        runChain = 1;
+        PROF_EXIT (PROF_ZONE_READ_SENSOR);
+        next = (smplHead + 1) & (SMPL_BUF_SIZE - 1);
+        if (next == smplTail)
+        {
+            perfSampleLost ();      // FIFO full, the acquisition task is stuck
+            TRACE (TRACE_SAMPLE_LOST, currentAPvalue);
+            traceTrigger (TRACE_WHY_LOST);
+        }
+        else
+        {
+            smplBuffer[smplHead] = currentAPvalue;
+            smplHead             = next;
+            TRACE (TRACE_SAMPLE, currentAPvalue);
+        }
+        bootMark (BOOT_STAGE_SAMPLE);
+        schedPost (SCHED_EV(SCHED_TASK_ACQ));
     }
+    schedTick ();
+    if (devStatus != DEV_STATUS_LOWRATE)
+        wdogPoll ();            // the low-rate loop polls by itself
 
     // delay timer
     if (toDelay)
         toDelay--;
 
+    perfIsr (DWT->CYCCNT - t0);
+
 }
 
 
@@ -147,6 +193,31 @@ void  DMA2_Stream1_IRQHandler (void)
 
 
 
+/* RTC wakeup timer, and the user button; Stop mode wakeups
+ */
+void  RTC_WKUP_IRQHandler (void)
+{
+    powerRtcIRQ ();
+}
+
+
+
+void  EXTI0_IRQHandler (void)
+{
+    powerButtonIRQ ();
+}
+
+
+
+/* LCD fill / blit DMA completion
+ */
+void  LCD_DMA_IRQHANDLER (void)
+{
+    LCD_DmaIRQ ();
+}
+
+
+
 void  ADC_IRQHandler (void)
 {
 }
@@ -194,31 +265,33 @@ void  USART3_IRQHandler(void)
 void  USART6_IRQHandler(void)
 {
     volatile uint8_t  databyte;
+    uint32_t          sr;
 
-    /* TX interrupt; send next char, or disable interrupt when ready */
+    /* TX interrupt; send next char from the ring buffer, or disable interrupt when empty */
     if (USART_GetITStatus (USART6, USART_IT_TXE) != RESET)
     {
-        // check if we reached the last character, i.e. next is '\0', to disable the TX interrupt
-        if (sBuffer[txIndex+1] == 0)
+        if (txTail == txHead)
+        {
             USART6->CR1 &= ~USART_CR1_TXEIE;
-//          USART_ITConfig (USART6, USART_IT_TXE, DISABLE);
-
-        // push next character
-        USART6->DR = sBuffer[txIndex++];
+            TRACE (TRACE_TX_END, 0);
+        }
+        else
+        {
+            USART6->DR = txBuffer[txTail];
+            txTail     = (txTail + 1) & (TX_BUF_SIZE - 1);
+        }
     }
 
-    /*  RNXE interrupt */
-    if (USART_GetITStatus (USART6, USART_IT_RXNE) != RESET)
-    {
-        databyte = (USART6->DR & 0x00FF);
-        // no reception expected - yet
-    }
-
-    /* error flag set; try clearing by reading SR and DR */
-    if (USART6->SR & USART_ERR_MASK)
-    {
-        databyte = USART6->SR;
+    /* RXNE interrupt (also raised by an overrun); a character received
+     * with an error is dropped; reading SR, then DR clears ORE, NF, FE, PE */
+    sr = USART6->SR;
+    if (sr & USART_ERR_MASK)
         databyte = USART6->DR;
+    else if (sr & USART_SR_RXNE)
+    {
+        databyte  = (USART6->DR & 0x00FF);
+        serialCmd = databyte;       // single character commands
+        schedPost (SCHED_EV(SCHED_TASK_SERIAL));
     }
 }
 
@@ -0,0 +1,272 @@
+/* ---------------------------------------------------------------------------
+ * narrowband monitor for known tonal lines;
+ * each line is a sliding Goertzel detector, i.e. the Goertzel recursion
+ *   s[n] = x[n] + 2r*cos(w)*s[n-1] - r^2*s[n-2]
+ * with a pole radius r < 1 instead of a block reset; the radius sets the
+ * bandwidth (bw ~ (1-r)*fs/pi), and the cost is a fixed 2 MACs per
+ * sample and line;
+ * amplitude and phase are only evaluated at the (low) report rate:
+ *   X = s[n] - r*e^(-jw)*s[n-1],   |A| = 2*(1-r)*|X|
+ * a shared DC blocker in front removes the ambient pressure
+ * ---------------------------------------------------------------------------
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include <math.h>
+#include <string.h>
+#include "stm32f4xx.h"
+#include "tones.h"
+#include "multirate.h"
+
+/* Private define ------------------------------------------------------------*/
+#define TONE_DCB_FRAC          12       // DC blocker output, Q12 (in LSB)
+#define TONE_STATE_BITS        30       // resonator state headroom
+#define TONE_IN_BITS           (16 + TONE_DCB_FRAC)
+#define Q30_ONE                1073741824.0f
+#define Q31_ONE                2147483648.0f
+#define RAD2DEG                57.29578f
+#define TONE_PI                3.14159265f
+
+/* Private variables ---------------------------------------------------------*/
+static ToneLine    lines[TONE_MAX_LINES];
+static ToneReport  reports[TONE_MAX_LINES];
+static uint32_t    activeLines = 0;   // bitmask of enabled lines
+static uint32_t    alarmLines  = 0;   // bitmask of lines in alarm
+static uint32_t    toneCount   = 0;
+static int32_t     dcLastX     = -1;
+static int32_t     dcY         = 0;
+
+/* Private prototypes --------------------------------------------------------*/
+static void  resetState (void);
+static void  evalLine   (uint8_t line);
+
+
+/* Code  ---------------------------------------------------------------------*/
+
+/* reset the detector bank, without lines; they are set up by
+ * toneSetLine, from the configuration (tone<N> keys)
+ */
+void  initTones (void)
+{
+    memset (lines, 0, sizeof (lines));
+    activeLines = 0;
+    resetState ();
+}
+
+
+
+/* configure a detector line;
+ * <freq> in 0.01Hz (0 disables the line), <bw> in 0.001Hz,
+ * <alarm> amplitude threshold in 0.01 LSB (0 = no alarm);
+ * returns TONE_RET_ERR for out-of-range parameters
+ */
+uint32_t  toneSetLine (uint8_t line, uint16_t freq, uint16_t bw, uint32_t alarm)
+{
+    ToneLine  *pl;
+    float      w, r;
+    int32_t    g;
+
+    if (line >= TONE_MAX_LINES)
+        return (TONE_RET_ERR);
+
+    pl = &lines[line];
+    memset (pl, 0, sizeof (ToneLine));
+    activeLines &= ~(1UL << line);
+    alarmLines  &= ~(1UL << line);
+    if (freq == 0)
+        return (TONE_RET_OK);
+
+    // centre frequency below Nyquist, bandwidth non-zero and not beyond
+    if ((freq >= (RATE_INPUT_HZ * 100) / 2) || (bw == 0) || (bw >= (uint32_t) freq * 10))
+        return (TONE_RET_ERR);
+
+    w = 2.0f * TONE_PI * (freq / 100.0f) / RATE_INPUT_HZ;
+    r = 1.0f - TONE_PI * (bw / 1000.0f) / RATE_INPUT_HZ;
+
+    pl->freq  = freq;
+    pl->bw    = bw;
+    pl->alarm = alarm;
+    pl->coef  = (int32_t) (2.0f * r * cosf (w) * Q30_ONE);
+    pl->r2    = (int32_t) (r * r * Q31_ONE);
+    pl->rc    = r * cosf (w);
+    pl->rs    = r * sinf (w);
+    pl->gain  = 2.0f * (1.0f - r);
+
+    // scale the input down by the resonator gain 1/(1-r), in bits
+    g = (int32_t) ceilf (log2f (1.0f / (1.0f - r)));
+    g = g + TONE_IN_BITS - TONE_STATE_BITS;
+    pl->shift = (g < 0) ? 0 : (uint8_t) g;
+
+    activeLines |= (1UL << line);
+    return (TONE_RET_OK);
+}
+
+
+
+/* run one sensor sample through the detector bank;
+ * returns 1 when a new set of reports is available
+ */
+uint32_t  toneInput (uint16_t data)
+{
+    ToneLine  *pl;
+    int32_t    x, s0;
+    uint32_t   i;
+
+    // DC blocker, y = x - x' + a*y'
+    if (dcLastX < 0)
+        dcLastX = data;
+    dcY     = ((data - dcLastX) << TONE_DCB_FRAC) + (int32_t) (((int64_t) TONE_DCB_COEF * dcY) >> 15);
+    dcLastX = data;
+
+    for (i=0, pl=lines; i<TONE_MAX_LINES; i++, pl++)
+    {
+        if (!(activeLines & (1UL << i)))
+            continue;
+
+        x      = dcY >> pl->shift;
+        s0     = x + (int32_t) (((int64_t) pl->coef * pl->s1) >> 30)
+                   - (int32_t) (((int64_t) pl->r2 * pl->s2) >> 31);
+        pl->s2 = pl->s1;
+        pl->s1 = s0;
+    }
+
+    if (++toneCount < TONE_REPORT_ITEMS)
+        return 0;
+    toneCount = 0;
+
+    for (i=0; i<TONE_MAX_LINES; i++)
+        if (activeLines & (1UL << i))
+            evalLine (i);
+    return 1;
+}
+
+
+
+/* get the last report of a line;
+ * returns TONE_RET_ERR if the line is not active
+ */
+uint32_t  toneGetReport (uint8_t line, ToneReport *pReport)
+{
+    if ((line >= TONE_MAX_LINES) || !(activeLines & (1UL << line)))
+        return (TONE_RET_ERR);
+
+    *pReport = reports[line];
+    return (TONE_RET_OK);
+}
+
+
+
+/* bitmask of lines currently above their alarm threshold
+ */
+uint32_t  toneAlarms (void)
+{
+    return (alarmLines);
+}
+
+
+
+/* measure the detector cost with the DWT cycle counter;
+ * runs the active lines over a synthetic input, and compares against
+ * a run with all lines disabled (DC blocker and loop overhead); the
+ * report count is held at 0 in both runs, so the amplitude / phase
+ * evaluation (float, per report) is not included;
+ * returns cycles per sample and line; the detector state is saved and
+ * restored, so the live bank (after initTones) keeps its history, as
+ * long as the benchmark is not preempted by the acquisition
+ */
+uint32_t  toneBenchmark (void)
+{
+    ToneLine    savedLines[TONE_MAX_LINES];
+    ToneReport  savedReports[TONE_MAX_LINES];
+    uint32_t    savedAlarms, savedCount;
+    int32_t     savedLastX, savedY;
+    uint32_t    i, n, t0, tAll, tNone, mask;
+
+    for (i=0, n=0, mask=activeLines; i<TONE_MAX_LINES; i++)
+        if (mask & (1UL << i))
+            n++;
+    if (n == 0)
+        return 0;
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL        |= DWT_CTRL_CYCCNTENA_Msk;
+
+    memcpy (savedLines, lines, sizeof (lines));
+    memcpy (savedReports, reports, sizeof (reports));
+    savedAlarms = alarmLines;
+    savedCount  = toneCount;
+    savedLastX  = dcLastX;
+    savedY      = dcY;
+
+    t0 = DWT->CYCCNT;
+    for (i=0; i<TONE_BENCH_ITEMS; i++)
+    {
+        toneCount = 0;                  // no evaluation
+        (void) toneInput ((uint16_t) (0x8000 + (i & 0x3F)));
+    }
+    tAll = DWT->CYCCNT - t0;
+
+    activeLines = 0;
+    t0 = DWT->CYCCNT;
+    for (i=0; i<TONE_BENCH_ITEMS; i++)
+    {
+        toneCount = 0;
+        (void) toneInput ((uint16_t) (0x8000 + (i & 0x3F)));
+    }
+    tNone = DWT->CYCCNT - t0;
+
+    activeLines = mask;
+    memcpy (lines, savedLines, sizeof (lines));
+    memcpy (reports, savedReports, sizeof (reports));
+    alarmLines = savedAlarms;
+    toneCount  = savedCount;
+    dcLastX    = savedLastX;
+    dcY        = savedY;
+
+    if (tAll <= tNone)
+        return 0;
+    return ((tAll - tNone) / (TONE_BENCH_ITEMS * n));
+}
+
+
+
+/* clear the detector states and reports, keeping the line setup
+ */
+static void  resetState (void)
+{
+    uint32_t  i;
+
+    for (i=0; i<TONE_MAX_LINES; i++)
+        lines[i].s1 = lines[i].s2 = 0;
+    memset (reports, 0, sizeof (reports));
+    alarmLines = 0;
+    toneCount  = 0;
+    dcLastX    = -1;
+    dcY        = 0;
+}
+
+
+
+/* evaluate amplitude and phase of a line from the resonator state,
+ * and update its alarm state
+ */
+static void  evalLine (uint8_t line)
+{
+    ToneLine  *pl;
+    float      re, im, amp;
+
+    pl  = &lines[line];
+    re  = (float) pl->s1 - pl->rc * (float) pl->s2;
+    im  = pl->rs * (float) pl->s2;
+    amp = pl->gain * sqrtf (re * re + im * im);
+    amp = amp * (float) (1UL << pl->shift) / (float) (1UL << TONE_DCB_FRAC);
+
+    reports[line].amp   = (uint32_t) (amp * 100.0f);
+    reports[line].phase = (int16_t) (atan2f (im, re) * RAD2DEG);
+    reports[line].alarm = (pl->alarm != 0) && (reports[line].amp >= pl->alarm);
+
+    if (reports[line].alarm)
+        alarmLines |= (1UL << line);
+    else
+        alarmLines &= ~(1UL << line);
+}
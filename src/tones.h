@@ -0,0 +1,55 @@
+#ifndef TONES_H
+  #define TONES_H
+
+/* narrowband monitor for known tonal lines (wind turbines, compressors);
+ * a bank of sliding Goertzel detectors, updated per sample in Q31
+ */
+
+/* ---------------- definitions ----------------
+ */
+#define TONE_MAX_LINES         4
+#define TONE_REPORT_ITEMS      150      // input samples per report (1s @150Hz)
+#define TONE_DCB_COEF          32604    // DC blocker pole, 0.995 in Q15
+#define TONE_BENCH_ITEMS       1024     // samples per benchmark run
+
+#define TONE_RET_OK            0
+#define TONE_RET_ERR           1
+
+
+/* one detector line; a damped resonator with its pole pair at r*e^(+-jw),
+ * i.e. a Goertzel filter with exponential forgetting instead of blocks
+ */
+typedef struct
+{
+    uint16_t  freq;       // centre frequency, in 0.01Hz; 0 = line disabled
+    uint16_t  bw;         // bandwidth (-3dB), in 0.001Hz
+    uint32_t  alarm;      // amplitude alarm threshold, in 0.01 LSB; 0 = none
+    int32_t   coef;       // 2*r*cos(w), Q30
+    int32_t   r2;         // r^2, Q31
+    int32_t   s1, s2;     // resonator state
+    uint8_t   shift;      // input scaling, keeps the state in range
+    float     rc, rs;     // r*cos(w), r*sin(w), for the output evaluation
+    float     gain;       // amplitude normalisation 2*(1-r)
+} ToneLine;
+
+
+/* per-line result, updated every TONE_REPORT_ITEMS samples
+ */
+typedef struct
+{
+    uint32_t  amp;        // amplitude, in 0.01 LSB
+    int16_t   phase;      // phase, in degrees (-180 .. 180)
+    uint8_t   alarm;      // amplitude above threshold
+} ToneReport;
+
+
+/* ------------ function prototypes ------------
+ */
+void      initTones      (void);
+uint32_t  toneSetLine    (uint8_t line, uint16_t freq, uint16_t bw, uint32_t alarm);
+uint32_t  toneInput      (uint16_t data);
+uint32_t  toneGetReport  (uint8_t line, ToneReport *pReport);
+uint32_t  toneAlarms     (void);
+uint32_t  toneBenchmark  (void);
+
+#endif  //  TONES_H
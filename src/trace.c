@@ -0,0 +1,174 @@
+/* ---------------------------------------------------------------------------
+ * pipeline event trace;
+ * a writer reserves its slot by incrementing the ring head with an
+ * exclusive access loop, so handlers preempting a task each get their own
+ * record; the oldest records are overwritten; while a dump runs the ring
+ * is frozen, and new events are dropped;
+ * the dump is paced by the space in the serial ring buffer; the records
+ * are sent hex-coded, oldest first, as one line each, after a header with
+ * the record count and the cycle clock:
+ *   X<count> <Hz>
+ *   x<time:8><event:2><ctx:2><arg:4>
+ * ---------------------------------------------------------------------------
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdio.h>
+#include <string.h>
+#include "stm32f4xx.h"
+#include "main.h"
+#include "sched.h"
+#include "trace.h"
+
+#ifdef _TRACE_
+
+/* Private define ------------------------------------------------------------*/
+#define TRACE_MASK             (TRACE_SIZE - 1)
+#define DUMP_IDLE              0xFFFFFFFF
+#define DUMP_HEADER            0xFFFFFFFE
+
+/* Private variables ---------------------------------------------------------*/
+extern uint16_t            serialActive;
+
+static TraceRecord         ring[TRACE_SIZE];
+static volatile uint32_t   head     = 0;    // records written, total
+static volatile uint8_t    frozen   = 0;
+static uint32_t            dumpNext = DUMP_IDLE;
+static uint32_t            dumpEnd;
+static uint32_t            lastAuto;
+static uint8_t             autoDone = 0;
+static char                lineBuf[32];
+
+
+/* Code  ---------------------------------------------------------------------*/
+
+/* requires the DWT cycle counter (initPerf)
+ */
+void  initTrace (void)
+{
+    memset (ring, 0, sizeof (ring));
+    head     = 0;
+    frozen   = 0;
+    dumpNext = DUMP_IDLE;
+    autoDone = 0;
+}
+
+
+
+/* log an event; any context
+ */
+void  traceRecord (uint8_t event, uint16_t arg)
+{
+    TraceRecord  *pr;
+    uint32_t      i, t;
+
+    if (frozen)
+        return;
+    t = DWT->CYCCNT;
+    do
+    {
+        i = __LDREXW (&head);
+    }
+    while (__STREXW (i + 1, &head));
+
+    pr        = &ring[i & TRACE_MASK];
+    pr->time  = t;
+    pr->event = event;
+    pr->ctx   = (uint8_t) __get_IPSR ();
+    pr->arg   = arg;
+}
+
+
+
+/* an anomaly; logged, and dumped if the serial output is active and the
+ * last automatic dump is long enough ago; any context
+ */
+void  traceTrigger (uint16_t reason)
+{
+    uint32_t  now;
+
+    traceRecord (TRACE_ANOMALY, reason);
+    if (!serialActive || frozen)
+        return;
+    now = DWT->CYCCNT;
+    if (autoDone && ((now - lastAuto) < TRACE_AUTO_HOLDOFF_S * SystemCoreClock))
+        return;
+    autoDone = 1;
+    lastAuto = now;
+    traceDump ();
+    schedPost (SCHED_EV(SCHED_TASK_SERIAL));
+}
+
+
+
+/* freeze the ring, and start sending it
+ */
+void  traceDump (void)
+{
+    uint32_t  n;
+
+    if (frozen)
+        return;
+    frozen   = 1;
+    n        = (head < TRACE_SIZE) ? head : TRACE_SIZE;
+    dumpEnd  = head;
+    dumpNext = DUMP_HEADER;
+    sprintf (lineBuf, "X%lu %lu\n", (unsigned long) n, (unsigned long) SystemCoreClock);
+}
+
+
+
+/* send the next lines of a running dump, as far as they fit into the
+ * serial buffer; to be called from the serial task
+ */
+void  traceTask (void)
+{
+    TraceRecord  *pr;
+    int           sl;
+
+    if (dumpNext == DUMP_IDLE)
+        return;
+
+    if (dumpNext == DUMP_HEADER)
+    {
+        sl = strlen (lineBuf);
+        if (serialFree () < (uint32_t) sl)
+            return;
+        (void) serialWrite (lineBuf, sl);
+        dumpNext = dumpEnd - ((dumpEnd < TRACE_SIZE) ? dumpEnd : TRACE_SIZE);
+    }
+
+    while (dumpNext != dumpEnd)
+    {
+        if (serialFree () < 20)
+            return;                     // next run
+        pr = &ring[dumpNext & TRACE_MASK];
+        sl = sprintf (lineBuf, "x%08lX%02X%02X%04X\n", (unsigned long) pr->time, pr->event, pr->ctx, pr->arg);
+        (void) serialWrite (lineBuf, sl);
+        dumpNext++;
+    }
+
+    dumpNext = DUMP_IDLE;
+    frozen   = 0;
+}
+
+
+
+/* copy the last <n> records, oldest first, and return their count; no
+ * locking, for the fault handlers
+ */
+uint32_t  traceCopy (TraceRecord *pDst, uint32_t n)
+{
+    uint32_t  i, h;
+
+    h = head;
+    if (n > h)
+        n = h;
+    if (n > TRACE_SIZE)
+        n = TRACE_SIZE;
+    for (i=0; i<n; i++)
+        pDst[i] = ring[(h - n + i) & TRACE_MASK];
+    return (n);
+}
+
+#endif  //  _TRACE_
@@ -0,0 +1,73 @@
+#ifndef TRACE_H
+  #define TRACE_H
+
+/* pipeline event trace;
+ * 8 byte records (cycle time stamp, event, context, argument) go into a
+ * RAM ring, from interrupt handlers and tasks alike, without locks; the
+ * ring is sent over serial on the 't' command, or automatically on an
+ * anomaly (lost sample, missed deadline); tools/trace2json.c turns a
+ * serial capture into a Chrome trace / Perfetto timeline;
+ * without _TRACE_, the macros compile to nothing
+ */
+
+#define _TRACE_                         // comment out to compile the trace out
+
+/* ---------------- definitions ----------------
+ */
+#define TRACE_SIZE             512      // records, power of 2 (4kB)
+#define TRACE_AUTO_HOLDOFF_S   10       // minimum time between automatic dumps
+
+// events; argument in brackets
+#define TRACE_SAMPLE           1        // SysTick, sample read (value)
+#define TRACE_SAMPLE_LOST      2        // sample FIFO full (value)
+#define TRACE_CONSUME          3        // acquisition task took the sample (value)
+#define TRACE_BLOCK            4        // storage task queued samples to the file (count)
+#define TRACE_SD_BEGIN         5        // disk_write, CMD25 started (sector, low 16 bit)
+#define TRACE_SD_END           6        // disk_write done (SD_Error)
+#define TRACE_FRAME            7        // frame rendered, logged at its end (us)
+#define TRACE_TX_BEGIN         8        // UART ring started sending (bytes)
+#define TRACE_TX_END           9        // UART ring empty
+#define TRACE_TASK_BEGIN       10       // scheduler task (task)
+#define TRACE_TASK_END         11       // (task)
+#define TRACE_ANOMALY          12       // automatic dump trigger (reason)
+
+#define TRACE_WHY_LOST         1        // anomaly reasons
+#define TRACE_WHY_DEADLINE     2
+
+
+/* one record; <ctx> is the active exception number (0 = thread mode)
+ */
+typedef struct
+{
+    uint32_t  time;                     // DWT cycles
+    uint8_t   event;
+    uint8_t   ctx;
+    uint16_t  arg;
+} TraceRecord;
+
+
+#ifdef _TRACE_
+  #define TRACE(event, arg)    traceRecord ((event), (uint16_t) (arg))
+#else
+  #define TRACE(event, arg)
+#endif
+
+
+/* ------------ function prototypes ------------
+ */
+#ifdef _TRACE_
+void      initTrace     (void);
+void      traceRecord   (uint8_t event, uint16_t arg);
+void      traceTrigger  (uint16_t reason);
+void      traceDump     (void);
+void      traceTask     (void);
+uint32_t  traceCopy     (TraceRecord *pDst, uint32_t n);
+#else
+  #define initTrace()
+  #define traceTrigger(reason)
+  #define traceDump()
+  #define traceTask()
+  #define traceCopy(pDst, n)   0
+#endif
+
+#endif  //  TRACE_H
@@ -0,0 +1,226 @@
+/* ---------------------------------------------------------------------------
+ * watchdog supervisor;
+ * wdogPoll runs from the SysTick (or from the low-rate loop, which has no
+ * SysTick in Stop mode); it ages every selected entity by one poll, and
+ * feeds the IWDG only if none is past its deadline; the first entity found
+ * late is written to the backup SRAM record, and the feeding stops for
+ * good, the IWDG resets the MCU after its timeout; the SysTick itself
+ * stopping (interrupts disabled, a hung handler) starves the IWDG as well;
+ * the IWDG keeps running in Stop mode, the low-rate loop polls once per
+ * wakeup, below the shortest IWDG timeout
+ * ---------------------------------------------------------------------------
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdio.h>
+#include <string.h>
+#include "stm32f4xx.h"
+#include "main.h"
+#include "crash.h"
+#include "wdog.h"
+#include "persist.h"
+
+/* Private define ------------------------------------------------------------*/
+#define RECORD                 ((WdogRecord *) (BKPSRAM_BASE + WDOG_BKP_OFFSET))
+
+/* Private variables ---------------------------------------------------------*/
+static const char         *names[WDOG_IDS];
+static uint32_t            deadlines[WDOG_IDS];  // ms
+static uint32_t            limit[WDOG_IDS];     // deadlines in polls
+static volatile uint32_t   age[WDOG_IDS];       // polls since the last check-in
+static volatile uint32_t   selected = 0;
+static uint32_t            pollRate = 1;
+static uint32_t            healthy  = 0;        // polls without a late entity
+static volatile uint8_t    expired  = 0;
+static WdogRecord          bootRec;             // the record at boot
+
+/* Private prototypes --------------------------------------------------------*/
+static uint8_t  resetCause (uint32_t flags);
+
+
+/* Code  ---------------------------------------------------------------------*/
+
+/* take the reset cause into the record, and start the IWDG with the boot
+ * steps supervised, polled by the SysTick; requires initCrash (reset flags,
+ * backup SRAM access)
+ */
+void  initWdog (void)
+{
+    WdogRecord  *pr = RECORD;
+
+    if (pr->magic != WDOG_MAGIC)
+    {
+        memset (pr, 0, sizeof (WdogRecord));
+        pr->magic = WDOG_MAGIC;
+    }
+
+    pr->cause = resetCause (crashResetFlags ());
+    if (pr->cause == WDOG_CAUSE_IWDG)
+    {
+        pr->resets++;
+        pr->retries++;
+    }
+    else
+    {
+        pr->retries = 0;
+        pr->starved = WDOG_ID_NONE;
+        pr->ageMs   = 0;
+    }
+    bootRec     = *pr;
+    pr->starved = WDOG_ID_NONE;         // set again by the next expiry only
+    pr->ageMs   = 0;
+
+    memset (names, 0, sizeof (names));
+    memset (deadlines, 0, sizeof (deadlines));
+    expired = 0;
+    wdogRegister (WDOG_ID_BOOT, "boot", WDOG_BOOT_MS);
+    wdogSelect (WDOG_EV(WDOG_ID_BOOT), WDOG_TICK_HZ);
+
+    DBGMCU->APB1FZ |= DBGMCU_APB1_FZ_DBG_IWDG_STOP;     // halted by the debugger
+    IWDG_Enable ();
+    IWDG_WriteAccessCmd (IWDG_WriteAccess_Enable);
+    IWDG_SetPrescaler (WDOG_PRESCALER);
+    IWDG_SetReload (WDOG_RELOAD);
+    IWDG_ReloadCounter ();
+}
+
+
+
+void  wdogRegister (uint32_t id, const char *name, uint32_t deadlineMs)
+{
+    names[id]     = name;
+    deadlines[id] = deadlineMs;
+}
+
+
+
+/* supervise the entities in <mask> (bit = ID), polled <pollHz> times per
+ * second; every entity starts with a fresh check-in
+ */
+void  wdogSelect (uint32_t mask, uint32_t pollHz)
+{
+    uint32_t  i;
+
+    __disable_irq ();
+    for (i=0; i<WDOG_IDS; i++)
+    {
+        limit[i] = deadlines[i] * pollHz / 1000 + 1;
+        age[i]   = 0;
+    }
+    selected = mask;
+    pollRate = pollHz;
+    healthy  = 0;
+    __enable_irq ();
+}
+
+
+
+/* entity <id> is alive; any context
+ */
+void  wdogCheckin (uint32_t id)
+{
+    age[id] = 0;
+}
+
+
+
+/* age the selected entities, and feed the IWDG if none is late; the
+ * retry count is cleared after WDOG_STABLE_S without a late entity
+ */
+void  wdogPoll (void)
+{
+    WdogRecord  *pr;
+    uint32_t     i;
+
+    if (expired)
+        return;
+
+    for (i=0; i<WDOG_IDS; i++)
+    {
+        if (!(selected & WDOG_EV(i)) || (deadlines[i] == 0))
+            continue;
+        if (++age[i] > limit[i])
+        {
+            pr          = RECORD;
+            pr->starved = (uint8_t) i;
+            pr->ageMs   = (uint16_t) (age[i] * 1000 / pollRate);
+            expired     = 1;
+            return;                     // no more feeding, IWDG reset
+        }
+    }
+
+    IWDG_ReloadCounter ();
+    if (++healthy == WDOG_STABLE_S * pollRate)
+        RECORD->retries = 0;
+}
+
+
+
+/* the recording file to append to, after a watchdog reset; 0 to open a
+ * new one
+ */
+uint32_t  wdogResumeFile (void)
+{
+    if (bootRec.cause != WDOG_CAUSE_IWDG)
+        return (0);
+    return (persistGet ()->fileID);
+}
+
+
+
+/* too many watchdog resets in a row; the storage is to be skipped
+ */
+uint8_t  wdogDegraded (void)
+{
+    return (bootRec.retries >= WDOG_RETRIES);
+}
+
+
+
+/* the record as found at boot; <starved> is the entity of a watchdog
+ * reset, WDOG_ID_NONE after a fault (which resets via the IWDG as well)
+ */
+const WdogRecord  *wdogGet (void)
+{
+    return (&bootRec);
+}
+
+
+
+const char  *wdogCauseName (uint32_t cause)
+{
+    static const char  *causeNames[] = WDOG_CAUSE_NAMES;
+
+    if (cause > WDOG_CAUSE_LOWPOWER)
+        return ("?");
+    return (causeNames[cause]);
+}
+
+
+
+const char  *wdogName (uint32_t id)
+{
+    if ((id >= WDOG_IDS) || (names[id] == NULL))
+        return ("-");
+    return (names[id]);
+}
+
+
+
+/* the reset cause from the RCC_CSR flags; the pin flag is set with every
+ * internal reset as well, so it is checked last
+ */
+static uint8_t  resetCause (uint32_t flags)
+{
+    if (flags & RCC_CSR_LPWRRSTF)
+        return (WDOG_CAUSE_LOWPOWER);
+    if (flags & RCC_CSR_WDGRSTF)
+        return (WDOG_CAUSE_IWDG);
+    if (flags & RCC_CSR_WWDGRSTF)
+        return (WDOG_CAUSE_WWDG);
+    if (flags & RCC_CSR_SFTRSTF)
+        return (WDOG_CAUSE_SOFT);
+    if (flags & (RCC_CSR_PORRSTF | RCC_CSR_BORRSTF))
+        return (WDOG_CAUSE_POWER);
+    return (WDOG_CAUSE_PIN);
+}
@@ -0,0 +1,72 @@
+#ifndef WDOG_H
+  #define WDOG_H
+
+/* watchdog supervisor;
+ * the independent watchdog (IWDG, LSI clocked) is only fed while every
+ * selected entity (scheduler task, boot sequence, low-rate loop) has
+ * checked in within its own deadline; a hung task (e.g. the SD card
+ * waiting for a transfer end) thus resets the MCU; the reset cause and
+ * the starved entity are kept in the backup SRAM; the recording file (in
+ * the persistent state) is reopened and appended to after the reset;
+ * worst case recovery: the deadline, plus the IWDG timeout, plus the boot
+ */
+
+/* ---------------- definitions ----------------
+ */
+#define WDOG_BKP_OFFSET        2048     // record in the backup SRAM, after the crash dump
+#define WDOG_MAGIC             0x57444F48   // 'WDOG' + record layout 1
+#define WDOG_PRESCALER         IWDG_Prescaler_32    // LSI 32kHz / 32, 1ms
+#define WDOG_RELOAD            2000     // timeout 2s nominal (LSI 17..47kHz: 1.4..3.8s)
+#define WDOG_RETRIES           3        // consecutive resets, before the SD card is skipped
+#define WDOG_STABLE_S          60       // supervised time that clears the retry count
+#define WDOG_TICK_HZ           150      // SysTick poll rate
+
+// entities; the scheduler tasks are 0 .. SCHED_MAX_TASKS-1
+#define WDOG_ID_LOWRATE        8        // low-rate loop (Stop mode)
+#define WDOG_ID_BOOT           9        // start up, until the scheduler runs
+#define WDOG_IDS               10
+#define WDOG_ID_NONE           0xFF
+
+#define WDOG_EV(id)            (1UL << (id))
+
+#define WDOG_BOOT_MS           5000     // deadline of the boot steps
+
+// reset causes, from the RCC reset flags
+#define WDOG_CAUSE_POWER       0
+#define WDOG_CAUSE_PIN         1
+#define WDOG_CAUSE_SOFT        2
+#define WDOG_CAUSE_IWDG        3
+#define WDOG_CAUSE_WWDG        4
+#define WDOG_CAUSE_LOWPOWER    5
+#define WDOG_CAUSES            6
+
+#define WDOG_CAUSE_NAMES       { "power", "pin", "soft", "watchdog", "wwdg", "lowpower" }
+
+
+/* the record in the backup SRAM
+ */
+typedef struct
+{
+    uint32_t  magic;
+    uint32_t  resets;                   // watchdog resets, total
+    uint32_t  retries;                  // watchdog resets in a row
+    uint8_t   cause;                    // of the last reset, WDOG_CAUSE_xxx
+    uint8_t   starved;                  // entity that missed its deadline
+    uint16_t  ageMs;                    // its time since the last check-in
+} WdogRecord;
+
+
+/* ------------ function prototypes ------------
+ */
+void               initWdog        (void);
+void               wdogRegister    (uint32_t id, const char *name, uint32_t deadlineMs);
+void               wdogSelect      (uint32_t mask, uint32_t pollHz);
+void               wdogCheckin     (uint32_t id);
+void               wdogPoll        (void);
+uint32_t           wdogResumeFile  (void);
+uint8_t            wdogDegraded    (void);
+const WdogRecord  *wdogGet         (void);
+const char        *wdogCauseName   (uint32_t cause);
+const char        *wdogName        (uint32_t id);
+
+#endif  //  WDOG_H
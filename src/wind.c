@@ -0,0 +1,294 @@
+/* ---------------------------------------------------------------------------
+ * wind noise handling for multi-inlet / multi-sensor deployments;
+ * wind noise is incoherent between inlets a few metres apart, while
+ * infrasound is not; per block of WIND_BLOCK samples, every channel is
+ * transformed (Hann window, fixed-point FFT), and auto / cross spectra are
+ * summed per octave band and averaged over time; the magnitude-squared
+ * coherence |Sxy|^2 / (Sxx*Syy), averaged over all channel pairs, then
+ * flags incoherent bands and wind segments;
+ * the average channel weights each input by the inverse of its incoherent
+ * (residual) power, so a noisy inlet contributes less; the block energies
+ * use the dual 16-bit MAC (SMLALD) of the Cortex-M4
+ * ---------------------------------------------------------------------------
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include <math.h>
+#include <string.h>
+#include "stm32f4xx.h"
+#include "wind.h"
+#include "fft.h"
+
+#if (WIND_CHANNELS < 2)
+  #error "wind noise processing needs at least 2 channels"
+#endif
+
+/* Private define ------------------------------------------------------------*/
+#define WIND_IN_SHIFT          12       // delta scaling into the FFT input
+#define Q15_ONE                32768
+#define WIND_PI                3.14159265f
+
+/* Private variables ---------------------------------------------------------*/
+static uint16_t  blkRaw[WIND_CHANNELS][WIND_BLOCK];
+static int16_t   blkDelta[WIND_CHANNELS][WIND_BLOCK];
+static int16_t   blkRes[WIND_BLOCK] __ALIGNED(4);   // dual MAC access
+static int32_t   spec[WIND_CHANNELS][2*WIND_BLOCK];
+static int16_t   hann[WIND_BLOCK];
+static int64_t   sxx[WIND_CHANNELS][WIND_BANDS];
+static int64_t   sxyRe[WIND_PAIRS][WIND_BANDS];
+static int64_t   sxyIm[WIND_PAIRS][WIND_BANDS];
+static uint16_t  msc[WIND_BANDS];               // Q15, mean over pairs
+static uint16_t  weight[WIND_CHANNELS];         // Q15, sum = 1.0
+static uint32_t  blkIndex   = 0;
+static uint8_t   flags      = 0;
+static uint32_t  lastCycles = 0;
+
+/* Private prototypes --------------------------------------------------------*/
+static uint64_t  energy16      (const int16_t *pData, uint32_t n);
+static void      updateWeights (void);
+static void      updateBands   (void);
+static void      processBlock  (void);
+
+
+/* Code  ---------------------------------------------------------------------*/
+
+void  initWind (void)
+{
+    uint32_t  i;
+
+    initFft ();
+    for (i=0; i<WIND_BLOCK; i++)
+        hann[i] = (int16_t) ((0.5f - 0.5f * cosf (2.0f * WIND_PI * i / (WIND_BLOCK - 1))) * (Q15_ONE - 1));
+
+    for (i=0; i<WIND_CHANNELS; i++)
+        weight[i] = Q15_ONE / WIND_CHANNELS;
+    weight[WIND_CHANNELS-1] += Q15_ONE - (Q15_ONE / WIND_CHANNELS) * WIND_CHANNELS;
+
+    memset (sxx, 0, sizeof (sxx));
+    memset (sxyRe, 0, sizeof (sxyRe));
+    memset (sxyIm, 0, sizeof (sxyIm));
+    memset (msc, 0, sizeof (msc));
+    blkIndex = 0;
+    flags    = 0;
+}
+
+
+
+/* add one simultaneous sample per channel;
+ * returns the noise-weighted average of the channels
+ */
+uint16_t  windInput (const uint16_t *pSamples)
+{
+    uint32_t  ch, avg;
+
+    for (ch=0, avg=0; ch<WIND_CHANNELS; ch++)
+    {
+        blkRaw[ch][blkIndex] = pSamples[ch];
+        avg += (uint32_t) pSamples[ch] * weight[ch];
+    }
+
+    if (++blkIndex >= WIND_BLOCK)
+    {
+        blkIndex = 0;
+        processBlock ();
+    }
+
+    return ((uint16_t) ((avg + (Q15_ONE >> 1)) >> 15));
+}
+
+
+
+/* flags of the last block; bit <b> for an incoherent band,
+ * WIND_FLAG_WIND if the segment is considered wind noise
+ */
+uint8_t  windFlags (void)
+{
+    return (flags);
+}
+
+
+
+/* running coherence of a band, Q15
+ */
+uint16_t  windCoherence (uint8_t band)
+{
+    return ((band < WIND_BANDS) ? msc[band] : 0);
+}
+
+
+
+/* measure the block processing cost on a synthetic input: a coherent
+ * 1.5Hz signal on all channels, and uncorrelated noise that is strong on
+ * the last channel; returns cycles per block, and the share of the real-time
+ * budget (block duration at WIND_SAMPLE_HZ) in per-mille in <pBudget>;
+ * the stage is reset afterwards
+ */
+uint32_t  windBenchmark (uint32_t *pBudget)
+{
+    uint16_t  smpl[WIND_CHANNELS];
+    uint32_t  n, ch, seed;
+    int32_t   v;
+
+    initWind ();
+    for (n=0, seed=4711; n<4*WIND_BLOCK; n++)
+    {
+        v = (int32_t) (50.0f * sinf (2.0f * WIND_PI * 1.5f * n / WIND_SAMPLE_HZ));
+        for (ch=0; ch<WIND_CHANNELS; ch++)
+        {
+            seed     = seed * 1664525UL + 1013904223UL;
+            smpl[ch] = (uint16_t) (32768 + v + (((int32_t) (seed >> 26) - 32) >> ((ch == WIND_CHANNELS-1) ? 0 : 3)));
+        }
+        (void) windInput (smpl);
+    }
+    initWind ();
+
+    *pBudget = (uint32_t) (((uint64_t) lastCycles * 1000 * WIND_SAMPLE_HZ) / ((uint64_t) WIND_BLOCK * SystemCoreClock));
+    return (lastCycles);
+}
+
+
+
+/* sum of squares of int16 data, two samples per dual MAC;
+ * <n> must be even, the data 32-bit aligned
+ */
+static uint64_t  energy16 (const int16_t *pData, uint32_t n)
+{
+    const uint32_t  *p = (const uint32_t *) pData;
+    uint64_t         acc = 0;
+
+    for (n >>= 1; n; n--, p++)
+        acc = __SMLALD (*p, *p, acc);
+    return (acc);
+}
+
+
+
+/* inverse residual power weighting; the residual of a channel is its
+ * deviation from the (unweighted) channel mean, i.e. the incoherent part
+ */
+static void  updateWeights (void)
+{
+    float     inv[WIND_CHANNELS], sum;
+    uint32_t  ch, n, w;
+    int32_t   m, r;
+
+    for (ch=0, sum=0.0f; ch<WIND_CHANNELS; ch++)
+    {
+        for (n=0; n<WIND_BLOCK; n++)
+        {
+            for (m=0, r=0; r<WIND_CHANNELS; r++)
+                m += blkDelta[r][n];
+            r = blkDelta[ch][n] - m / WIND_CHANNELS;
+            blkRes[n] = (int16_t) ((r > 32767) ? 32767 : ((r < -32768) ? -32768 : r));
+        }
+        inv[ch] = 1.0f / ((float) energy16 (blkRes, WIND_BLOCK) + 1.0f);
+        sum    += inv[ch];
+    }
+
+    for (ch=0, w=0; ch<WIND_CHANNELS-1; ch++)
+    {
+        weight[ch] = (uint16_t) (inv[ch] / sum * Q15_ONE);
+        w         += weight[ch];
+    }
+    weight[WIND_CHANNELS-1] = (uint16_t) (Q15_ONE - w);
+}
+
+
+
+/* transform the block of each channel, accumulate the octave band auto
+ * and cross spectra, and update coherence and flags
+ */
+static void  updateBands (void)
+{
+    int32_t   *pa, *pb;
+    int64_t    pxx, pre, pim, ar, ai, br, bi;
+    uint32_t   ch, i, j, p, b, k, nWind;
+    float      c, cw;
+
+    for (ch=0; ch<WIND_CHANNELS; ch++)
+    {
+        for (k=0; k<WIND_BLOCK; k++)
+        {
+            // in int64: the scaled delta times the window exceeds 31 bits
+            spec[ch][2*k]   = (int32_t) ((int64_t) blkDelta[ch][k] * hann[k] * (1L << WIND_IN_SHIFT) >> 15);
+            spec[ch][2*k+1] = 0;
+        }
+        fftQ31 (spec[ch], WIND_BLOCK_BITS);
+
+        for (b=0; b<WIND_BANDS; b++)
+        {
+            for (k=(1UL << b), pxx=0; k<(2UL << b); k++)
+                pxx += (int64_t) spec[ch][2*k] * spec[ch][2*k] + (int64_t) spec[ch][2*k+1] * spec[ch][2*k+1];
+            sxx[ch][b] += (pxx - sxx[ch][b]) >> WIND_AVG_SHIFT;
+        }
+    }
+
+    for (b=0; b<WIND_BANDS; b++)
+    {
+        for (i=0, p=0, c=0.0f; i<WIND_CHANNELS; i++)
+            for (j=i+1; j<WIND_CHANNELS; j++, p++)
+            {
+                pa = spec[i];
+                pb = spec[j];
+                for (k=(1UL << b), pre=0, pim=0; k<(2UL << b); k++)
+                {
+                    ar   = pa[2*k];  ai = pa[2*k+1];
+                    br   = pb[2*k];  bi = pb[2*k+1];
+                    pre += ar * br + ai * bi;       // conj(Xi) * Xj
+                    pim += ar * bi - ai * br;
+                }
+                sxyRe[p][b] += (pre - sxyRe[p][b]) >> WIND_AVG_SHIFT;
+                sxyIm[p][b] += (pim - sxyIm[p][b]) >> WIND_AVG_SHIFT;
+
+                if ((sxx[i][b] > 0) && (sxx[j][b] > 0))
+                    c += ((float) sxyRe[p][b] * (float) sxyRe[p][b] + (float) sxyIm[p][b] * (float) sxyIm[p][b])
+                         / ((float) sxx[i][b] * (float) sxx[j][b]);
+            }
+        c      = c / WIND_PAIRS;
+        msc[b] = (c >= 1.0f) ? (Q15_ONE - 1) : (uint16_t) (c * Q15_ONE);
+    }
+
+    // flags: incoherent bands, and wind if the low bands are incoherent on average
+    for (b=0, flags=0, cw=0.0f, nWind=0; b<WIND_BANDS; b++)
+    {
+        if (msc[b] < WIND_MSC_LIMIT)
+            flags |= (1U << b);
+        if (b < WIND_WIND_BANDS)
+        {
+            cw += msc[b];
+            nWind++;
+        }
+    }
+    if (cw / nWind < WIND_MSC_LIMIT)
+        flags |= WIND_FLAG_WIND;
+}
+
+
+
+static void  processBlock (void)
+{
+    uint32_t  ch, n, sum, t0;
+    int32_t   d;
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL        |= DWT_CTRL_CYCCNTENA_Msk;
+    t0 = DWT->CYCCNT;
+
+    // mean removal, deltas saturated to 16 bit
+    for (ch=0; ch<WIND_CHANNELS; ch++)
+    {
+        for (n=0, sum=0; n<WIND_BLOCK; n++)
+            sum += blkRaw[ch][n];
+        sum >>= WIND_BLOCK_BITS;
+        for (n=0; n<WIND_BLOCK; n++)
+        {
+            d = (int32_t) blkRaw[ch][n] - (int32_t) sum;
+            blkDelta[ch][n] = (int16_t) ((d > 32767) ? 32767 : ((d < -32768) ? -32768 : d));
+        }
+    }
+
+    updateWeights ();
+    updateBands ();
+
+    lastCycles = DWT->CYCCNT - t0;
+}
@@ -0,0 +1,32 @@
+#ifndef WIND_H
+  #define WIND_H
+
+/* wind noise handling for multi-inlet / multi-sensor deployments;
+ * running magnitude-squared coherence between the channels per band,
+ * wind flags for incoherent segments, and a noise-weighted average channel
+ */
+
+/* ---------------- definitions ----------------
+ */
+#define WIND_CHANNELS          3
+#define WIND_PAIRS             ((WIND_CHANNELS * (WIND_CHANNELS-1)) / 2)
+#define WIND_BLOCK_BITS        8
+#define WIND_BLOCK             (1 << WIND_BLOCK_BITS)   // samples per block (~1.7s)
+#define WIND_BANDS             5        // octave bands, bins 1-2, 2-4 .. 16-32 (0.6 .. 19Hz)
+#define WIND_WIND_BANDS        3        // lower bands evaluated for the wind flag
+#define WIND_MSC_LIMIT         16384    // coherence below 0.5 (Q15) is "incoherent"
+#define WIND_AVG_SHIFT         2        // spectral averaging, alpha = 1/4
+#define WIND_SAMPLE_HZ         150
+
+#define WIND_FLAG_WIND         0x80     // segment flagged as wind noise
+                                        // bits 0..4: band incoherent
+
+/* ------------ function prototypes ------------
+ */
+void      initWind       (void);
+uint16_t  windInput      (const uint16_t *pSamples);
+uint8_t   windFlags      (void);
+uint16_t  windCoherence  (uint8_t band);
+uint32_t  windBenchmark  (uint32_t *pBudget);
+
+#endif  //  WIND_H
@@ -0,0 +1,56 @@
+/* ---------------------------------------------------------------------------
+ * cfgcheck - host tool for the infraSensor configuration file (infra.cfg);
+ * runs the firmware parser (src/config.c) over a file, fed in chunks of
+ * a few bytes to exercise the streaming, and prints the effective
+ * configuration as it is echoed into the data file header;
+ * exit code 1 if a line was rejected
+ *
+ * build:  cc -O2 -Isrc -o cfgcheck tools/cfgcheck.c src/config.c
+ * usage:  cfgcheck [-c <chunk size>] <infra.cfg>
+ * ---------------------------------------------------------------------------
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "config.h"
+
+
+int  main (int argc, char *argv[])
+{
+    Config     cfg;
+    CfgParser  cp;
+    FILE      *fp;
+    char       buf[CFG_CHUNK_SIZE], line[64];
+    size_t     chunk = 7, n;
+    unsigned   i, errors;
+
+    if ((argc == 4) && !strcmp (argv[1], "-c"))
+    {
+        chunk = (size_t) atoi (argv[2]);
+        argv += 2;
+        argc -= 2;
+    }
+    if ((argc != 2) || (chunk < 1) || (chunk > sizeof (buf)))
+    {
+        fprintf (stderr, "usage: cfgcheck [-c <chunk size 1..%u>] <infra.cfg>\n", (unsigned) sizeof (buf));
+        return 2;
+    }
+
+    fp = fopen (argv[1], "rb");
+    if (fp == NULL)
+    {
+        perror (argv[1]);
+        return 2;
+    }
+
+    configDefaults (&cfg);
+    configBegin (&cp, &cfg);
+    while ((n = fread (buf, 1, chunk, fp)) > 0)
+        configFeed (&cp, buf, (uint32_t) n);
+    errors = configEnd (&cp);
+    fclose (fp);
+
+    for (i=0; configFormat (&cfg, i, line) > 0; i++)
+        fputs (line, stdout);
+    return (errors > 0);
+}
@@ -0,0 +1,168 @@
+/* ---------------------------------------------------------------------------
+ * cfgtest - host test of the configuration parser (src/config.c);
+ * runs inline configuration texts through the firmware parser, fed in
+ * chunks of every size from 1 to CFG_CHUNK_SIZE bytes, so each line is
+ * split at every position, and compares the resulting configuration and
+ * error count against the expected ones (the defaults, changed by the
+ * case); covers CRLF line ends, comments, out-of-range numbers, over-long
+ * keys and values, and a last line without line feed
+ *
+ * build:  cc -O2 -Isrc -o cfgtest tools/cfgtest.c src/config.c
+ * usage:  cfgtest [-v]        exit code 1 on a mismatch
+ * ---------------------------------------------------------------------------
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "config.h"
+
+/* one case: the file text, and the expected changes to the defaults
+ */
+typedef struct
+{
+    const char  *name;
+    const char  *text;
+    uint16_t     errors;
+    void       (*expect) (Config *pCfg);
+} Case;
+
+
+static void  expCrlf (Config *pCfg)
+{
+    strcpy (pCfg->name, "ST01");
+    pCfg->decimation = 3;
+    pCfg->format     = CFG_FORMAT_DEC;
+}
+
+static void  expComments (Config *pCfg)
+{
+    pCfg->fsync = 128;
+    pCfg->hud   = 0;
+}
+
+static void  expRange (Config *pCfg)
+{
+    pCfg->lowRateHz = 10;
+    pCfg->calItems  = 1024;
+    pCfg->zoom      = 13;
+}
+
+static void  expLong (Config *pCfg)
+{
+    strcpy (pCfg->name, "ABCDEF");
+    pCfg->hud = 0;
+}
+
+static void  expNoLf (Config *pCfg)
+{
+    pCfg->serial = 1;
+    pCfg->zoom   = 5;
+}
+
+static void  expMalformed (Config *pCfg)
+{
+    pCfg->sensor = CFG_SENSOR_FILTERED;
+}
+
+static void  expTones (Config *pCfg)
+{
+    pCfg->tone[0].freq  = 125;
+    pCfg->tone[0].bw    = 40;
+    pCfg->tone[0].alarm = 5000;
+    pCfg->tone[1].freq  = 0;
+    pCfg->tone[1].bw    = 0;
+    pCfg->tone[3].freq  = 7499;
+    pCfg->tone[3].bw    = 1;
+    pCfg->tone[3].alarm = 99999999;
+}
+
+
+static const Case  cases[] =
+{
+    { "crlf",      "name = ST01\r\ndecimate = 3\r\n\r\nformat = dec\r\n", 0, expCrlf },
+    { "comments",  "# header\n\n   # indented\n\t# tab\nfsync = 128   # trailing\nhud=0#tight\n# fsync = 1\n",
+                   0, expComments },
+    { "range",     "lowrate = 11\nlowrate = 10\ndecimate = 2\nfsync = 0\nfsync = 4097\ncal_items = 1024\n"
+                   "zoom = 14\nzoom = 13\nserial = -1\nhud = 99999999999\nlowrate = 0x5\n", 8, expRange },
+    { "long",      "a_very_long_key_name = 1\nname = ABCDEFG\nname = ABCDEF\n"
+                   "fsync = 000000000000000000000000128\nhud = 0\n", 3, expLong },
+    { "no lf",     "serial = 1\nzoom = 5", 0, expNoLf },
+    { "no lf, bad", "serial = 1\nzoom = 5\nhud =", 1, expNoLf },
+    { "malformed", "display\n= sweep\ndisplay = sweep scroll\nsensor = filtered\nfoo = 1\nsensor # x\n",
+                   5, expMalformed },
+    { "tones",     "tone0 = 125,40,5000\ntone1 = 0\ntone2 = 7500,50,0\ntone2 = 300,3000,0\ntone2 = 300,50\n"
+                   "tone3 = 7499,1,99999999\ntone4 = 100,50,0\ntone = 0\n", 5, expTones },
+};
+
+
+/* the lines of configFormat that differ between <pa> and <pb>
+ */
+static void  diff (const Config *pa, const Config *pb)
+{
+    char      la[64], lb[64];
+    uint32_t  i;
+
+    for (i=0; (configFormat (pa, i, la) > 0) && (configFormat (pb, i, lb) > 0); i++)
+    {
+        if (strcmp (la, lb))
+            printf ("     got      %s     expected %s", la, lb);
+    }
+}
+
+
+
+/* a case at all chunk sizes; returns the number of failed runs
+ */
+static unsigned  runCase (const Case *pc, int verbose)
+{
+    Config     cfg, exp;
+    CfgParser  cp;
+    size_t     chunk, len, pos, n;
+    unsigned   fails = 0;
+
+    configDefaults (&exp);
+    if (pc->expect != NULL)
+        pc->expect (&exp);
+    exp.errors = pc->errors;
+    exp.loaded = 1;
+
+    len = strlen (pc->text);
+    for (chunk=1; chunk<=CFG_CHUNK_SIZE; chunk++)
+    {
+        configDefaults (&cfg);
+        configBegin (&cp, &cfg);
+        for (pos=0; pos<len; pos+=n)
+        {
+            n = (len - pos < chunk) ? len - pos : chunk;
+            configFeed (&cp, pc->text + pos, (uint32_t) n);
+        }
+        (void) configEnd (&cp);
+
+        if (memcmp (&cfg, &exp, sizeof (Config)))
+        {
+            if (fails == 0)
+            {
+                printf ("FAIL %s, chunk %u\n", pc->name, (unsigned) chunk);
+                diff (&cfg, &exp);
+            }
+            fails++;
+        }
+    }
+    if (verbose || fails)
+        printf ("%-4s %-10s %u errors, %u of %u chunk sizes failed\n", fails ? "FAIL" : "ok",
+                pc->name, pc->errors, fails, (unsigned) CFG_CHUNK_SIZE);
+    return (fails);
+}
+
+
+
+int  main (int argc, char *argv[])
+{
+    unsigned  i, fails = 0;
+    int       verbose = (argc > 1) && !strcmp (argv[1], "-v");
+
+    for (i=0; i<sizeof (cases) / sizeof (cases[0]); i++)
+        fails += runCase (&cases[i], verbose);
+    printf ("%u cases, %u failed runs\n", (unsigned) (sizeof (cases) / sizeof (cases[0])), fails);
+    return (fails > 0);
+}
@@ -0,0 +1,111 @@
+/* ---------------------------------------------------------------------------
+ * doatest - host test of the direction of arrival stage (src/doa.c);
+ * generates synthetic plane waves across the array of DOA_POSITIONS (a
+ * band-limited sum of sines in 0.7 .. 4.6Hz plus uniform noise, each
+ * channel delayed by its position), runs one analysis window per case
+ * through the firmware code, and checks back-azimuth and apparent
+ * velocity against the true values; the device header comes from the
+ * host stand-in in tools/lcdsim
+ *
+ * build:  cc -O2 -Itools/lcdsim -Isrc -o doatest tools/doatest.c src/doa.c src/fft.c -lm
+ * usage:  doatest [-v]        exit code 1 if a case is out of tolerance
+ * ---------------------------------------------------------------------------
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "stm32f4xx.h"
+#include "doa.h"
+
+#define AZ_STEP        15.0f    // azimuth sweep step, degrees
+#define AZ_TOL         4.0f     // max. azimuth error, degrees (noise limited at 800m/s)
+#define VEL_TOL        0.05f    // max. relative velocity error
+#define NOISE_LSB      8        // uniform noise span, LSB
+#define PI             3.14159265358979
+
+// the DWT stand-in; the cycle count is not checked here
+DWT_Type        lcdSimDwt;
+CoreDebug_Type  lcdSimCoreDebug;
+uint32_t        SystemCoreClock = 168000000;
+
+static const float  velocities[] = { 300.0f, 340.0f, 500.0f, 800.0f };
+static const float  pos[DOA_CHANNELS][2] = DOA_POSITIONS;
+
+
+/* one window of a plane wave from <az> (degrees) with <vel> (m/s);
+ * returns DOA_RET_OK and the estimate in <pr>
+ */
+static unsigned  runCase (float az, float vel, DoaResult *pr)
+{
+    static const double  fq[5]  = { 0.7, 1.3, 2.1, 3.4, 4.6 };
+    static const double  amp[5] = { 40.0, 30.0, 25.0, 15.0, 10.0 };
+    uint16_t  smpl[DOA_CHANNELS];
+    double    sx, sy, t, v;
+    uint32_t  n, ch, k, ret, seed;
+
+    sx   = -sin (az * PI / 180.0) / vel;
+    sy   = -cos (az * PI / 180.0) / vel;
+    seed = 12345;
+
+    initDoa ();
+    for (n=0, ret=0; n<DOA_WIN; n++)
+    {
+        for (ch=0; ch<DOA_CHANNELS; ch++)
+        {
+            t = (double) n / DOA_SAMPLE_HZ - (sx * pos[ch][0] + sy * pos[ch][1]);
+            for (k=0, v=32768.0; k<5; k++)
+                v += amp[k] * sin (2.0 * PI * fq[k] * t + k);
+            seed = seed * 1664525UL + 1013904223UL;
+            v   += (double) ((seed >> 24) % NOISE_LSB) - (NOISE_LSB - 1) / 2.0;
+            smpl[ch] = (uint16_t) lround (v);
+        }
+        ret = doaInput (smpl);
+    }
+    if (!ret)
+        return (DOA_RET_NONE);
+    return (doaGetResult (pr));
+}
+
+
+
+int  main (int argc, char *argv[])
+{
+    DoaResult  res;
+    unsigned   i, cases = 0, fails = 0;
+    float      az, eAz, eVel, maxAz = 0.0f, maxVel = 0.0f;
+    int        verbose = (argc > 1) && !strcmp (argv[1], "-v");
+
+    for (i=0; i<sizeof (velocities) / sizeof (velocities[0]); i++)
+    {
+        for (az=0.0f; az<360.0f; az+=AZ_STEP)
+        {
+            cases++;
+            memset (&res, 0, sizeof (res));
+            if (runCase (az, velocities[i], &res) != DOA_RET_OK)
+            {
+                printf ("FAIL az %5.1f vel %5.0f: no estimate\n", az, velocities[i]);
+                fails++;
+                continue;
+            }
+            eAz  = fabsf (res.azimuth - az);
+            if (eAz > 180.0f)
+                eAz = 360.0f - eAz;
+            eVel = fabsf (res.velocity - velocities[i]) / velocities[i];
+            if (eAz > maxAz)
+                maxAz = eAz;
+            if (eVel > maxVel)
+                maxVel = eVel;
+            if ((eAz > AZ_TOL) || (eVel > VEL_TOL))
+                fails++;
+            if (verbose || (eAz > AZ_TOL) || (eVel > VEL_TOL))
+                printf ("%s az %5.1f vel %5.0f: %5.1f deg %6.1f m/s c=%.2f\n",
+                        ((eAz > AZ_TOL) || (eVel > VEL_TOL)) ? "FAIL" : "ok  ",
+                        az, velocities[i], res.azimuth, res.velocity, res.correlation);
+        }
+    }
+
+    printf ("%u cases, %u failed; max. error %.2f deg, %.1f%% velocity (tolerance %.1f deg, %.0f%%)\n",
+            cases, fails, maxAz, maxVel * 100.0f, AZ_TOL, VEL_TOL * 100.0f);
+    return (fails > 0);
+}
@@ -0,0 +1,352 @@
+/* ---------------------------------------------------------------------------
+ * SSD2119 controller emulation for host builds of the LCD driver;
+ * the driver's bus macros map to lcdSimCmd / lcdSimWrite / lcdSimRead;
+ * GRAM writes go to the cursor (R4Eh / R4Fh), which moves according to
+ * the entry mode (R11h: ID0 horizontal, ID1 vertical direction, AM address
+ * mode), wrapping inside the window (R44h..R46h); snapshots show the panel
+ * as scrolled by R41h;
+ * every bus access is counted and advances the emulated cycle counter, and
+ * lcdSimBegin / lcdSimEnd attribute the counts to named drawing calls
+ * ---------------------------------------------------------------------------
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdio.h>
+#include <string.h>
+#include "stm32f4xx.h"
+#include "lcd_sim.h"
+
+/* Private define ------------------------------------------------------------*/
+#define REG_ENTRY_MODE         0x11
+#define REG_RAM_DATA           0x22
+#define REG_V_SCROLL           0x41
+#define REG_V_RAM_POS          0x44
+#define REG_H_RAM_START        0x45
+#define REG_H_RAM_END          0x46
+#define REG_X_RAM_ADDR         0x4E
+#define REG_Y_RAM_ADDR         0x4F
+
+#define EM_AM                  0x0008
+#define EM_ID0                 0x0010
+#define EM_ID1                 0x0020
+
+typedef struct
+{
+    const char  *name;
+    uint32_t     calls;
+    LcdSimCount  count;
+    uint64_t     cycles;
+} ProfEntry;
+
+/* Private variables ---------------------------------------------------------*/
+DWT_Type           lcdSimDwt;
+CoreDebug_Type     lcdSimCoreDebug;
+uint32_t           SystemCoreClock = 168000000;
+
+static uint16_t    gram[LCD_SIM_HEIGHT][LCD_SIM_WIDTH];
+static uint16_t    regs[256];
+static uint16_t    regIndex;
+static uint16_t    curX, curY;
+static uint32_t    busCycles = LCD_SIM_BUS_CYCLES;
+static LcdSimCount count;
+
+static ProfEntry   prof[LCD_SIM_MAX_PROF];
+static uint32_t    profUsed   = 0;
+static int32_t     profActive = -1;
+static LcdSimCount profStart;
+static uint32_t    profCycles;
+
+/* Private prototypes --------------------------------------------------------*/
+static void  advance   (void);
+static void  countSub  (LcdSimCount *pDst, const LcdSimCount *pA, const LcdSimCount *pB);
+
+
+/* Code  ---------------------------------------------------------------------*/
+
+/* power-on state: full screen window, default entry mode, black GRAM;
+ * <cycles> per bus access, 0 for the default
+ */
+void  lcdSimReset (uint32_t cycles)
+{
+    memset (gram, 0, sizeof (gram));
+    memset (regs, 0, sizeof (regs));
+    memset (&count, 0, sizeof (count));
+    memset (prof, 0, sizeof (prof));
+    profUsed   = 0;
+    profActive = -1;
+
+    regs[REG_ENTRY_MODE]  = 0x6830;
+    regs[REG_V_RAM_POS]   = (LCD_SIM_HEIGHT - 1) << 8;
+    regs[REG_H_RAM_START] = 0;
+    regs[REG_H_RAM_END]   = LCD_SIM_WIDTH - 1;
+    regIndex = curX = curY = 0;
+    busCycles = cycles ? cycles : LCD_SIM_BUS_CYCLES;
+}
+
+
+
+/* index register write
+ */
+void  lcdSimCmd (uint16_t reg)
+{
+    regIndex = reg & 0xFF;
+    count.cmds++;
+    lcdSimDwt.CYCCNT += busCycles;
+}
+
+
+
+/* data write, to GRAM or to the selected register
+ */
+void  lcdSimWrite (uint16_t data)
+{
+    lcdSimDwt.CYCCNT += busCycles;
+    if (regIndex == REG_RAM_DATA)
+    {
+        if ((curX < LCD_SIM_WIDTH) && (curY < LCD_SIM_HEIGHT))
+            gram[curY][curX] = data;
+        count.pixels++;
+        advance ();
+        return;
+    }
+
+    regs[regIndex] = data;
+    count.regs++;
+    switch (regIndex)
+    {
+        case REG_X_RAM_ADDR:
+            curX = data;
+            break;
+        case REG_Y_RAM_ADDR:
+            curY = data;
+            break;
+        case REG_V_RAM_POS:
+        case REG_H_RAM_START:
+        case REG_H_RAM_END:
+            count.windows++;
+            break;
+    }
+}
+
+
+
+/* data read; GRAM reads do not advance the cursor here
+ */
+uint16_t  lcdSimRead (void)
+{
+    lcdSimDwt.CYCCNT += busCycles;
+    count.reads++;
+    if (regIndex == REG_RAM_DATA)
+        return (((curX < LCD_SIM_WIDTH) && (curY < LCD_SIM_HEIGHT)) ? gram[curY][curX] : 0);
+    return (regs[regIndex]);
+}
+
+
+
+/* GRAM content (not scrolled)
+ */
+uint16_t  lcdSimPixel (uint16_t x, uint16_t y)
+{
+    return (((x < LCD_SIM_WIDTH) && (y < LCD_SIM_HEIGHT)) ? gram[y][x] : 0);
+}
+
+
+
+void  lcdSimCounts (LcdSimCount *pCount)
+{
+    *pCount = count;
+}
+
+
+
+/* start attributing bus accesses to the drawing call <name>
+ * (a string literal; calls with the same name are summed up)
+ */
+void  lcdSimBegin (const char *name)
+{
+    uint32_t  i;
+
+    for (i=0; i<profUsed; i++)
+        if (strcmp (prof[i].name, name) == 0)
+            break;
+    if (i == profUsed)
+    {
+        if (profUsed >= LCD_SIM_MAX_PROF)
+            return;
+        prof[profUsed++].name = name;
+    }
+    profActive = i;
+    profStart  = count;
+    profCycles = lcdSimDwt.CYCCNT;
+}
+
+
+
+void  lcdSimEnd (void)
+{
+    LcdSimCount  d;
+    ProfEntry   *pe;
+
+    if (profActive < 0)
+        return;
+    pe = &prof[profActive];
+    countSub (&d, &count, &profStart);
+    pe->calls++;
+    pe->count.cmds    += d.cmds;
+    pe->count.regs    += d.regs;
+    pe->count.pixels  += d.pixels;
+    pe->count.reads   += d.reads;
+    pe->count.windows += d.windows;
+    pe->cycles        += lcdSimDwt.CYCCNT - profCycles;
+    profActive = -1;
+}
+
+
+
+/* per-call cost table: bus accesses per call, and the bus time at the
+ * emulated cycles per access
+ */
+void  lcdSimReport (FILE *fp)
+{
+    ProfEntry  *pe;
+    uint32_t    i, n;
+
+    fprintf (fp, "%-24s %6s %8s %8s %8s %6s %6s %9s\n",
+             "call", "calls", "cmd", "reg", "pixel", "read", "win", "us/call");
+    for (i=0; i<profUsed; i++)
+    {
+        pe = &prof[i];
+        n  = pe->calls ? pe->calls : 1;
+        fprintf (fp, "%-24s %6u %8.1f %8.1f %8.1f %6.1f %6.1f %9.2f\n", pe->name, pe->calls,
+                 (double) pe->count.cmds / n, (double) pe->count.regs / n,
+                 (double) pe->count.pixels / n, (double) pe->count.reads / n,
+                 (double) pe->count.windows / n,
+                 (double) pe->cycles / n * 1e6 / SystemCoreClock);
+    }
+}
+
+
+
+/* write the panel view (GRAM rows rotated by the vertical scroll) as
+ * binary PPM; returns 0, or -1 on error
+ */
+int  lcdSimWritePpm (const char *path)
+{
+    FILE      *fp;
+    uint32_t   x, y, row;
+    uint16_t   c;
+    uint8_t    rgb[3];
+
+    fp = fopen (path, "wb");
+    if (fp == NULL)
+        return (-1);
+
+    fprintf (fp, "P6\n%d %d\n255\n", LCD_SIM_WIDTH, LCD_SIM_HEIGHT);
+    for (y=0; y<LCD_SIM_HEIGHT; y++)
+    {
+        row = (y + regs[REG_V_SCROLL]) % LCD_SIM_HEIGHT;
+        for (x=0; x<LCD_SIM_WIDTH; x++)
+        {
+            c      = gram[row][x];
+            rgb[0] = (uint8_t) (((c >> 11) & 0x1F) << 3);
+            rgb[1] = (uint8_t) (((c >> 5) & 0x3F) << 2);
+            rgb[2] = (uint8_t) ((c & 0x1F) << 3);
+            fwrite (rgb, 1, 3, fp);
+        }
+    }
+    return (fclose (fp) ? -1 : 0);
+}
+
+
+
+/* compare the panel view with a PPM written by lcdSimWritePpm;
+ * returns the number of differing pixels, or -1 on error
+ */
+long  lcdSimComparePpm (const char *path)
+{
+    FILE      *fp;
+    uint32_t   x, y, row;
+    uint16_t   c;
+    uint8_t    rgb[3];
+    int        w, h, max;
+    long       diff;
+
+    fp = fopen (path, "rb");
+    if (fp == NULL)
+        return (-1);
+    if ((fscanf (fp, "P6 %d %d %d", &w, &h, &max) != 3) || (fgetc (fp) == EOF) ||
+        (w != LCD_SIM_WIDTH) || (h != LCD_SIM_HEIGHT) || (max != 255))
+    {
+        fclose (fp);
+        return (-1);
+    }
+
+    for (y=0, diff=0; y<LCD_SIM_HEIGHT; y++)
+    {
+        row = (y + regs[REG_V_SCROLL]) % LCD_SIM_HEIGHT;
+        for (x=0; x<LCD_SIM_WIDTH; x++)
+        {
+            if (fread (rgb, 1, 3, fp) != 3)
+            {
+                fclose (fp);
+                return (-1);
+            }
+            c = (uint16_t) (((rgb[0] >> 3) << 11) | ((rgb[1] >> 2) << 5) | (rgb[2] >> 3));
+            if (c != gram[row][x])
+                diff++;
+        }
+    }
+    fclose (fp);
+    return (diff);
+}
+
+
+
+/* cursor auto-increment after a GRAM write; the address moves along the
+ * window row (AM=0) or column (AM=1), and wraps to the next one
+ */
+static void  advance (void)
+{
+    uint16_t  em, hs, he, vs, ve;
+    int32_t   dx, dy;
+
+    em = regs[REG_ENTRY_MODE];
+    hs = regs[REG_H_RAM_START];
+    he = regs[REG_H_RAM_END];
+    vs = regs[REG_V_RAM_POS] & 0xFF;
+    ve = regs[REG_V_RAM_POS] >> 8;
+    dx = (em & EM_ID0) ? 1 : -1;
+    dy = (em & EM_ID1) ? 1 : -1;
+
+    if (!(em & EM_AM))
+    {
+        if ((dx > 0) ? (curX >= he) : (curX <= hs))
+        {
+            curX  = (dx > 0) ? hs : he;
+            curY  = ((dy > 0) ? (curY >= ve) : (curY <= vs)) ? ((dy > 0) ? vs : ve) : curY + dy;
+        }
+        else
+            curX += dx;
+    }
+    else
+    {
+        if ((dy > 0) ? (curY >= ve) : (curY <= vs))
+        {
+            curY  = (dy > 0) ? vs : ve;
+            curX  = ((dx > 0) ? (curX >= he) : (curX <= hs)) ? ((dx > 0) ? hs : he) : curX + dx;
+        }
+        else
+            curY += dy;
+    }
+}
+
+
+
+static void  countSub (LcdSimCount *pDst, const LcdSimCount *pA, const LcdSimCount *pB)
+{
+    pDst->cmds    = pA->cmds    - pB->cmds;
+    pDst->regs    = pA->regs    - pB->regs;
+    pDst->pixels  = pA->pixels  - pB->pixels;
+    pDst->reads   = pA->reads   - pB->reads;
+    pDst->windows = pA->windows - pB->windows;
+}
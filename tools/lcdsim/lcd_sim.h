@@ -0,0 +1,45 @@
+#ifndef LCD_SIM_H
+  #define LCD_SIM_H
+
+/* host emulation of the SSD2119 controller behind the FSMC, for the
+ * LCD_HOST_SIM build of the LCD driver: register file, GRAM cursor and
+ * window, entry mode auto-increment, and vertical scroll, into a 320x240
+ * RGB565 frame buffer; bus accesses are counted per drawing call
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* ---------------- definitions ----------------
+ */
+#define LCD_SIM_WIDTH          320
+#define LCD_SIM_HEIGHT         240
+#define LCD_SIM_BUS_CYCLES     12       // default CPU cycles per FSMC access
+#define LCD_SIM_MAX_PROF       32       // profiled call names
+
+typedef struct
+{
+    uint32_t  cmds;                     // index writes
+    uint32_t  regs;                     // register data writes
+    uint32_t  pixels;                   // GRAM writes
+    uint32_t  reads;
+    uint32_t  windows;                  // window register writes
+} LcdSimCount;
+
+/* ------------ function prototypes ------------
+ */
+void      lcdSimReset     (uint32_t cycles);
+void      lcdSimCmd       (uint16_t reg);
+void      lcdSimWrite     (uint16_t data);
+uint16_t  lcdSimRead      (void);
+
+uint16_t  lcdSimPixel     (uint16_t x, uint16_t y);
+void      lcdSimCounts    (LcdSimCount *pCount);
+void      lcdSimBegin     (const char *name);
+void      lcdSimEnd       (void);
+void      lcdSimReport    (FILE *fp);
+
+int       lcdSimWritePpm  (const char *path);
+long      lcdSimComparePpm (const char *path);
+
+#endif  //  LCD_SIM_H
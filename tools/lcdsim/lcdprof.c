@@ -0,0 +1,150 @@
+/* ---------------------------------------------------------------------------
+ * lcdprof - host run of the LCD driver and the strip chart renderer against
+ * the SSD2119 emulation; draws a fixed set of scenes, reports the bus
+ * accesses per drawing call, and writes or compares one snapshot per
+ * scene; no reference snapshots are kept in the tree, write them (-o)
+ * from the unchanged tree before a change
+ *
+ * build:  cc -O2 -DLCD_HOST_SIM -Itools/lcdsim -Isrc -Isrc/F4_Dis -o lcdprof \
+ *            tools/lcdsim/lcdprof.c tools/lcdsim/lcd_sim.c \
+ *            src/F4_Dis/stm32f4_discovery_lcd.c src/F4_Dis/fonts.c src/render.c -lm
+ * usage:  lcdprof [-c cycles/access] [-o prefix] [-g prefix]
+ *         -o writes <prefix>_<scene>.ppm, -g compares against those;
+ *         the exit code is 1 if any scene differs from its snapshot
+ * ---------------------------------------------------------------------------
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "stm32f4xx.h"
+#include "main.h"
+#include "stm32f4_discovery_lcd.h"
+#include "render.h"
+#include "lcd_sim.h"
+
+#define PROF(name, call)      do { lcdSimBegin (name); call; lcdSimEnd (); } while (0)
+
+static const char  *outPrefix    = NULL;
+static const char  *goldenPrefix = NULL;
+static int          failed       = 0;
+
+
+/* write and / or check the snapshot of a scene
+ */
+static void  snapshot (const char *scene)
+{
+    char  path[256];
+    long  diff;
+
+    if (outPrefix != NULL)
+    {
+        snprintf (path, sizeof (path), "%s_%s.ppm", outPrefix, scene);
+        if (lcdSimWritePpm (path) != 0)
+            fprintf (stderr, "cannot write %s\n", path);
+    }
+    if (goldenPrefix != NULL)
+    {
+        snprintf (path, sizeof (path), "%s_%s.ppm", goldenPrefix, scene);
+        diff = lcdSimComparePpm (path);
+        printf ("%-8s %s\n", scene, (diff == 0) ? "ok" : "DIFFERS");
+        if (diff < 0)
+            fprintf (stderr, "cannot read %s\n", path);
+        else if (diff > 0)
+            fprintf (stderr, "%s: %ld pixels differ\n", scene, diff);
+        if (diff != 0)
+            failed = 1;
+    }
+}
+
+
+static void  sceneText (void)
+{
+    PROF ("LCD_Clear", LCD_Clear (LCD_COLOR_BLACK));
+    LCD_SetColors (LCD_COLOR_WHITE, LCD_COLOR_BLACK);
+    PROF ("LCD_DisplayStringLine", LCD_DisplayStringLine (LINE(0), (uint8_t *) "Infrasound sensing Application V1.0"));
+    PROF ("LCD_DisplayStringLineDiff", LCD_DisplayStringLineDiff (LINE(2), (uint8_t *) "samples 000123 ovr 0"));
+    PROF ("LCD_DisplayStringLineDiff", LCD_DisplayStringLineDiff (LINE(2), (uint8_t *) "samples 000124 ovr 0"));
+    PROF ("LCD_DisplayChar", LCD_DisplayChar (LINE(4), 0, 'A'));
+    PROF ("LCD_ClearLine", LCD_ClearLine (LINE(4)));
+    snapshot ("text");
+}
+
+
+static void  scenePrimitives (void)
+{
+    LCD_Clear (LCD_COLOR_BLACK);
+    LCD_SetColors (LCD_COLOR_GREEN, LCD_COLOR_BLACK);
+    PROF ("LCD_DrawLine (h)", LCD_DrawLine (10, 120, 290, LCD_DIR_HORIZONTAL));
+    PROF ("LCD_DrawLine (v)", LCD_DrawLine (160, 20, 200, LCD_DIR_VERTICAL));
+    PROF ("LCD_DrawUniLine", LCD_DrawUniLine (10, 20, 300, 220));
+    PROF ("LCD_DrawRect", LCD_DrawRect (20, 30, 50, 80));
+    PROF ("LCD_DrawCircle", LCD_DrawCircle (240, 80, 40));
+    PROF ("LCD_DrawFullRect", LCD_DrawFullRect (200, 150, 60, 40));
+    PROF ("LCD_DmaFill", LCD_DmaFill (40, 160, 100, 50, LCD_COLOR_BLUE));
+    snapshot ("prims");
+}
+
+
+/* chart scenes: 30 s of a 0.2 Hz sine plus a spike, fed at the sample
+ * rate, with the emulated time advanced by one frame per render call
+ */
+static void  sceneChart (const char *scene, uint8_t mode)
+{
+    uint32_t           n, f, period;
+    uint16_t           v;
+    volatile uint32_t  yield = 0;
+
+    LCD_Clear (LCD_COLOR_BLACK);
+    initRender (32768);
+    renderSetMode (mode);
+    period = SystemCoreClock / RENDER_FPS;
+
+    for (f=0, n=0; f<30*RENDER_FPS; f++)
+    {
+        for ( ; n < (f + 1) * 150 / RENDER_FPS; n++)
+        {
+            v = (uint16_t) (32768 + 40.0 * sin (2.0 * 3.14159265 * 0.2 * n / 150.0));
+            if (n == 2000)
+                v += 120;
+            renderInput (v);
+        }
+        lcdSimDwt.CYCCNT += period;
+        PROF ("renderTask", renderTask (&yield));
+    }
+    snapshot (scene);
+    renderSetMode (RENDER_MODE_SWEEP);
+}
+
+
+int  main (int argc, char *argv[])
+{
+    uint32_t  cycles = 0;
+    int       i;
+
+    for (i=1; i<argc; i++)
+    {
+        if ((strcmp (argv[i], "-c") == 0) && (i+1 < argc))
+            cycles = (uint32_t) atoi (argv[++i]);
+        else if ((strcmp (argv[i], "-o") == 0) && (i+1 < argc))
+            outPrefix = argv[++i];
+        else if ((strcmp (argv[i], "-g") == 0) && (i+1 < argc))
+            goldenPrefix = argv[++i];
+        else
+        {
+            fprintf (stderr, "usage: %s [-c cycles/access] [-o prefix] [-g prefix]\n", argv[0]);
+            return (2);
+        }
+    }
+
+    lcdSimReset (cycles);
+    PROF ("LCD_Init", STM32f4_Discovery_LCD_Init ());
+
+    sceneText ();
+    scenePrimitives ();
+    sceneChart ("sweep", RENDER_MODE_SWEEP);
+    sceneChart ("scroll", RENDER_MODE_SCROLL);
+
+    lcdSimReport (stdout);
+    return (failed);
+}
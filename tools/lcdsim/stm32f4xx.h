@@ -0,0 +1,41 @@
+/* ---------------------------------------------------------------------------
+ * host stand-in for the device header, used instead of it by the
+ * LCD_HOST_SIM build (-I tools/lcdsim first); provides just what the LCD
+ * driver and the renderer need; the cycle counter is advanced by the
+ * controller emulation, per bus access
+ * ---------------------------------------------------------------------------
+ */
+#ifndef STM32F4XX_H
+  #define STM32F4XX_H
+
+#include <stdint.h>
+
+#define __IO                   volatile
+
+typedef uint32_t               u32;
+typedef uint16_t               u16;
+typedef uint8_t                u8;
+typedef volatile uint32_t      vu32;
+typedef volatile uint16_t      vu16;
+
+typedef struct
+{
+    volatile uint32_t  CTRL;
+    volatile uint32_t  CYCCNT;
+} DWT_Type;
+
+typedef struct
+{
+    volatile uint32_t  DEMCR;
+} CoreDebug_Type;
+
+extern DWT_Type        lcdSimDwt;
+extern CoreDebug_Type  lcdSimCoreDebug;
+extern uint32_t        SystemCoreClock;
+
+#define DWT                         (&lcdSimDwt)
+#define CoreDebug                   (&lcdSimCoreDebug)
+#define DWT_CTRL_CYCCNTENA_Msk      0x00000001UL
+#define CoreDebug_DEMCR_TRCENA_Msk  0x01000000UL
+
+#endif  //  STM32F4XX_H
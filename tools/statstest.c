@@ -0,0 +1,185 @@
+/* ---------------------------------------------------------------------------
+ * statstest - host test of the interval statistics engine (src/stats.c);
+ * feeds an hour of synthetic samples (a slow drift, a 0.2Hz wave and
+ * noise, with some spikes) through the firmware code, and checks every
+ * 1s, 10s and 60s record against min / max / mean / RMS computed directly
+ * from the samples of its interval, and the record times and counts;
+ * each case is a sequence of input rates, as the firmware switches them:
+ *   full       150Hz throughout
+ *   decimated  the boot buffer at 150Hz, then 50Hz (decimate = 3)
+ *   low-rate   150Hz, 10 minutes of low-rate mode at 3Hz, and 150Hz again
+ * the device header comes from the host stand-in in tools/lcdsim
+ *
+ * build:  cc -O2 -Itools/lcdsim -Isrc -o statstest tools/statstest.c src/stats.c -lm
+ * usage:  statstest [-v]      exit code 1 if a record is off
+ * ---------------------------------------------------------------------------
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "stm32f4xx.h"
+#include "stats.h"
+
+#define SECONDS        3600     // test length
+#define MAX_ITEMS      (SECONDS * STATS_RATE_HZ)
+#define MAX_SEGMENTS   4
+#define MEAN_TOL       0.01     // max. mean error, LSB
+#define RMS_TOL        0.01     // max. RMS error, LSB
+#define PI             3.14159265358979
+
+/* a run of samples at one rate; <items> 0 fills up to SECONDS
+ */
+typedef struct
+{
+    uint16_t  hz;
+    uint32_t  items;
+} Segment;
+
+typedef struct
+{
+    const char  *name;
+    Segment      seg[MAX_SEGMENTS];
+} Case;
+
+static const Case  cases[] =
+{
+    { "full",      { { 150, 0 } } },
+    { "decimated", { { 150, 2000 }, { 50, 0 } } },
+    { "low-rate",  { { 150, 90001 }, { 3, 1801 }, { 150, 0 } } },
+};
+
+static const uint32_t  duration[STATS_LEVELS] = { 1, STATS_ROLLUP_1, STATS_ROLLUP_1 * STATS_ROLLUP_2 };
+static uint16_t        smpl[MAX_ITEMS];
+static uint16_t        rate[MAX_ITEMS];        // of each sample
+static uint32_t        first[SECONDS + 1];     // first sample of each second
+static uint32_t        items;
+static uint32_t        records[STATS_LEVELS];
+
+
+/* generate the samples of case <pc>; a sample belongs to the second it
+ * is taken in (the engine closes an interval with the sample that
+ * completes it, the next one starts the next interval)
+ */
+static void  generate (const Case *pc)
+{
+    uint32_t  i, s, n, ticks, step, sec, seed = 4711;
+    double    t, v;
+
+    items = 0;
+    ticks = 0;
+    sec   = 0;
+    for (s=0; (s < MAX_SEGMENTS) && (pc->seg[s].hz > 0); s++)
+    {
+        step = STATS_TICKS_S / pc->seg[s].hz;
+        n    = pc->seg[s].items ? pc->seg[s].items : (SECONDS * STATS_TICKS_S - ticks + step - 1) / step;
+        for (i=0; i<n; i++, items++)
+        {
+            t     = (double) ticks / STATS_TICKS_S;
+            seed  = seed * 1664525UL + 1013904223UL;
+            v     = 30000.0 + 2.0 * t + 200.0 * sin (2.0 * PI * 0.2 * t) + (double) (seed >> 26) - 31.5;
+            if ((seed & 0xFFFF) == 0x1234)
+                v += 5000.0;            // rare spike, for min / max
+            smpl[items] = (uint16_t) lround (v);
+            rate[items] = pc->seg[s].hz;
+            while ((sec <= SECONDS) && (sec * STATS_TICKS_S <= ticks))
+                first[sec++] = items;
+            ticks      += step;
+        }
+    }
+    while (sec <= SECONDS)
+        first[sec++] = items;
+}
+
+
+
+/* check one record against the samples of its interval; returns 1 if off
+ */
+static unsigned  check (const StatsRecord *pr, int verbose)
+{
+    uint32_t  i, from, to, min = 0xFFFF, max = 0;
+    double    sum = 0.0, sumsq = 0.0, mean, rms;
+    char      line[80];
+
+    if ((pr->level >= STATS_LEVELS) || (pr->time % duration[pr->level])
+        || (pr->time + duration[pr->level] > SECONDS))
+    {
+        printf ("FAIL level %u time %lu: not an interval\n", pr->level, (unsigned long) pr->time);
+        return (1);
+    }
+    records[pr->level]++;
+    from = first[pr->time];
+    to   = first[pr->time + duration[pr->level]];
+    for (i=from; i<to; i++)
+    {
+        if (smpl[i] < min)
+            min = smpl[i];
+        if (smpl[i] > max)
+            max = smpl[i];
+        sum += smpl[i];
+    }
+    mean = sum / (to - from);
+    for (i=from; i<to; i++)
+        sumsq += (smpl[i] - mean) * (smpl[i] - mean);
+    rms = sqrt (sumsq / (to - from));
+
+    (void) statsFormat ((StatsRecord *) pr, line);
+    if ((pr->n != to - from) || (pr->min != min) || (pr->max != max)
+        || (fabs (pr->mean - mean) > MEAN_TOL) || (fabs (pr->rms - rms) > RMS_TOL))
+    {
+        printf ("FAIL %s     expected n %lu min %lu max %lu mean %.3f rms %.3f\n", line,
+                (unsigned long) (to - from), (unsigned long) min, (unsigned long) max, mean, rms);
+        return (1);
+    }
+    if (verbose && (pr->level > 0))
+        fputs (line, stdout);
+    return (0);
+}
+
+
+
+/* one case through the engine; returns the number of failures
+ */
+static unsigned  runCase (const Case *pc, int verbose)
+{
+    StatsRecord  rec;
+    uint32_t     i;
+    unsigned     fails = 0;
+
+    generate (pc);
+    memset (records, 0, sizeof (records));
+    initStats ();
+    for (i=0; i<items; i++)
+    {
+        if ((i == 0) || (rate[i] != rate[i-1]))
+            statsSetRate (rate[i]);
+        statsInput (smpl[i]);
+        while (statsGet (&rec))         // drained per sample, no queue overrun
+            fails += check (&rec, verbose);
+    }
+
+    for (i=0; i<STATS_LEVELS; i++)
+    {
+        if (records[i] != SECONDS / duration[i])
+        {
+            printf ("FAIL level %lu: %lu records, expected %lu\n", (unsigned long) i,
+                    (unsigned long) records[i], (unsigned long) (SECONDS / duration[i]));
+            fails++;
+        }
+    }
+    printf ("%-10s %lu samples, %lu / %lu / %lu records, %u failed\n", pc->name, (unsigned long) items,
+            (unsigned long) records[0], (unsigned long) records[1], (unsigned long) records[2], fails);
+    return (fails);
+}
+
+
+
+int  main (int argc, char *argv[])
+{
+    unsigned  i, fails = 0;
+    int       verbose = (argc > 1) && !strcmp (argv[1], "-v");
+
+    for (i=0; i<sizeof (cases) / sizeof (cases[0]); i++)
+        fails += runCase (&cases[i], verbose);
+    return (fails > 0);
+}
@@ -0,0 +1,127 @@
+/* ---------------------------------------------------------------------------
+ * sumquery - host tool for the infraSensor summary files (*.sum);
+ * answers time-range queries from the 1s / 10s / 60s summary records,
+ * without touching the raw data file; the range is covered by the
+ * coarsest records that fit completely, and finer ones at the edges;
+ * record times are seconds since the recording start, the header line
+ * "# start boot <n> up <s>" relates it to the device run time ('U' line)
+ *
+ * build:  cc -O2 -o sumquery sumquery.c -lm
+ * usage:  sumquery <file.sum> <from[s]> <to[s]>
+ * ---------------------------------------------------------------------------
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define LEVELS        3
+
+typedef struct
+{
+    int       valid;
+    unsigned  n, min, max;
+    double    mean, rms;
+} Rec;
+
+static const unsigned  duration[LEVELS] = { 1, 10, 60 };
+static Rec            *recs[LEVELS];
+static unsigned        nrecs[LEVELS];
+
+
+static int  store (unsigned level, unsigned long t, Rec *pr)
+{
+    unsigned long  i = t / duration[level];
+
+    if (i >= nrecs[level])
+    {
+        unsigned long  nn = (i + 1) * 2;
+        recs[level] = realloc (recs[level], nn * sizeof (Rec));
+        if (recs[level] == NULL)
+            return -1;
+        memset (&recs[level][nrecs[level]], 0, (nn - nrecs[level]) * sizeof (Rec));
+        nrecs[level] = nn;
+    }
+    recs[level][i] = *pr;
+    return 0;
+}
+
+
+int  main (int argc, char *argv[])
+{
+    FILE           *fp;
+    char            line[128];
+    unsigned        level, lv, count;
+    unsigned long   t, t0, t1, n, boot = 0, up = 0;
+    unsigned        min, max;
+    double          sum, sumsq, mean, var;
+    Rec             r;
+
+    if (argc != 4)
+    {
+        fprintf (stderr, "usage: %s <file.sum> <from[s]> <to[s]>\n", argv[0]);
+        return 1;
+    }
+    if ((fp = fopen (argv[1], "r")) == NULL)
+    {
+        perror (argv[1]);
+        return 1;
+    }
+    t0 = strtoul (argv[2], NULL, 0);
+    t1 = strtoul (argv[3], NULL, 0);
+
+    while (fgets (line, sizeof (line), fp))
+    {
+        if (sscanf (line, "# start boot %lu up %lu", &boot, &up) == 2)
+            continue;
+        if ((line[0] == '#') || (line[0] == 'S'))   // header, or serial prefix
+            memmove (line, line + 1, strlen (line));
+        if (sscanf (line, "%u %lu %u %u %u %lf %lf", &level, &t, &r.n, &r.min, &r.max, &r.mean, &r.rms) != 7)
+            continue;
+        if (level >= LEVELS)
+            continue;
+        r.valid = 1;
+        if (store (level, t, &r) != 0)
+        {
+            fprintf (stderr, "out of memory\n");
+            return 1;
+        }
+    }
+    fclose (fp);
+
+    // greedy cover of [t0, t1) with the coarsest aligned records available
+    n = 0; count = 0; sum = sumsq = 0.0;
+    min = 0xFFFF; max = 0;
+    for (t = t0; t < t1; )
+    {
+        for (lv = LEVELS; lv-- > 0; )
+        {
+            unsigned long  i = t / duration[lv];
+            if ((t % duration[lv]) || (t + duration[lv] > t1) || (i >= nrecs[lv]) || !recs[lv][i].valid)
+                continue;
+            r      = recs[lv][i];
+            n     += r.n;
+            sum   += r.mean * r.n;
+            sumsq += (r.rms * r.rms + r.mean * r.mean) * r.n;
+            if (r.min < min)  min = r.min;
+            if (r.max > max)  max = r.max;
+            count++;
+            break;
+        }
+        t += (lv < LEVELS) ? duration[lv] : 1;  // no record: gap of 1s
+    }
+
+    if (n == 0)
+    {
+        printf ("no data in [%lu, %lu)\n", t0, t1);
+        return 2;
+    }
+    mean = sum / n;
+    var  = sumsq / n - mean * mean;
+    if (boot > 0)
+        printf ("start  boot %lu, device run time %lu s\n", boot, up);
+    printf ("range  %lu .. %lu s (%u records, %lu samples)\n", t0, t1, count, n);
+    printf ("min    %u\nmax    %u\np2p    %u\nmean   %.2f\nrms    %.2f\n",
+            min, max, max - min, mean, (var > 0.0) ? sqrt (var) : 0.0);
+    return 0;
+}
@@ -0,0 +1,179 @@
+/* ---------------------------------------------------------------------------
+ * trace2json - host tool for the infraSensor event trace;
+ * reads a capture of the serial output, picks the trace dumps (an 'X'
+ * header line followed by 'x' record lines; other lines are skipped),
+ * and writes a Chrome trace / Perfetto JSON timeline, one process per
+ * dump, one thread per context (thread mode, SysTick, interrupts);
+ * the 32 bit cycle time stamps are unwrapped from record to record, so
+ * gaps over 2^31 cycles (12.7s at 168MHz) come out short
+ *
+ * build:  cc -O2 -o trace2json trace2json.c
+ * usage:  trace2json <capture.txt> [out.json]
+ * ---------------------------------------------------------------------------
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+// events and task names, as in src/trace.h and src/sched.h
+#define TRACE_SAMPLE           1
+#define TRACE_SAMPLE_LOST      2
+#define TRACE_CONSUME          3
+#define TRACE_BLOCK            4
+#define TRACE_SD_BEGIN         5
+#define TRACE_SD_END           6
+#define TRACE_FRAME            7
+#define TRACE_TX_BEGIN         8
+#define TRACE_TX_END           9
+#define TRACE_TASK_BEGIN       10
+#define TRACE_TASK_END         11
+#define TRACE_ANOMALY          12
+
+#define TID_UART               1000     // UART transmission, across contexts
+
+static const char  *taskNames[] = { "acq", "store", "render", "serial", "house", "boot" };
+static const char  *whyNames[]  = { "?", "lost sample", "deadline miss" };
+
+static FILE  *out;
+static int    first = 1;
+
+
+static void  event (int pid, int tid, const char *name, const char *ph, double ts, const char *extra)
+{
+    fprintf (out, "%s\n  {\"pid\":%d,\"tid\":%d,\"name\":\"%s\",\"ph\":\"%s\",\"ts\":%.3f%s}",
+             first ? "" : ",", pid, tid, name, ph, ts, extra ? extra : "");
+    first = 0;
+}
+
+
+static void  threadName (int pid, int tid)
+{
+    char  extra[64];
+
+    if (tid == 0)
+        snprintf (extra, sizeof (extra), ",\"args\":{\"name\":\"thread\"}");
+    else if (tid == 15)
+        snprintf (extra, sizeof (extra), ",\"args\":{\"name\":\"SysTick\"}");
+    else if (tid == TID_UART)
+        snprintf (extra, sizeof (extra), ",\"args\":{\"name\":\"UART tx\"}");
+    else
+        snprintf (extra, sizeof (extra), ",\"args\":{\"name\":\"IRQ%d\"}", tid - 16);
+    event (pid, tid, "thread_name", "M", 0.0, extra);
+}
+
+
+int  main (int argc, char *argv[])
+{
+    FILE           *fp;
+    char            line[128], extra[64], name[32];
+    unsigned long   count = 0, hz = 0, tm, ev, ctx, arg;
+    unsigned long   left = 0, last = 0;
+    double          us = 0.0;
+    int             pid = 0, seen[256 + 1];
+    const char     *task;
+
+    if ((argc < 2) || (argc > 3))
+    {
+        fprintf (stderr, "usage: %s <capture.txt> [out.json]\n", argv[0]);
+        return (2);
+    }
+    fp = fopen (argv[1], "r");
+    if (fp == NULL)
+    {
+        fprintf (stderr, "cannot open %s\n", argv[1]);
+        return (1);
+    }
+    out = (argc == 3) ? fopen (argv[2], "w") : stdout;
+    if (out == NULL)
+    {
+        fprintf (stderr, "cannot write %s\n", argv[2]);
+        return (1);
+    }
+
+    fprintf (out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    while (fgets (line, sizeof (line), fp) != NULL)
+    {
+        if (line[0] == 'X')
+        {
+            if ((sscanf (&line[1], "%lu %lu", &count, &hz) != 2) || (hz == 0))
+                continue;
+            left = count;
+            pid++;
+            memset (seen, 0, sizeof (seen));
+            last = 0;
+            us   = 0.0;
+            continue;
+        }
+        if ((line[0] != 'x') || (left == 0) || (strlen (line) < 17))
+            continue;
+
+        if ((sscanf (&line[9], "%2lx%2lx%4lx", &ev, &ctx, &arg) != 3) ||
+            (sscanf (line, "x%8lx", &tm) != 1))
+            continue;
+        if (left-- < count)
+            us += (double) (int32_t) (uint32_t) (tm - last) * 1e6 / hz;
+        last = tm;
+
+        if (!seen[ctx])
+        {
+            threadName (pid, (int) ctx);
+            seen[ctx] = 1;
+        }
+        if (((ev == TRACE_TX_BEGIN) || (ev == TRACE_TX_END)) && !seen[256])
+        {
+            threadName (pid, TID_UART);
+            seen[256] = 1;
+        }
+
+        switch (ev)
+        {
+            case TRACE_SAMPLE:
+            case TRACE_SAMPLE_LOST:
+            case TRACE_CONSUME:
+            case TRACE_BLOCK:
+                snprintf (extra, sizeof (extra), ",\"s\":\"t\",\"args\":{\"arg\":%lu}", arg);
+                event (pid, (int) ctx, (ev == TRACE_SAMPLE) ? "sample" : (ev == TRACE_SAMPLE_LOST) ? "sample lost" :
+                       (ev == TRACE_CONSUME) ? "consume" : "block", "i", us, extra);
+                break;
+            case TRACE_SD_BEGIN:
+                snprintf (extra, sizeof (extra), ",\"args\":{\"sector\":%lu}", arg);
+                event (pid, (int) ctx, "disk_write", "B", us, extra);
+                break;
+            case TRACE_SD_END:
+                snprintf (extra, sizeof (extra), ",\"args\":{\"status\":%lu}", arg);
+                event (pid, (int) ctx, "disk_write", "E", us, extra);
+                break;
+            case TRACE_FRAME:
+                snprintf (extra, sizeof (extra), ",\"dur\":%lu", arg);
+                event (pid, (int) ctx, "frame", "X", us - arg, extra);
+                break;
+            case TRACE_TX_BEGIN:
+                snprintf (extra, sizeof (extra), ",\"args\":{\"bytes\":%lu}", arg);
+                event (pid, TID_UART, "tx", "B", us, extra);
+                break;
+            case TRACE_TX_END:
+                event (pid, TID_UART, "tx", "E", us, NULL);
+                break;
+            case TRACE_TASK_BEGIN:
+            case TRACE_TASK_END:
+                task = (arg < sizeof (taskNames) / sizeof (taskNames[0])) ? taskNames[arg] : "task";
+                event (pid, (int) ctx, task, (ev == TRACE_TASK_BEGIN) ? "B" : "E", us, NULL);
+                break;
+            case TRACE_ANOMALY:
+                snprintf (name, sizeof (name), "%s", (arg < 3) ? whyNames[arg] : whyNames[0]);
+                event (pid, (int) ctx, name, "i", us, ",\"s\":\"g\"");
+                break;
+            default:
+                break;
+        }
+    }
+    fprintf (out, "\n]}\n");
+
+    fclose (fp);
+    if (out != stdout)
+        fclose (out);
+    if (pid == 0)
+        fprintf (stderr, "no trace dump found\n");
+    return (pid == 0);
+}